@@ -11,8 +11,12 @@ AcceptanceDataWriter::AcceptanceDataWriter(const Settings& settings) :
     _outputFileName(settings.get("acceptanceInfoFileName"))
 {
     if (_shouldOutputData) {
-        initializeStream();
-        writeHeader();
+        if (settings.get<bool>("resume")) {
+            appendToExistingOutput();
+        } else {
+            initializeStream();
+            writeHeader();
+        }
     }
 }
 
@@ -52,3 +56,12 @@ void AcceptanceDataWriter::writeData(Model& model)
     _outputStream << model.getLastParameterUpdated() << ","
                   << model.getAcceptLastUpdate()     << std::endl;
 }
+
+
+void AcceptanceDataWriter::appendToExistingOutput()
+{
+    if (_shouldOutputData) {
+        _outputStream.close();
+        _outputStream.open(_outputFileName.c_str(), std::ios::app);
+    }
+}
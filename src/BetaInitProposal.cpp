@@ -3,6 +3,7 @@
 #include "Settings.h"
 #include "Model.h"
 #include "Prior.h"
+#include "TraitModel.h"
 #include "Tree.h"
 #include "TraitBranchEvent.h"
 
@@ -11,8 +12,9 @@ BetaInitProposal::BetaInitProposal
     (Random& random, Settings& settings, Model& model, Prior& prior) :
         EventParameterProposal(random, settings, model, prior)
 {
-    _weight = _settings.get<double>("updateRateBeta0");
+    readWeight(_settings, "updateRateBeta0");
     _updateBetaInitScale = _settings.get<double>("updateBetaInitScale");
+    setTunableScale(&_updateBetaInitScale, "updateBetaInitScale");
 }
 
 
@@ -44,7 +46,7 @@ void BetaInitProposal::revertToOldParameterValue()
 
 void BetaInitProposal::updateParameterOnTree()
 {
-    _tree->setMeanBranchTraitRates();
+    static_cast<TraitModel&>(_model).setMeanBranchTraitRates();
 }
 
 
@@ -3,6 +3,7 @@
 #include "Settings.h"
 #include "Model.h"
 #include "Prior.h"
+#include "TraitModel.h"
 #include "Tree.h"
 #include "TraitBranchEvent.h"
 
@@ -11,8 +12,9 @@ BetaShiftProposal::BetaShiftProposal
     (Random& random, Settings& settings, Model& model, Prior& prior) :
         EventParameterProposal(random, settings, model, prior)
 {
-    _weight = _settings.get<double>("updateRateBetaShift");
+    readWeight(_settings, "updateRateBetaShift");
     _updateBetaShiftScale = _settings.get<double>("updateBetaShiftScale");
+    setTunableScale(&_updateBetaShiftScale, "updateBetaShiftScale");
 }
 
 
@@ -54,7 +56,7 @@ void BetaShiftProposal::revertToOldParameterValue()
 
 void BetaShiftProposal::updateParameterOnTree()
 {
-    _tree->setMeanBranchTraitRates();
+    static_cast<TraitModel&>(_model).setMeanBranchTraitRates();
 }
 
 
@@ -2,6 +2,7 @@
 
 #include "Settings.h"
 #include "Prior.h"
+#include "TraitModel.h"
 #include "TraitBranchEvent.h"
 
 class Random;
@@ -12,7 +13,7 @@ BetaTimeModeProposal::BetaTimeModeProposal
     (Random& random, Settings& settings, Model& model)
     : TimeModeProposal(random, settings, model)
 {
-    _weight = settings.get<double>("updateRateBetaTimeMode");
+    readWeight(settings, "updateRateBetaTimeMode");
 }
 
 
@@ -47,7 +48,7 @@ void BetaTimeModeProposal::setEventParameters(BranchEvent* event,
 
 void BetaTimeModeProposal::setModelParameters()
 {
-    _tree->setMeanBranchTraitRates();
+    static_cast<TraitModel&>(_model).setMeanBranchTraitRates();
 }
 
 
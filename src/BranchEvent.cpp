@@ -8,9 +8,12 @@
 #include "Log.h"
 
 
-BranchEvent::BranchEvent(Node* x, Tree* tp, Random& random, double map) :
+BranchEvent::BranchEvent(Node* x, Tree* tp, Random& random, double map,
+    EventParameterStore& parameters) :
     mapTime(map), nodeptr(x), treePtr(tp), _random(random),
-    oldNodePtr(x), oldMapTime(map), _isEventTimeVariable(false)
+    oldNodePtr(x), oldMapTime(map), _isEventTimeVariable(false),
+    _parameters(parameters), _parameterId(parameters.allocate()),
+    _serialNumber(parameters.newSerialNumber())
 {
     if (tp->getRoot() == x) {
         _absTime = 0.0;
@@ -22,6 +25,7 @@ BranchEvent::BranchEvent(Node* x, Tree* tp, Random& random, double map) :
 
 BranchEvent::~BranchEvent()
 {
+    _parameters.release(_parameterId);
 }
 
 
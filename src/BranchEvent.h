@@ -2,6 +2,7 @@
 #define BRANCH_EVENT_H
 
 #include "Tree.h"
+#include "EventParameterStore.h"
 #include "Log.h"
 
 class Node;
@@ -11,6 +12,7 @@ class Random;
 // This base class contains:
 // (1) the node associated with the event
 // (2) the map position of the event
+// (3) the ID of the event's parameters in the model's EventParameterStore
 
 class BranchEvent
 {
@@ -44,11 +46,29 @@ private:
     // Allow rjMCMC to move between time-varying and time-constant partitions.
     bool _isEventTimeVariable;
 
+protected:
+
+    // Model-specific parameters are kept in the store, not in the event
+    EventParameterStore& _parameters;
+    EventParameterStore::EventId _parameterId;
+    unsigned long _serialNumber;
+
 public:
 
-    BranchEvent(Node* x, Tree* tp, Random& random, double map);
+    BranchEvent(Node* x, Tree* tp, Random& random, double map,
+        EventParameterStore& parameters);
     virtual ~BranchEvent();
 
+    EventParameterStore::EventId getParameterId();
+
+    // Unique among the events of the model (see
+    // EventParameterStore::newSerialNumber)
+    unsigned long getSerialNumber() const;
+
+    // Rebinds the event to an ID of a restored EventParameterStore
+    // (see Model::readState); the event's previous ID is not released
+    void setParameterId(EventParameterStore::EventId id);
+
     void   setMapTime(double x);
     double getMapTime();
 
@@ -98,6 +118,24 @@ inline double BranchEvent::getMapTime()
 }
 
 
+inline EventParameterStore::EventId BranchEvent::getParameterId()
+{
+    return _parameterId;
+}
+
+
+inline unsigned long BranchEvent::getSerialNumber() const
+{
+    return _serialNumber;
+}
+
+
+inline void BranchEvent::setParameterId(EventParameterStore::EventId id)
+{
+    _parameterId = id;
+}
+
+
 inline void BranchEvent::setEventNode(Node* x)
 {
     nodeptr = x;
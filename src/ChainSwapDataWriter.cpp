@@ -1,18 +1,41 @@
 #include "ChainSwapDataWriter.h"
 #include "Settings.h"
-#include "Model.h"
-#include "MCMC.h"
+#include "Log.h"
+#include "ProcessGroup.h"
+#include "Checkpoint.h"
 
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
 
 
 ChainSwapDataWriter::ChainSwapDataWriter(Settings& settings) :
     _numberOfChains(settings.get<int>("numberOfChains")),
-    _outputFileName(settings.get("chainSwapFileName"))
+    _shouldWriteFile(_numberOfChains > 1 && ProcessGroup::isRoot()),
+    _outputFileName(settings.get("chainSwapFileName")),
+    _resume(settings.get<bool>("resume")),
+    _proposedSwaps(_numberOfChains, std::vector<int>(_numberOfChains, 0)),
+    _acceptedSwaps(_numberOfChains, std::vector<int>(_numberOfChains, 0)),
+    _lastLadderEnd(_numberOfChains, NoEnd), _roundTrips(0)
 {
+    // Chain i starts with the i-th coldest temperature
     if (_numberOfChains > 1) {
+        _lastLadderEnd[0] = ColdEnd;
+        _lastLadderEnd[_numberOfChains - 1] = HotEnd;
+    }
+}
+
+
+// The file is opened with the first swap, so that runs without swaps
+// (e.g., population MCMC) do not write one
+void ChainSwapDataWriter::openStream()
+{
+    if (_resume) {
+        appendToExistingOutput();
+    } else {
         initializeStream();
         writeHeader();
     }
@@ -25,6 +48,12 @@ void ChainSwapDataWriter::initializeStream()
 }
 
 
+void ChainSwapDataWriter::appendToExistingOutput()
+{
+    _outputStream.open(_outputFileName.c_str(), std::ios::app);
+}
+
+
 void ChainSwapDataWriter::writeHeader()
 {
     _outputStream << header() << std::endl;
@@ -39,16 +68,17 @@ std::string ChainSwapDataWriter::header() const
 
 ChainSwapDataWriter::~ChainSwapDataWriter()
 {
-    if (_numberOfChains > 1) {
+    if (_outputStream.is_open()) {
         _outputStream.close();
     }
 }
 
 
 void ChainSwapDataWriter::writeData(int generation,
-    const std::vector<MCMC*>& chains, int chain_1, int chain_2, bool accepted)
+    const std::vector<double>& temperatures, int chain_1, int chain_2,
+    bool accepted)
 {
-    const std::vector<int>& chainRanks = rankChainsByTemp(chains);
+    const std::vector<int>& chainRanks = rankChainsByTemp(temperatures);
 
     int rank_1 = chainRanks[chain_1];
     int rank_2 = chainRanks[chain_2];
@@ -57,17 +87,99 @@ void ChainSwapDataWriter::writeData(int generation,
         std::swap(rank_1, rank_2);
     }
 
-    _outputStream << generation  << ","
-                  << rank_1      << ","
-                  << rank_2      << ","
-                  << accepted    << std::endl;
+    if (_shouldWriteFile) {
+        if (!_outputStream.is_open()) {
+            openStream();
+        }
+
+        _outputStream << generation  << ","
+                      << rank_1      << ","
+                      << rank_2      << ","
+                      << accepted    << std::endl;
+    }
+
+    _proposedSwaps[rank_1 - 1][rank_2 - 1]++;
+    if (accepted) {
+        _acceptedSwaps[rank_1 - 1][rank_2 - 1]++;
+    }
+
+    // Ranks are of the temperatures after the swap
+    updateRoundTrips(chain_1, chainRanks[chain_1]);
+    updateRoundTrips(chain_2, chainRanks[chain_2]);
+}
+
+
+void ChainSwapDataWriter::updateRoundTrips(int chain, int rank)
+{
+    if (rank == 1) {
+        if (_lastLadderEnd[chain] == HotEnd) {
+            _roundTrips++;
+        }
+        _lastLadderEnd[chain] = ColdEnd;
+    } else if (rank == _numberOfChains) {
+        _lastLadderEnd[chain] = HotEnd;
+    }
+}
+
+
+void ChainSwapDataWriter::logSummary() const
+{
+    if (_numberOfChains == 1 || !ProcessGroup::isRoot()) {
+        return;
+    }
+
+    log() << "\nChain swap acceptance rates by rank "
+          << "(1 is the cold chain):\n";
+    for (int i = 0; i < _numberOfChains; i++) {
+        for (int j = i + 1; j < _numberOfChains; j++) {
+            int proposed = _proposedSwaps[i][j];
+            if (proposed == 0) {
+                continue;
+            }
+
+            std::ostringstream rate;
+            rate << std::fixed << std::setprecision(3)
+                 << (double)_acceptedSwaps[i][j] / proposed;
+            log() << "    " << i + 1 << "-" << j + 1 << ": " << rate.str()
+                  << " (" << proposed << " proposals)\n";
+        }
+    }
+
+    log() << "Replica round trips (cold to hottest chain and back): "
+          << _roundTrips << "\n";
+}
+
+
+void ChainSwapDataWriter::writeState(std::ostream& out) const
+{
+    for (int i = 0; i < _numberOfChains; i++) {
+        Checkpoint::writeVector(out, _proposedSwaps[i]);
+        Checkpoint::writeVector(out, _acceptedSwaps[i]);
+        Checkpoint::write(out, (int)_lastLadderEnd[i]);
+    }
+
+    Checkpoint::write(out, _roundTrips);
+}
+
+
+void ChainSwapDataWriter::readState(std::istream& in)
+{
+    for (int i = 0; i < _numberOfChains; i++) {
+        Checkpoint::readVector(in, _proposedSwaps[i]);
+        Checkpoint::readVector(in, _acceptedSwaps[i]);
+
+        int ladderEnd = NoEnd;
+        Checkpoint::read(in, ladderEnd);
+        _lastLadderEnd[i] = (LadderEnd)ladderEnd;
+    }
+
+    Checkpoint::read(in, _roundTrips);
 }
 
 
 std::vector<int> ChainSwapDataWriter::rankChainsByTemp
-    (const std::vector<MCMC*>& chains) const
+    (const std::vector<double>& temps) const
 {
-    const std::vector<double>& temps = chainTemperatures(chains);
     const std::vector<double>& sortedTemps = sortValues(temps);
 
     std::vector<int> ranks;
@@ -85,17 +197,6 @@ std::vector<int> ChainSwapDataWriter::rankChainsByTemp
 }
 
 
-std::vector<double> ChainSwapDataWriter::chainTemperatures
-    (const std::vector<MCMC*>& chains) const
-{
-    std::vector<double> temps;
-    for (int i = 0; i < (int)chains.size(); i++) {
-        temps.push_back(chains[i]->model().getTemperatureMH());
-    }
-    return temps;
-}
-
-
 std::vector<double> ChainSwapDataWriter::sortValues
     (std::vector<double> values) const
 {
@@ -7,8 +7,6 @@
 #include <fstream>
 
 class Settings;
-class Model;
-class MCMC;
 
 
 class ChainSwapDataWriter
@@ -18,25 +16,51 @@ public:
     ChainSwapDataWriter(Settings& settings);
     ~ChainSwapDataWriter();
 
-    void writeData(int generation, const std::vector<MCMC*>& chains,
+    // Temperatures are those of all chains after the swap
+    void writeData(int generation, const std::vector<double>& temperatures,
         int chain_1, int chain_2, bool accepted);
 
+    // Logs the acceptance rate of each pair of ranks that was proposed
+    // and the number of replica round trips (cold -> hottest -> cold)
+    void logSummary() const;
+
+    // Saves and restores the swap statistics (see Checkpoint)
+    void writeState(std::ostream& out) const;
+    void readState(std::istream& in);
+
 private:
 
+    void openStream();
     void initializeStream();
+    void appendToExistingOutput();
     void writeHeader();
     std::string header() const;
 
-    std::vector<int> rankChainsByTemp(const std::vector<MCMC*>& chains) const;
-    std::vector<double> chainTemperatures
-        (const std::vector<MCMC*>& chains) const;
+    std::vector<int> rankChainsByTemp
+        (const std::vector<double>& temperatures) const;
     std::vector<double> sortValues(std::vector<double> values) const;
     int rankValue(double value, std::vector<double> sortedValues) const;
 
+    void updateRoundTrips(int chain, int rank);
+
     int _numberOfChains;
 
+    // Only the root process writes the file (see ProcessGroup)
+    bool _shouldWriteFile;
+
     std::string _outputFileName;
+    bool _resume;
     std::ofstream _outputStream;
+
+    // Swap proposals and acceptances, indexed by [rank_1 - 1][rank_2 - 1]
+    // with rank_1 < rank_2
+    std::vector<std::vector<int> > _proposedSwaps;
+    std::vector<std::vector<int> > _acceptedSwaps;
+
+    // Which end of the temperature ladder each chain visited last
+    enum LadderEnd { NoEnd, ColdEnd, HotEnd };
+    std::vector<LadderEnd> _lastLadderEnd;
+    int _roundTrips;
 };
 
 
@@ -0,0 +1,158 @@
+#include "ChainWorkerPool.h"
+#include "Settings.h"
+#include "Log.h"
+
+#include <algorithm>
+
+
+ChainWorkerPool::ChainWorkerPool(int numberOfWorkers) :
+    _queues(numberOfWorkers), _task(NULL), _period(0), _runningWorkers(0),
+    _stopping(false), _finishTimes(numberOfWorkers),
+    _barrierWaitTimes(numberOfWorkers, 0.0)
+{
+    _threads.reserve(numberOfWorkers);
+    for (int i = 0; i < numberOfWorkers; i++) {
+        _threads.push_back(std::thread(&ChainWorkerPool::workerLoop, this, i));
+    }
+}
+
+
+int ChainWorkerPool::numberOfWorkersFor
+    (const Settings& settings, int numberOfTasks)
+{
+    int nThreads = settings.get<int>("numberOfThreads");
+    if (nThreads < 0) {
+        exitWithError("numberOfThreads must be 0 (automatic) or positive");
+    }
+
+    if (nThreads == 0) {
+        nThreads = (int)std::thread::hardware_concurrency();
+    }
+
+    if (nThreads == 0) {
+        nThreads = numberOfTasks;
+    }
+
+    return std::min(nThreads, numberOfTasks);
+}
+
+
+ChainWorkerPool::~ChainWorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _startCondition.notify_all();
+
+    for (std::thread& thread : _threads) {
+        thread.join();
+    }
+}
+
+
+void ChainWorkerPool::run(int numberOfTasks, const Task& task)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    // All workers are parked, so the queues can be filled without
+    // taking their locks
+    int numberOfWorkers = (int)_queues.size();
+    for (int t = 0; t < numberOfTasks; t++) {
+        _queues[t % numberOfWorkers].tasks.push_back(t);
+    }
+
+    _task = &task;
+    _runningWorkers = numberOfWorkers;
+    _period++;
+    _startCondition.notify_all();
+
+    _doneCondition.wait(lock, [this] { return _runningWorkers == 0; });
+    _task = NULL;
+}
+
+
+void ChainWorkerPool::workerLoop(int worker)
+{
+    long lastPeriod = 0;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true) {
+        _startCondition.wait(lock,
+            [this, lastPeriod] { return _stopping || _period != lastPeriod; });
+
+        if (_stopping) {
+            return;
+        }
+
+        lastPeriod = _period;
+        const Task& task = *_task;
+
+        lock.unlock();
+        int t;
+        while ((t = nextTask(worker)) >= 0) {
+            task(t);
+        }
+        lock.lock();
+
+        _finishTimes[worker] = Clock::now();
+
+        // The last worker to finish closes the period and charges every
+        // other worker for the time it sat idle since finishing
+        if (--_runningWorkers == 0) {
+            Clock::time_point periodEnd = _finishTimes[worker];
+            for (int i = 0; i < (int)_finishTimes.size(); i++) {
+                _barrierWaitTimes[i] += std::chrono::duration<double>
+                    (periodEnd - _finishTimes[i]).count();
+            }
+            _doneCondition.notify_one();
+        }
+    }
+}
+
+
+int ChainWorkerPool::nextTask(int worker)
+{
+    int t = popOwnTask(worker);
+    if (t < 0) {
+        t = stealTask(worker);
+    }
+    return t;
+}
+
+
+int ChainWorkerPool::popOwnTask(int worker)
+{
+    WorkQueue& queue = _queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if (queue.tasks.empty()) {
+        return -1;
+    }
+
+    int t = queue.tasks.front();
+    queue.tasks.pop_front();
+    return t;
+}
+
+
+int ChainWorkerPool::stealTask(int worker)
+{
+    int numberOfWorkers = (int)_queues.size();
+
+    // Tasks are only added by run(), so once every queue has been seen
+    // empty there is nothing left to steal in this period
+    for (int i = 1; i < numberOfWorkers; i++) {
+        WorkQueue& victim = _queues[(worker + i) % numberOfWorkers];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (!victim.tasks.empty()) {
+            int t = victim.tasks.back();
+            victim.tasks.pop_back();
+            return t;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,98 @@
+#ifndef CHAIN_WORKER_POOL_H
+#define CHAIN_WORKER_POOL_H
+
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+class Settings;
+
+
+// A fixed set of worker threads that live for the whole run. Each call to
+// run() hands out tasks 0..numberOfTasks-1, executes task(t) for each of
+// them, and returns once all have finished (a barrier). Between calls the
+// workers sleep on a condition variable, so no threads are created or
+// joined per period.
+//
+// Tasks are dealt round-robin into one queue per worker. A worker takes
+// tasks from the front of its own queue; once that is empty it steals
+// from the back of the other queues, so there may be more tasks than
+// workers and no worker sits idle while a task is still waiting.
+
+class ChainWorkerPool
+{
+public:
+
+    typedef std::function<void(int)> Task;
+
+    explicit ChainWorkerPool(int numberOfWorkers);
+    ~ChainWorkerPool();
+
+    void run(int numberOfTasks, const Task& task);
+
+    int numberOfWorkers() const;
+
+    // Workers for a pool that runs numberOfTasks tasks at a time: the
+    // numberOfThreads setting, or with 0 the number of hardware threads
+    // (one per task if that is unknown), but no more than there are tasks
+    static int numberOfWorkersFor(const Settings& settings, int numberOfTasks);
+
+    // Total time (in seconds) worker i has spent idle at the end of a
+    // period, waiting for the slowest worker to finish
+    double barrierWaitTime(int worker) const;
+
+private:
+
+    typedef std::chrono::steady_clock Clock;
+
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    void workerLoop(int worker);
+
+    // Returns the next task for the worker, or -1 if no tasks are left
+    int nextTask(int worker);
+    int popOwnTask(int worker);
+    int stealTask(int worker);
+
+    std::vector<std::thread> _threads;
+    std::vector<WorkQueue> _queues;
+
+    std::mutex _mutex;
+    std::condition_variable _startCondition;
+    std::condition_variable _doneCondition;
+
+    const Task* _task;
+
+    // Incremented by each call to run(); workers compare it with the
+    // last period they ran to detect new work
+    long _period;
+    int _runningWorkers;
+    bool _stopping;
+
+    std::vector<Clock::time_point> _finishTimes;
+    std::vector<double> _barrierWaitTimes;
+};
+
+
+inline int ChainWorkerPool::numberOfWorkers() const
+{
+    return (int)_threads.size();
+}
+
+
+inline double ChainWorkerPool::barrierWaitTime(int worker) const
+{
+    return _barrierWaitTimes[worker];
+}
+
+
+#endif
@@ -0,0 +1,156 @@
+#include "Checkpoint.h"
+#include "Settings.h"
+#include "Log.h"
+
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cstring>
+
+
+namespace
+{
+
+const char Magic[] = "BAMMCKPT";
+const int FormatVersion = 7;
+
+}
+
+
+volatile std::sig_atomic_t Checkpoint::_stopRequested = 0;
+
+
+void Checkpoint::installSignalHandlers()
+{
+    std::signal(SIGTERM, handleSignal);
+    std::signal(SIGINT, handleSignal);
+}
+
+
+void Checkpoint::handleSignal(int signal)
+{
+    (void)signal;
+    _stopRequested = 1;
+}
+
+
+bool Checkpoint::stopRequested()
+{
+    return _stopRequested != 0;
+}
+
+
+void Checkpoint::writeHeader(std::ostream& out, int generation)
+{
+    out.write(Magic, sizeof(Magic) - 1);
+    write(out, FormatVersion);
+    write(out, generation);
+}
+
+
+int Checkpoint::readHeader(std::istream& in, const std::string& fileName)
+{
+    char magic[sizeof(Magic) - 1];
+    in.read(magic, sizeof(magic));
+
+    int version = 0;
+    read(in, version);
+
+    int generation = 0;
+    read(in, generation);
+
+    if (!in || std::memcmp(magic, Magic, sizeof(magic)) != 0 ||
+            version != FormatVersion) {
+        exitWithError("<<" + fileName + ">> is not a BAMM checkpoint file "
+            "written by this version");
+    }
+
+    return generation;
+}
+
+
+// A checkpoint at generation G is written after generations 0 to G - 1
+// have run and the chain swap at generation G has been attempted
+void Checkpoint::truncateOutputFiles
+    (const Settings& settings, const std::string& fileName)
+{
+    std::ifstream in(fileName.c_str(), std::ios::binary);
+    if (!in) {
+        exitWithError("Could not read checkpoint file <<" + fileName + ">>");
+    }
+
+    int generation = readHeader(in, fileName);
+
+    truncateFileAtGeneration(settings.get("mcmcOutfile"), generation);
+    truncateFileAtGeneration(settings.get("eventDataOutfile"), generation);
+    truncateFileAtGeneration(settings.get("chainSwapFileName"), generation + 1);
+    truncateFileAtGeneration
+        (settings.get("proposalProfileFileName"), generation + 1);
+
+    if (settings.has("nodeStateOutfile")) {
+        truncateFileAtGeneration(settings.get("nodeStateOutfile"), generation);
+    }
+
+    // The acceptance file has a header and one line per generation
+    truncateFileToLines
+        (settings.get("acceptanceInfoFileName"), generation + 1);
+}
+
+
+void Checkpoint::truncateFileAtGeneration
+    (const std::string& fileName, int firstDropped)
+{
+    std::ifstream in(fileName.c_str());
+    if (!in) {
+        return;
+    }
+
+    std::string tempFileName = fileName + ".tmp";
+    std::ofstream out(tempFileName.c_str());
+
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && std::isdigit(line[0]) &&
+                std::atoi(line.c_str()) >= firstDropped) {
+            continue;
+        }
+        out << line << "\n";
+    }
+
+    replaceFile(fileName, in, out);
+}
+
+
+void Checkpoint::truncateFileToLines
+    (const std::string& fileName, int numberOfLines)
+{
+    std::ifstream in(fileName.c_str());
+    if (!in) {
+        return;
+    }
+
+    std::string tempFileName = fileName + ".tmp";
+    std::ofstream out(tempFileName.c_str());
+
+    std::string line;
+    for (int i = 0; i < numberOfLines && std::getline(in, line); i++) {
+        out << line << "\n";
+    }
+
+    replaceFile(fileName, in, out);
+}
+
+
+// Replaces fileName with its truncated copy (fileName + ".tmp")
+void Checkpoint::replaceFile
+    (const std::string& fileName, std::ifstream& in, std::ofstream& out)
+{
+    in.close();
+    out.close();
+
+    std::string tempFileName = fileName + ".tmp";
+    if (!out || std::rename(tempFileName.c_str(), fileName.c_str()) != 0) {
+        exitWithError("Could not write <<" + fileName + ">>");
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <csignal>
+
+class Settings;
+
+
+// A checkpoint is a binary snapshot of the complete state of a run at the
+// end of a swap period: every chain's model and random number generator,
+// the chain temperatures and the chain swap statistics (see
+// MetropolisCoupledMCMC::writeCheckpoint). With resume = 1, the run
+// continues from it exactly as if it had never stopped, appending to the
+// existing output files.
+//
+// Values are written in the machine's native representation, so a
+// checkpoint can only be read by the same build on the same platform.
+
+class Checkpoint
+{
+public:
+
+    // After SIGTERM or SIGINT, stopRequested() becomes true; the run then
+    // writes a checkpoint at the end of the current swap period and stops
+    static void installSignalHandlers();
+    static bool stopRequested();
+
+    // Writes the identifying header of a checkpoint file
+    static void writeHeader(std::ostream& out, int generation);
+
+    // Reads the header of a checkpoint file and returns its generation
+    static int readHeader(std::istream& in, const std::string& fileName);
+
+    // Removes the output written after the checkpoint in fileName,
+    // so that the resumed run can append to the output files
+    static void truncateOutputFiles(const Settings& settings,
+        const std::string& fileName);
+
+    template<typename T>
+    static void write(std::ostream& out, const T& value);
+    template<typename T>
+    static void read(std::istream& in, T& value);
+
+    template<typename T>
+    static void writeVector(std::ostream& out, const std::vector<T>& values);
+    template<typename T>
+    static void readVector(std::istream& in, std::vector<T>& values);
+
+private:
+
+    static void handleSignal(int signal);
+
+    // Keeps the lines that do not start with a generation number
+    // (i.e., headers) or that start with one lower than firstDropped
+    static void truncateFileAtGeneration
+        (const std::string& fileName, int firstDropped);
+    static void truncateFileToLines
+        (const std::string& fileName, int numberOfLines);
+    static void replaceFile
+        (const std::string& fileName, std::ifstream& in, std::ofstream& out);
+
+    static volatile std::sig_atomic_t _stopRequested;
+};
+
+
+template<typename T>
+inline void Checkpoint::write(std::ostream& out, const T& value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+
+template<typename T>
+inline void Checkpoint::read(std::istream& in, T& value)
+{
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+
+template<typename T>
+inline void Checkpoint::writeVector
+    (std::ostream& out, const std::vector<T>& values)
+{
+    write(out, (int)values.size());
+    for (int i = 0; i < (int)values.size(); i++) {
+        write(out, values[i]);
+    }
+}
+
+
+template<typename T>
+inline void Checkpoint::readVector(std::istream& in, std::vector<T>& values)
+{
+    int size = 0;
+    read(in, size);
+
+    values.resize(size);
+    for (int i = 0; i < size && in; i++) {
+        read(in, values[i]);
+    }
+}
+
+
+#endif
@@ -0,0 +1,146 @@
+#include "EffectiveSampleSizeMonitor.h"
+#include "Settings.h"
+#include "Model.h"
+#include "Stat.h"
+#include "Checkpoint.h"
+#include "Log.h"
+
+
+static const int NumberOfQuantities = 3;
+static const char* QuantityNames[NumberOfQuantities] =
+    { "logLik", "N_shifts", "eventRate" };
+
+// The effective sample size is not computed from fewer samples
+// (after discarding the burn-in)
+static const int MinimumSamples = 16;
+
+
+EffectiveSampleSizeMonitor::EffectiveSampleSizeMonitor(Settings& settings) :
+    _samples(NumberOfQuantities),
+    _effectiveSampleSizes(NumberOfQuantities, 0.0),
+    _isFixed(NumberOfQuantities, false), _samplesUsed(0)
+{
+    _targetEffectiveSampleSize =
+        settings.get<double>("targetEffectiveSampleSize");
+    _burnInFraction = settings.get<double>("essBurnInFraction");
+    _checkFreq = settings.get<int>("essCheckFreq");
+    _sampleFreq = settings.get<int>("mcmcWriteFreq");
+
+    // Quantities that are never updated cannot reach any target
+    _isFixed[1] = settings.get<double>("updateRateEventNumber") == 0.0 &&
+        settings.get<double>("updateRateEventNumberForBranch") == 0.0;
+    _isFixed[2] = settings.get<double>("updateRateEventRate") == 0.0;
+
+    if (!isEnabled()) {
+        return;
+    }
+
+    if (_sampleFreq <= 0) {
+        exitWithError("mcmcWriteFreq must be greater than 0 "
+            "when targetEffectiveSampleSize is set");
+    }
+
+    if (_checkFreq <= 0) {
+        exitWithError("essCheckFreq must be greater than 0");
+    }
+
+    if (_burnInFraction < 0.0 || _burnInFraction >= 1.0) {
+        exitWithError("essBurnInFraction must be at least 0 and less than 1");
+    }
+}
+
+
+void EffectiveSampleSizeMonitor::recordSample(int generation, Model& model)
+{
+    if (!isEnabled() || generation % _sampleFreq != 0) {
+        return;
+    }
+
+    _samples[0].push_back(model.getCurrentLogLikelihood());
+    _samples[1].push_back(model.getNumberOfEvents());
+    _samples[2].push_back(model.getEventRate());
+}
+
+
+bool EffectiveSampleSizeMonitor::shouldCheck
+    (int previousGeneration, int generation) const
+{
+    return isEnabled() &&
+        generation / _checkFreq > previousGeneration / _checkFreq;
+}
+
+
+bool EffectiveSampleSizeMonitor::isTargetReached()
+{
+    int nSamples = (int)_samples[0].size();
+    int nBurnIn = (int)(_burnInFraction * nSamples);
+    _samplesUsed = nSamples - nBurnIn;
+
+    if (_samplesUsed < MinimumSamples) {
+        return false;
+    }
+
+    bool targetReached = true;
+    for (int q = 0; q < NumberOfQuantities; q++) {
+        if (_isFixed[q]) {
+            continue;
+        }
+
+        std::vector<std::vector<double> > chain(1, std::vector<double>
+            (_samples[q].begin() + nBurnIn, _samples[q].end()));
+        _effectiveSampleSizes[q] = Stat::effectiveSampleSize(chain);
+
+        if (!(_effectiveSampleSizes[q] >= _targetEffectiveSampleSize)) {
+            targetReached = false;
+        }
+    }
+
+    return targetReached;
+}
+
+
+void EffectiveSampleSizeMonitor::logEffectiveSampleSizes
+    (int generation, bool targetReached) const
+{
+    log() << "\nEffective sample sizes at generation " << generation;
+    if (_samplesUsed < MinimumSamples) {
+        log() << ": too few samples.\n";
+        return;
+    }
+
+    log() << " (last " << _samplesUsed << " of " << _samples[0].size()
+          << " samples):";
+    for (int q = 0; q < NumberOfQuantities; q++) {
+        log() << " " << QuantityNames[q] << " ";
+        if (_isFixed[q]) {
+            log() << "fixed";
+        } else {
+            log() << (int)_effectiveSampleSizes[q];
+        }
+    }
+    log() << "\n";
+
+    if (targetReached) {
+        log() << "Target effective sample size ("
+              << _targetEffectiveSampleSize << ") reached; stopping.\n";
+    } else {
+        log() << "Target effective sample size ("
+              << _targetEffectiveSampleSize << ") not reached.\n";
+    }
+}
+
+
+void EffectiveSampleSizeMonitor::writeState(std::ostream& out) const
+{
+    for (int q = 0; q < NumberOfQuantities; q++) {
+        Checkpoint::writeVector(out, _samples[q]);
+    }
+}
+
+
+void EffectiveSampleSizeMonitor::readState(std::istream& in)
+{
+    for (int q = 0; q < NumberOfQuantities; q++) {
+        Checkpoint::readVector(in, _samples[q]);
+    }
+}
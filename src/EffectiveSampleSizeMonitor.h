@@ -0,0 +1,77 @@
+#ifndef EFFECTIVE_SAMPLE_SIZE_MONITOR_H
+#define EFFECTIVE_SAMPLE_SIZE_MONITOR_H
+
+
+#include <vector>
+#include <iosfwd>
+
+class Settings;
+class Model;
+
+
+// Records logLik, N_shifts and eventRate of the cold chain every
+// mcmcWriteFreq generations and decides when a run can stop: once the
+// effective sample size (batch means, after discarding the first
+// essBurnInFraction of the samples) of every quantity reaches
+// targetEffectiveSampleSize. A quantity that has not changed has an
+// effective sample size of 0 (see Stat::effectiveSampleSize), unless its
+// update rate is 0, in which case it is left out. Disabled if the target
+// is 0.
+
+class EffectiveSampleSizeMonitor
+{
+public:
+
+    EffectiveSampleSizeMonitor(Settings& settings);
+
+    bool isEnabled() const;
+    void disable();
+
+    // Called with the cold chain after every generation
+    void recordSample(int generation, Model& model);
+
+    // Whether the sizes should be checked after running from
+    // previousGeneration to generation (every essCheckFreq generations)
+    bool shouldCheck(int previousGeneration, int generation) const;
+
+    // Computes the effective sample sizes and returns whether
+    // all of them reached the target
+    bool isTargetReached();
+
+    void logEffectiveSampleSizes(int generation, bool targetReached) const;
+
+    void writeState(std::ostream& out) const;
+    void readState(std::istream& in);
+
+private:
+
+    double _targetEffectiveSampleSize;
+    double _burnInFraction;
+    int _checkFreq;
+    int _sampleFreq;
+
+    // Samples of each quantity (logLik, N_shifts, eventRate)
+    std::vector<std::vector<double> > _samples;
+
+    // Effective sample sizes at the last check
+    std::vector<double> _effectiveSampleSizes;
+
+    // Quantities held fixed by their update rates
+    std::vector<bool> _isFixed;
+    int _samplesUsed;
+};
+
+
+inline bool EffectiveSampleSizeMonitor::isEnabled() const
+{
+    return _targetEffectiveSampleSize > 0;
+}
+
+
+inline void EffectiveSampleSizeMonitor::disable()
+{
+    _targetEffectiveSampleSize = 0.0;
+}
+
+
+#endif
@@ -12,12 +12,20 @@ EventDataWriter::EventDataWriter(Settings& settings) :
     _outputFreq(settings.get<int>("eventDataWriteFreq")),
     _headerWritten(false)
 {
-    if (_outputFreq > 0) {
+    if (_outputFreq > 0 && settings.get<bool>("resume")) {
+        appendToExistingOutput(true);
+    } else if (_outputFreq > 0) {
         _outputStream.open(_outputFileName.c_str());
     }
 }
 
 
+EventDataWriter::EventDataWriter(const std::string& outputFileName) :
+    _outputFileName(outputFileName), _outputFreq(1), _headerWritten(false)
+{
+    _outputStream.open(_outputFileName.c_str());
+}
+
 
 EventDataWriter::~EventDataWriter()
 {
@@ -115,3 +123,16 @@ std::string EventDataWriter::rightNodeName(BranchEvent* event)
         return eventNode->getRandomRightTipNode()->getName();
     }
 }
+
+
+void EventDataWriter::appendToExistingOutput(bool headerWritten)
+{
+    if (_outputFreq > 0) {
+        _outputStream.close();
+        _outputStream.open(_outputFileName.c_str(), std::ios::app);
+    }
+
+    if (headerWritten) {
+        _headerWritten = true;
+    }
+}
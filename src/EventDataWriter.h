@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <string>
 
 class Settings;
 class Model;
@@ -15,10 +16,19 @@ class EventDataWriter
 public:
 
     EventDataWriter(Settings& settings);
+
+    // Writes the events at every call to writeData (e.g., of a single
+    // configuration) to the given file
+    EventDataWriter(const std::string& outputFileName);
     virtual ~EventDataWriter();
 
     void writeData(int generation, Model& model);
 
+    // Reopens the output file in append mode, so that several processes
+    // can take turns writing to it (the header is then only written if
+    // headerWritten is false)
+    void appendToExistingOutput(bool headerWritten);
+
 protected:
 
     void writeHeaderOnce();
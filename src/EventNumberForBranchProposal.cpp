@@ -10,7 +10,7 @@ EventNumberForBranchProposal::EventNumberForBranchProposal
     (Random& random, Settings& settings, Model& model) :
         _random(random), _model(model)
 {
-    _weight = settings.get<double>("updateRateEventNumberForBranch");
+    readWeight(settings, "updateRateEventNumberForBranch");
 
     _validateEventConfiguration =
         settings.get<bool>("validateEventConfiguration");
@@ -38,8 +38,6 @@ void EventNumberForBranchProposal::propose()
         _lastProposal = RemoveEvent;
     }
 
-    _model.setMeanBranchParameters();
-
     _proposedEventCount = _model.getNumberOfEvents();
     _proposedLogLikelihood = _model.computeLogLikelihood();
     _proposedLogPrior = _model.computeLogPrior();
@@ -63,7 +61,6 @@ void EventNumberForBranchProposal::reject()
 {
     if (_lastProposal == AddEvent) {
         _model.removeEventFromTree(_lastEventChanged);
-        _model.setMeanBranchParameters();
         delete _lastEventChanged;
         _lastEventChanged = NULL;
     } else if (_lastProposal == RemoveEvent) {
@@ -84,7 +81,9 @@ double EventNumberForBranchProposal::acceptanceRatio()
     double logQRatio = computeLogQRatio();
 
     double t = _model.getTemperatureMH();
-    double logRatio = t * (logLikelihoodRatio + logPriorRatio) + logQRatio;
+    double power = _model.getLikelihoodPower();
+    double logRatio =
+        t * (power * logLikelihoodRatio + logPriorRatio) + logQRatio;
 
     if (std::isfinite(logRatio)) {
         return std::min(1.0, std::exp(logRatio));
@@ -2,18 +2,54 @@
 #include "Random.h"
 #include "Settings.h"
 #include "Model.h"
+#include "Tree.h"
+#include "Node.h"
+#include "BranchEvent.h"
+#include "Checkpoint.h"
+#include "Log.h"
 
 #include <algorithm>
+#include <cmath>
+
+
+// The learned distribution is first used after this many recorded states,
+// and then updated every SampleBatchSize states
+static const int MinimumSamples = 200;
+static const int SampleBatchSize = 50;
 
 
 EventNumberProposal::EventNumberProposal
     (Random& random, Settings& settings, Model& model) :
-        _random(random), _model(model)
+        _random(random), _model(model), _numberOfLocationSamples(0)
 {
-    _weight = settings.get<double>("updateRateEventNumber");
+    readWeight(settings, "updateRateEventNumber");
 
     _validateEventConfiguration =
         settings.get<bool>("validateEventConfiguration");
+
+    _learnedLocationWeight =
+        settings.get<double>("learnedEventLocationWeight");
+    if (_learnedLocationWeight < 0.0 || _learnedLocationWeight >= 1.0) {
+        exitWithError("learnedEventLocationWeight must be >= 0 and < 1");
+    }
+
+    if (_learnedLocationWeight > 0.0 && !settings.get<bool>("autotune")) {
+        log(Warning) << "learnedEventLocationWeight is ignored "
+            << "without autotune.\n";
+    }
+
+    Tree& tree = *(model.getTreePtr());
+    _totalMapLength = tree.getTotalMapLength();
+
+    const std::vector<Node*>& nodes = tree.preOrderNodes();
+    for (Node* node : nodes) {
+        if (node->getCanHoldEvent() &&
+                node->getMapEnd() > node->getMapStart()) {
+            _mappedNodes.push_back(node);
+        }
+    }
+
+    _branchEventCounts.assign(nodes.size(), 0.0);
 }
 
 
@@ -27,15 +63,18 @@ void EventNumberProposal::propose()
         _random.trueWithProbability(0.5);
 
     if (shouldAddEvent) {
-        _lastEventChanged = _model.addRandomEventToTree();
+        if (!_cumulativeProbabilities.empty() &&
+                _random.trueWithProbability(_learnedLocationWeight)) {
+            _lastEventChanged = _model.addRandomEventToTree(learnedMapTime());
+        } else {
+            _lastEventChanged = _model.addRandomEventToTree();
+        }
         _lastProposal = AddEvent;
     } else {
         _lastEventChanged = _model.removeRandomEventFromTree();
         _lastProposal = RemoveEvent;
     }
 
-    _model.setMeanBranchParameters();
-
     _proposedEventCount = _model.getNumberOfEvents();
     _proposedLogLikelihood = _model.computeLogLikelihood();
     _proposedLogPrior = _model.computeLogPrior();
@@ -59,7 +98,6 @@ void EventNumberProposal::reject()
 {
     if (_lastProposal == AddEvent) {
         _model.removeEventFromTree(_lastEventChanged);
-        _model.setMeanBranchParameters();
         delete _lastEventChanged;
         _lastEventChanged = NULL;
     } else if (_lastProposal == RemoveEvent) {
@@ -80,7 +118,9 @@ double EventNumberProposal::acceptanceRatio()
     double logQRatio = computeLogQRatio();
 
     double t = _model.getTemperatureMH();
-    double logRatio = t * (logLikelihoodRatio + logPriorRatio) + logQRatio;
+    double power = _model.getLikelihoodPower();
+    double logRatio =
+        t * (power * logLikelihoodRatio + logPriorRatio) + logQRatio;
 
     if (std::isfinite(logRatio)) {
         return std::min(1.0, std::exp(logRatio));
@@ -113,10 +153,133 @@ double EventNumberProposal::computeLogQRatio()
     if (_lastProposal == AddEvent) {
         // -0.6931... is ln 0.5
         double logQRatio = (_currentEventCount > 0) ? 0.0 : -0.69314718055995;
-        return logQRatio - _model.logQRatioJump();
+        return logQRatio - _model.logQRatioJump() -
+            logLocationDensityRatio(_lastEventChanged);
     } else {
         // 0.6931... is ln 2.0
         double logQRatio = (_currentEventCount != 1) ? 0.0 : 0.69314718055995;
-        return logQRatio + _model.logQRatioJump();
+        return logQRatio + _model.logQRatioJump() +
+            logLocationDensityRatio(_lastEventChanged);
+    }
+}
+
+
+double EventNumberProposal::learnedMapTime()
+{
+    double u = _random.uniform();
+    std::vector<double>::size_type i = std::upper_bound
+        (_cumulativeProbabilities.begin(), _cumulativeProbabilities.end(), u) -
+            _cumulativeProbabilities.begin();
+    i = std::min(i, _mappedNodes.size() - 1);
+
+    Node* node = _mappedNodes[i];
+    return _random.uniform(node->getMapStart(), node->getMapEnd());
+}
+
+
+// The new event is placed with density (1 - w) / L + w * p / l, where w is
+// the weight of the learned distribution, L the map length, and p and l
+// the learned probability and the map length of the event's branch
+double EventNumberProposal::logLocationDensityRatio(BranchEvent* event)
+{
+    if (_cumulativeProbabilities.empty()) {
+        return 0.0;
     }
+
+    Node* node = event->getEventNode();
+    double branchProbability =
+        _learnedBranchProbabilities[node->getPreOrderIndex()];
+    double branchLength = node->getMapEnd() - node->getMapStart();
+    return std::log((1.0 - _learnedLocationWeight) + _learnedLocationWeight *
+        branchProbability * _totalMapLength / branchLength);
+}
+
+
+void EventNumberProposal::adaptScale(bool accepted, double targetAcceptanceRate)
+{
+    Proposal::adaptScale(accepted, targetAcceptanceRate);
+
+    if (_learnedLocationWeight == 0.0) {
+        return;
+    }
+
+    recordEventLocations();
+    if (_numberOfLocationSamples >= MinimumSamples &&
+            _numberOfLocationSamples % SampleBatchSize == 0) {
+        updateLearnedDistribution();
+    }
+}
+
+
+void EventNumberProposal::recordEventLocations()
+{
+    BranchEvent* rootEvent = _model.getRootEvent();
+    for (BranchEvent* event : _model.events()) {
+        if (event != rootEvent) {
+            _branchEventCounts[event->getEventNode()->getPreOrderIndex()]++;
+        }
+    }
+
+    _numberOfLocationSamples++;
+}
+
+
+void EventNumberProposal::updateLearnedDistribution()
+{
+    double totalCount = 0.0;
+    for (Node* node : _mappedNodes) {
+        totalCount += _branchEventCounts[node->getPreOrderIndex()];
+    }
+
+    // With no events recorded yet, keep proposing uniformly
+    if (totalCount == 0.0) {
+        return;
+    }
+
+    std::vector<double> probabilities(_branchEventCounts.size(), 0.0);
+    for (Node* node : _mappedNodes) {
+        int i = node->getPreOrderIndex();
+        probabilities[i] = _branchEventCounts[i] / totalCount;
+    }
+
+    setLearnedBranchProbabilities(probabilities);
+}
+
+
+void EventNumberProposal::setLearnedBranchProbabilities
+    (const std::vector<double>& probabilities)
+{
+    _learnedBranchProbabilities = probabilities;
+
+    _cumulativeProbabilities.clear();
+    if (probabilities.empty()) {
+        return;
+    }
+
+    double sum = 0.0;
+    for (Node* node : _mappedNodes) {
+        sum += probabilities[node->getPreOrderIndex()];
+        _cumulativeProbabilities.push_back(sum);
+    }
+}
+
+
+void EventNumberProposal::writeState(std::ostream& out) const
+{
+    Proposal::writeState(out);
+    Checkpoint::write(out, _numberOfLocationSamples);
+    Checkpoint::writeVector(out, _branchEventCounts);
+    Checkpoint::writeVector(out, _learnedBranchProbabilities);
+}
+
+
+void EventNumberProposal::readState(std::istream& in)
+{
+    Proposal::readState(in);
+    Checkpoint::read(in, _numberOfLocationSamples);
+    Checkpoint::readVector(in, _branchEventCounts);
+
+    std::vector<double> probabilities;
+    Checkpoint::readVector(in, probabilities);
+    setLearnedBranchProbabilities(probabilities);
 }
@@ -4,11 +4,22 @@
 
 #include "Proposal.h"
 
+#include <vector>
+
 class Random;
 class Settings;
 class Model;
 class BranchEvent;
+class Node;
+
 
+// Adds an event to or removes an event from the tree. New events are
+// placed uniformly on the tree map. With "learnedEventLocationWeight" > 0,
+// the branches that hold events are recorded while proposals adapt (see the
+// "autotune" setting), and a new event is then placed, with that
+// probability, on a branch drawn from the recorded frequencies (uniformly
+// within the branch) instead. The learned distribution is kept for the
+// rest of the run.
 
 class EventNumberProposal : public Proposal
 {
@@ -28,12 +39,29 @@ public:
 
     virtual double acceptanceRatio();
 
+    virtual void adaptScale(bool accepted, double targetAcceptanceRate);
+
+    virtual void writeState(std::ostream& out) const;
+    virtual void readState(std::istream& in);
+
 private:
 
     double computeLogLikelihoodRatio();
     double computeLogPriorRatio();
     double computeLogQRatio();
 
+    // Map time of a new event drawn from the learned distribution
+    double learnedMapTime();
+
+    // Log of the ratio of the density of the new-event distribution
+    // at the event's position to the uniform density on the map
+    double logLocationDensityRatio(BranchEvent* event);
+
+    void recordEventLocations();
+    void updateLearnedDistribution();
+    void setLearnedBranchProbabilities
+        (const std::vector<double>& probabilities);
+
     Random& _random;
     Model& _model;
 
@@ -49,6 +77,23 @@ private:
 
     ProposalType _lastProposal;
     BranchEvent* _lastEventChanged;
+
+    double _learnedLocationWeight;
+    double _totalMapLength;
+
+    // Nodes whose branch has a positive length on the map
+    std::vector<Node*> _mappedNodes;
+
+    // Number of recorded states and of events on each branch in them,
+    // indexed by pre-order index
+    int _numberOfLocationSamples;
+    std::vector<double> _branchEventCounts;
+
+    // Learned probability of each branch (indexed by pre-order index)
+    // and cumulative probabilities of the mapped nodes;
+    // empty until enough states are recorded
+    std::vector<double> _learnedBranchProbabilities;
+    std::vector<double> _cumulativeProbabilities;
 };
 
    
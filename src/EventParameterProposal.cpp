@@ -53,7 +53,9 @@ double EventParameterProposal::acceptanceRatio()
     double logQRatio = computeLogQRatio();
 
     double t = _model.getTemperatureMH();
-    double logRatio = t * (logLikelihoodRatio + logPriorRatio) + logQRatio;
+    double power = _model.getLikelihoodPower();
+    double logRatio =
+        t * (power * logLikelihoodRatio + logPriorRatio) + logQRatio;
 
     if (std::isfinite(logRatio)) {
         return std::min(1.0, std::exp(logRatio));
@@ -0,0 +1,98 @@
+#include "EventParameterStore.h"
+#include "Checkpoint.h"
+#include "Log.h"
+
+#include <algorithm>
+
+
+// Initial number of events the arrays can hold before growing
+#define INITIAL_CAPACITY 64
+
+
+EventParameterStore::EventParameterStore(int numberOfParameters) :
+    _numberOfParameters(numberOfParameters), _size(0),
+    _capacity(INITIAL_CAPACITY),
+    _values(numberOfParameters * INITIAL_CAPACITY, 0.0),
+    _isTimeVariable(INITIAL_CAPACITY, 0), _isInTree(INITIAL_CAPACITY, 0),
+    _serialNumbers(0)
+{
+}
+
+
+EventParameterStore::EventId EventParameterStore::allocate()
+{
+    EventId id;
+
+    if (!_releasedIds.empty()) {
+        id = _releasedIds.back();
+        _releasedIds.pop_back();
+    } else {
+        if (_size == _capacity) {
+            grow();
+        }
+        id = (EventId)_size++;
+    }
+
+    for (int p = 0; p < _numberOfParameters; p++) {
+        set(id, p, 0.0);
+    }
+    _isTimeVariable[id] = 0;
+    _isInTree[id] = 0;
+
+    return id;
+}
+
+
+void EventParameterStore::release(EventId id)
+{
+    _isInTree[id] = 0;
+    _releasedIds.push_back(id);
+}
+
+
+// Doubles the capacity, moving each parameter array to its new offset
+void EventParameterStore::grow()
+{
+    int newCapacity = 2 * _capacity;
+    std::vector<double> newValues(_numberOfParameters * newCapacity, 0.0);
+
+    for (int p = 0; p < _numberOfParameters; p++) {
+        std::copy(_values.begin() + p * _capacity,
+                  _values.begin() + p * _capacity + _size,
+                  newValues.begin() + p * newCapacity);
+    }
+
+    _values.swap(newValues);
+    _isTimeVariable.resize(newCapacity, 0);
+    _isInTree.resize(newCapacity, 0);
+    _capacity = newCapacity;
+}
+
+
+void EventParameterStore::writeState(std::ostream& out) const
+{
+    Checkpoint::write(out, _numberOfParameters);
+    Checkpoint::write(out, _size);
+    Checkpoint::write(out, _capacity);
+    Checkpoint::writeVector(out, _values);
+    Checkpoint::writeVector(out, _isTimeVariable);
+    Checkpoint::writeVector(out, _isInTree);
+    Checkpoint::writeVector(out, _releasedIds);
+}
+
+
+void EventParameterStore::readState(std::istream& in)
+{
+    int numberOfParameters = 0;
+    Checkpoint::read(in, numberOfParameters);
+    if (numberOfParameters != _numberOfParameters) {
+        exitWithError("The checkpoint was written for another model type");
+    }
+
+    Checkpoint::read(in, _size);
+    Checkpoint::read(in, _capacity);
+    Checkpoint::readVector(in, _values);
+    Checkpoint::readVector(in, _isTimeVariable);
+    Checkpoint::readVector(in, _isInTree);
+    Checkpoint::readVector(in, _releasedIds);
+}
@@ -0,0 +1,143 @@
+#ifndef EVENT_PARAMETER_STORE_H
+#define EVENT_PARAMETER_STORE_H
+
+
+#include <vector>
+#include <iosfwd>
+
+
+// Holds the continuous parameters of all events of a model in contiguous
+// arrays, one array per parameter, indexed by event ID. Each BranchEvent
+// is a lightweight handle that owns one ID for as long as it exists.
+// Priors can then be evaluated by looping straight over the arrays of the
+// events that are currently on the tree (see isInTree()).
+
+class EventParameterStore
+{
+public:
+
+    typedef unsigned int EventId;
+
+    explicit EventParameterStore(int numberOfParameters);
+
+    // Returns an unused ID (reusing IDs of released events)
+    EventId allocate();
+    void release(EventId id);
+
+    // Returns a number never handed out before by this store, which
+    // tells events apart even when they reuse an ID (not saved by
+    // writeState)
+    unsigned long newSerialNumber();
+
+    double get(EventId id, int parameter) const;
+    void   set(EventId id, int parameter, double value);
+
+    bool isTimeVariable(EventId id) const;
+    void setTimeVariable(EventId id, bool isTimeVariable);
+
+    // Whether the event is currently placed on the tree (the root event
+    // is not counted, as its parameters have separate priors)
+    bool isInTree(EventId id) const;
+    void setInTree(EventId id, bool isInTree);
+
+    // Number of IDs handed out so far (the length of each array)
+    int size() const;
+
+    // Direct access to the arrays; valid until the next allocate()
+    const double* values(int parameter) const;
+    const char*   timeVariableFlags() const;
+    const char*   inTreeFlags() const;
+
+    // Saves and restores every array, including the IDs available for
+    // reuse, so that events get the same IDs after a checkpoint
+    void writeState(std::ostream& out) const;
+    void readState(std::istream& in);
+
+private:
+
+    void grow();
+
+    int _numberOfParameters;
+    int _size;
+    int _capacity;
+
+    // Parameter p of event i is at _values[p * _capacity + i]
+    std::vector<double> _values;
+
+    std::vector<char> _isTimeVariable;
+    std::vector<char> _isInTree;
+
+    std::vector<EventId> _releasedIds;
+
+    unsigned long _serialNumbers;
+};
+
+
+inline double EventParameterStore::get(EventId id, int parameter) const
+{
+    return _values[parameter * _capacity + id];
+}
+
+
+inline void EventParameterStore::set(EventId id, int parameter, double value)
+{
+    _values[parameter * _capacity + id] = value;
+}
+
+
+inline unsigned long EventParameterStore::newSerialNumber()
+{
+    return _serialNumbers++;
+}
+
+
+inline bool EventParameterStore::isTimeVariable(EventId id) const
+{
+    return _isTimeVariable[id] != 0;
+}
+
+
+inline void EventParameterStore::setTimeVariable
+    (EventId id, bool isTimeVariable)
+{
+    _isTimeVariable[id] = isTimeVariable;
+}
+
+
+inline bool EventParameterStore::isInTree(EventId id) const
+{
+    return _isInTree[id] != 0;
+}
+
+
+inline void EventParameterStore::setInTree(EventId id, bool isInTree)
+{
+    _isInTree[id] = isInTree;
+}
+
+
+inline int EventParameterStore::size() const
+{
+    return _size;
+}
+
+
+inline const double* EventParameterStore::values(int parameter) const
+{
+    return &_values[parameter * _capacity];
+}
+
+
+inline const char* EventParameterStore::timeVariableFlags() const
+{
+    return &_isTimeVariable[0];
+}
+
+
+inline const char* EventParameterStore::inTreeFlags() const
+{
+    return &_isInTree[0];
+}
+
+
+#endif
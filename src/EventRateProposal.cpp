@@ -13,8 +13,9 @@ EventRateProposal::EventRateProposal
     (Random& random, Settings& settings, Model& model, Prior& prior) :
         _random(random), _settings(settings), _model(model), _prior(prior)
 {
-    _weight = _settings.get<double>("updateRateEventRate");
+    readWeight(_settings, "updateRateEventRate");
     _updateEventRateScale = _settings.get<double>("updateEventRateScale");
+    setTunableScale(&_updateEventRateScale, "updateEventRateScale");
 }
 
 
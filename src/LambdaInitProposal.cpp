@@ -3,6 +3,7 @@
 #include "Settings.h"
 #include "Model.h"
 #include "Prior.h"
+#include "SpExModel.h"
 #include "Tree.h"
 #include "SpExBranchEvent.h"
 
@@ -11,8 +12,9 @@ LambdaInitProposal::LambdaInitProposal
     (Random& random, Settings& settings, Model& model, Prior& prior) :
         EventParameterProposal(random, settings, model, prior)
 {
-    _weight = _settings.get<double>("updateRateLambda0");
+    readWeight(_settings, "updateRateLambda0");
     _updateLambdaInitScale = _settings.get<double>("updateLambdaInitScale");
+    setTunableScale(&_updateLambdaInitScale, "updateLambdaInitScale");
 }
 
 
@@ -43,8 +45,9 @@ void LambdaInitProposal::revertToOldParameterValue()
 
 void LambdaInitProposal::updateParameterOnTree()
 {
-    _tree->setNodeSpeciationParameters();
-    _tree->setNodeExtinctionParameters();
+    SpExModel& model = static_cast<SpExModel&>(_model);
+    model.setNodeSpeciationParameters();
+    model.setNodeExtinctionParameters();
 }
 
 
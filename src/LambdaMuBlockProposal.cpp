@@ -0,0 +1,360 @@
+#include "LambdaMuBlockProposal.h"
+#include "Random.h"
+#include "Settings.h"
+#include "Model.h"
+#include "Prior.h"
+#include "SpExModel.h"
+#include "SpExBranchEvent.h"
+#include "Checkpoint.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// Order of the parameters in the value vectors
+enum
+{
+    LogLambdaInit,
+    LambdaShift,
+    LogMuInit,
+    MuShift,
+    NumberOfParameters
+};
+
+// The learned covariance is first used after this many samples,
+// and then updated every SampleBatchSize samples
+static const int MinimumSamples = 200;
+static const int SampleBatchSize = 50;
+
+// Optimal scaling of the covariance for a normal target (Gelman et al.
+// 1996), and the part of the initial covariance kept in the step
+// so that it does not become singular
+static const double CovarianceScaling = 2.38 * 2.38 / NumberOfParameters;
+static const double InitialCovarianceWeight = 0.01;
+
+
+LambdaMuBlockProposal::LambdaMuBlockProposal
+    (Random& random, Settings& settings, Model& model, Prior& prior) :
+        _random(random), _settings(settings), _model(model), _prior(prior),
+        _event(NULL), _currentLogLikelihood(0.0), _proposedLogLikelihood(0.0),
+        _initialVariances(NumberOfParameters),
+        _degreesOfFreedom(0), _sampleCrossProducts(NumberOfParameters * NumberOfParameters, 0.0),
+        _choleskyFactor(NumberOfParameters * NumberOfParameters, 0.0)
+{
+    readWeight(_settings, "updateRateLambdaMuBlock");
+    _scale = _settings.get<double>("updateLambdaMuBlockScale");
+    setTunableScale(&_scale, "updateLambdaMuBlockScale");
+
+    // The initial rates are changed by a factor exp(s * (U - 1/2)),
+    // the shifts by a normal step with standard deviation s
+    double lambdaInitScale = _settings.get<double>("updateLambdaInitScale");
+    double lambdaShiftScale = _settings.get<double>("updateLambdaShiftScale");
+    double muInitScale = _settings.get<double>("updateMuInitScale");
+    double muShiftScale = _settings.get<double>("updateMuShiftScale");
+
+    _initialVariances[LogLambdaInit] = lambdaInitScale * lambdaInitScale / 12;
+    _initialVariances[LambdaShift] = lambdaShiftScale * lambdaShiftScale;
+    _initialVariances[LogMuInit] = muInitScale * muInitScale / 12;
+    _initialVariances[MuShift] = muShiftScale * muShiftScale;
+
+    for (int i = 0; i < NumberOfParameters; i++) {
+        _choleskyFactor[i * NumberOfParameters + i] =
+            std::sqrt(_initialVariances[i]);
+    }
+
+    // Parameters the user holds fixed stay out of the block
+    _isUpdated.assign(NumberOfParameters, false);
+    _isUpdated[LogLambdaInit] =
+        _settings.get<double>("updateRateLambda0") != 0.0;
+    _isUpdated[LambdaShift] =
+        _settings.get<double>("updateRateLambdaShift") != 0.0;
+    _isUpdated[LogMuInit] = _settings.get<double>("updateRateMu0") != 0.0;
+    _isUpdated[MuShift] = _settings.get<double>("updateRateMuShift") != 0.0;
+}
+
+
+void LambdaMuBlockProposal::propose()
+{
+    _event = static_cast<SpExBranchEvent*>(_model.chooseEventAtRandom(true));
+    _isInBlock = parametersInBlock();
+    _currentValues = eventValues();
+    _currentLogLikelihood = _model.getCurrentLogLikelihood();
+
+    Vector normals(NumberOfParameters);
+    for (int i = 0; i < NumberOfParameters; i++) {
+        normals[i] = _random.normal(0.0, 1.0);
+    }
+
+    _proposedValues = _currentValues;
+    for (int i = 0; i < NumberOfParameters; i++) {
+        double step = 0.0;
+        for (int j = 0; j <= i; j++) {
+            step += _choleskyFactor[i * NumberOfParameters + j] * normals[j];
+        }
+        _proposedValues[i] += _scale * step;
+    }
+
+    // Parameters outside the block keep their values; leaving out a
+    // component of the step keeps it symmetric
+    for (int i = 0; i < NumberOfParameters; i++) {
+        if (!_isInBlock[i]) {
+            _proposedValues[i] = _currentValues[i];
+        }
+    }
+
+    setEventValues(_proposedValues);
+    updateParametersOnTree();
+
+    _proposedLogLikelihood = _model.computeLogLikelihood();
+}
+
+
+void LambdaMuBlockProposal::accept()
+{
+    _model.setCurrentLogLikelihood(_proposedLogLikelihood);
+}
+
+
+void LambdaMuBlockProposal::reject()
+{
+    setEventValues(_currentValues);
+    updateParametersOnTree();
+}
+
+
+double LambdaMuBlockProposal::acceptanceRatio()
+{
+    double logLikelihoodRatio = _proposedLogLikelihood - _currentLogLikelihood;
+    double logPriorRatio = computeLogPriorRatio();
+
+    // Jacobian of the log transformation of the initial rates
+    double logQRatio =
+        (_proposedValues[LogLambdaInit] - _currentValues[LogLambdaInit]) +
+        (_proposedValues[LogMuInit] - _currentValues[LogMuInit]);
+
+    double t = _model.getTemperatureMH();
+    double power = _model.getLikelihoodPower();
+    double logRatio =
+        t * (power * logLikelihoodRatio + logPriorRatio) + logQRatio;
+
+    if (std::isfinite(logRatio)) {
+        return std::min(1.0, std::exp(logRatio));
+    } else {
+        return 0.0;
+    }
+}
+
+
+void LambdaMuBlockProposal::adaptScale
+    (bool accepted, double targetAcceptanceRate)
+{
+    Proposal::adaptScale(accepted, targetAcceptanceRate);
+
+    if (recordSample(eventValues()) &&
+            _degreesOfFreedom >= MinimumSamples &&
+            _degreesOfFreedom % SampleBatchSize == 0) {
+        updateCholeskyFactor();
+    }
+}
+
+
+// A parameter is in the block if its single-parameter update rate is not
+// 0 and, for an initial rate, the event's rate is positive (a rate of 0,
+// e.g., muInit under pure birth, has no log); a time-constant event also
+// keeps its speciation shift
+std::vector<bool> LambdaMuBlockProposal::parametersInBlock() const
+{
+    std::vector<bool> isInBlock(_isUpdated);
+    isInBlock[LogLambdaInit] =
+        isInBlock[LogLambdaInit] && _event->getLamInit() > 0.0;
+    isInBlock[LambdaShift] =
+        isInBlock[LambdaShift] && _event->isTimeVariable();
+    isInBlock[LogMuInit] = isInBlock[LogMuInit] && _event->getMuInit() > 0.0;
+    return isInBlock;
+}
+
+
+// Initial rates outside the block are not log-transformed (they may be 0)
+LambdaMuBlockProposal::Vector LambdaMuBlockProposal::eventValues() const
+{
+    Vector values(NumberOfParameters);
+    values[LogLambdaInit] = _isInBlock[LogLambdaInit] ?
+        std::log(_event->getLamInit()) : _event->getLamInit();
+    values[LambdaShift] = _event->getLamShift();
+    values[LogMuInit] = _isInBlock[LogMuInit] ?
+        std::log(_event->getMuInit()) : _event->getMuInit();
+    values[MuShift] = _event->getMuShift();
+    return values;
+}
+
+
+void LambdaMuBlockProposal::setEventValues(const Vector& values)
+{
+    if (_isInBlock[LogLambdaInit]) {
+        _event->setLamInit(std::exp(values[LogLambdaInit]));
+    }
+    if (_isInBlock[LambdaShift]) {
+        _event->setLamShift(values[LambdaShift]);
+    }
+    if (_isInBlock[LogMuInit]) {
+        _event->setMuInit(std::exp(values[LogMuInit]));
+    }
+    if (_isInBlock[MuShift]) {
+        _event->setMuShift(values[MuShift]);
+    }
+}
+
+
+void LambdaMuBlockProposal::updateParametersOnTree()
+{
+    SpExModel& model = static_cast<SpExModel&>(_model);
+    model.setNodeSpeciationParameters();
+    model.setNodeExtinctionParameters();
+}
+
+
+// Only the parameters that changed contribute (muShift, for example,
+// does not change when it is not updated)
+double LambdaMuBlockProposal::computeLogPriorRatio()
+{
+    bool isRoot = _event == _model.getRootEvent();
+    double ratio = 0.0;
+
+    if (_proposedValues[LogLambdaInit] != _currentValues[LogLambdaInit]) {
+        double proposed = std::exp(_proposedValues[LogLambdaInit]);
+        double current = std::exp(_currentValues[LogLambdaInit]);
+        ratio += isRoot ?
+            _prior.lambdaInitRootPrior(proposed) -
+                _prior.lambdaInitRootPrior(current) :
+            _prior.lambdaInitPrior(proposed) - _prior.lambdaInitPrior(current);
+    }
+
+    if (_proposedValues[LambdaShift] != _currentValues[LambdaShift]) {
+        double proposed = _proposedValues[LambdaShift];
+        double current = _currentValues[LambdaShift];
+        ratio += isRoot ?
+            _prior.lambdaShiftRootPrior(proposed) -
+                _prior.lambdaShiftRootPrior(current) :
+            _prior.lambdaShiftPrior(proposed) -
+                _prior.lambdaShiftPrior(current);
+    }
+
+    if (_proposedValues[LogMuInit] != _currentValues[LogMuInit]) {
+        double proposed = std::exp(_proposedValues[LogMuInit]);
+        double current = std::exp(_currentValues[LogMuInit]);
+        ratio += isRoot ?
+            _prior.muInitRootPrior(proposed) -
+                _prior.muInitRootPrior(current) :
+            _prior.muInitPrior(proposed) - _prior.muInitPrior(current);
+    }
+
+    if (_proposedValues[MuShift] != _currentValues[MuShift]) {
+        double proposed = _proposedValues[MuShift];
+        double current = _currentValues[MuShift];
+        ratio += isRoot ?
+            _prior.muShiftRootPrior(proposed) -
+                _prior.muShiftRootPrior(current) :
+            _prior.muShiftPrior(proposed) - _prior.muShiftPrior(current);
+    }
+
+    return ratio;
+}
+
+
+// Updates the event's mean and the pooled cross-products with Welford's
+// algorithm. Events sit at different rates, so each sample is centered on
+// the mean of its own event; the pooled cross-products then measure the
+// spread within an event, not between events. Returns whether the sample
+// added to them (the first sample of an event only sets its mean).
+bool LambdaMuBlockProposal::recordSample(const Vector& values)
+{
+    EventSamples& samples = _eventSamples[_event->getSerialNumber()];
+    if (samples.count == 0) {
+        samples.mean = values;
+        samples.count = 1;
+        return false;
+    }
+
+    samples.count++;
+
+    Vector delta(NumberOfParameters);
+    for (int i = 0; i < NumberOfParameters; i++) {
+        delta[i] = values[i] - samples.mean[i];
+        samples.mean[i] += delta[i] / samples.count;
+    }
+
+    for (int i = 0; i < NumberOfParameters; i++) {
+        for (int j = 0; j < NumberOfParameters; j++) {
+            _sampleCrossProducts[i * NumberOfParameters + j] +=
+                delta[i] * (values[j] - samples.mean[j]);
+        }
+    }
+
+    _degreesOfFreedom++;
+    return true;
+}
+
+
+// Cholesky decomposition of the step covariance. Parameters that never
+// change (e.g., muShift when it is not updated) have zero variance and
+// get a zero row; if the covariance is not positive semi-definite
+// (from rounding), the previous factor is kept.
+void LambdaMuBlockProposal::updateCholeskyFactor()
+{
+    const int n = NumberOfParameters;
+
+    Vector covariance(n * n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            covariance[i * n + j] = CovarianceScaling *
+                _sampleCrossProducts[i * n + j] / _degreesOfFreedom;
+        }
+        covariance[i * n + i] +=
+            InitialCovarianceWeight * _initialVariances[i];
+    }
+
+    Vector factor(n * n, 0.0);
+    for (int j = 0; j < n; j++) {
+        double diagonal = covariance[j * n + j];
+        for (int k = 0; k < j; k++) {
+            diagonal -= factor[j * n + k] * factor[j * n + k];
+        }
+
+        if (diagonal < 0.0) {
+            return;
+        }
+
+        factor[j * n + j] = std::sqrt(diagonal);
+        if (factor[j * n + j] == 0.0) {
+            continue;
+        }
+
+        for (int i = j + 1; i < n; i++) {
+            double value = covariance[i * n + j];
+            for (int k = 0; k < j; k++) {
+                value -= factor[i * n + k] * factor[j * n + k];
+            }
+            factor[i * n + j] = value / factor[j * n + j];
+        }
+    }
+
+    _choleskyFactor = factor;
+}
+
+
+void LambdaMuBlockProposal::writeState(std::ostream& out) const
+{
+    Proposal::writeState(out);
+    Checkpoint::write(out, _degreesOfFreedom);
+    Checkpoint::writeVector(out, _sampleCrossProducts);
+    Checkpoint::writeVector(out, _choleskyFactor);
+}
+
+
+void LambdaMuBlockProposal::readState(std::istream& in)
+{
+    Proposal::readState(in);
+    Checkpoint::read(in, _degreesOfFreedom);
+    Checkpoint::readVector(in, _sampleCrossProducts);
+    Checkpoint::readVector(in, _choleskyFactor);
+}
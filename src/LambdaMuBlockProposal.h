@@ -0,0 +1,102 @@
+#ifndef LAMBDA_MU_BLOCK_PROPOSAL_H
+#define LAMBDA_MU_BLOCK_PROPOSAL_H
+
+
+#include "Proposal.h"
+
+#include <vector>
+#include <map>
+
+class Random;
+class Settings;
+class Model;
+class Prior;
+class SpExBranchEvent;
+
+
+// Changes the initial speciation and extinction rates and their shift
+// parameters of one event together, on the scale
+// (log lambdaInit, lambdaShift, log muInit, muShift), with a multivariate
+// normal step. Only parameters whose single-parameter update rate is not 0
+// are in the block (see parametersInBlock()). The step covariance starts
+// diagonal, from the scales of the single-parameter proposals. It is only
+// learned while proposals adapt (the "autotune" setting): from the sampled
+// parameter values, each centered on the mean of its event
+// (Haario et al. 2001). It is then kept for the rest of the run; without
+// autotune, it stays diagonal.
+
+class LambdaMuBlockProposal : public Proposal
+{
+public:
+
+    LambdaMuBlockProposal(Random& random, Settings& settings, Model& model,
+        Prior& prior);
+
+    virtual void propose();
+    virtual void accept();
+    virtual void reject();
+
+    virtual double acceptanceRatio();
+
+    virtual void adaptScale(bool accepted, double targetAcceptanceRate);
+
+    virtual void writeState(std::ostream& out) const;
+    virtual void readState(std::istream& in);
+
+private:
+
+    typedef std::vector<double> Vector;
+
+    std::vector<bool> parametersInBlock() const;
+    Vector eventValues() const;
+    void setEventValues(const Vector& values);
+    void updateParametersOnTree();
+
+    double computeLogPriorRatio();
+
+    bool recordSample(const Vector& values);
+    void updateCholeskyFactor();
+
+    Random& _random;
+    Settings& _settings;
+    Model& _model;
+    Prior& _prior;
+
+    SpExBranchEvent* _event;
+    double _scale;
+
+    // Whether each parameter has a single-parameter update, and whether
+    // it is in the block for the current event
+    std::vector<bool> _isUpdated;
+    std::vector<bool> _isInBlock;
+
+    Vector _currentValues;
+    Vector _proposedValues;
+
+    double _currentLogLikelihood;
+    double _proposedLogLikelihood;
+
+    Vector _initialVariances;
+
+    struct EventSamples
+    {
+        EventSamples() : count(0) {}
+
+        int count;
+        Vector mean;
+    };
+
+    // Number and mean of the sampled values of each event (by serial
+    // number; the means are not saved in checkpoints, as the numbers
+    // differ between runs), and the degrees of freedom and sums of
+    // cross-products (row-major) of the values centered on them
+    std::map<unsigned long, EventSamples> _eventSamples;
+    int _degreesOfFreedom;
+    Vector _sampleCrossProducts;
+
+    // Lower-triangular (row-major) factor of the step covariance
+    Vector _choleskyFactor;
+};
+
+
+#endif
@@ -3,6 +3,7 @@
 #include "Settings.h"
 #include "Model.h"
 #include "Prior.h"
+#include "SpExModel.h"
 #include "Tree.h"
 #include "SpExBranchEvent.h"
 
@@ -11,8 +12,9 @@ LambdaShiftProposal::LambdaShiftProposal
     (Random& random, Settings& settings, Model& model, Prior& prior) :
         EventParameterProposal(random, settings, model, prior)
 {
-    _weight = _settings.get<double>("updateRateLambdaShift");
+    readWeight(_settings, "updateRateLambdaShift");
     _updateLambdaShiftScale = _settings.get<double>("updateLambdaShiftScale");
+    setTunableScale(&_updateLambdaShiftScale, "updateLambdaShiftScale");
 }
 
 
@@ -53,8 +55,9 @@ void LambdaShiftProposal::revertToOldParameterValue()
 
 void LambdaShiftProposal::updateParameterOnTree()
 {
-    _tree->setNodeSpeciationParameters();
-    _tree->setNodeExtinctionParameters();
+    SpExModel& model = static_cast<SpExModel&>(_model);
+    model.setNodeSpeciationParameters();
+    model.setNodeExtinctionParameters();
 }
 
 
@@ -2,6 +2,7 @@
 
 #include "Settings.h"
 #include "Prior.h"
+#include "SpExModel.h"
 #include "SpExBranchEvent.h"
 
 class Random;
@@ -12,7 +13,7 @@ LambdaTimeModeProposal::LambdaTimeModeProposal
     (Random& random, Settings& settings, Model& model)
     : TimeModeProposal(random, settings, model)
 {
-    _weight = settings.get<double>("updateRateLambdaTimeMode");
+    readWeight(settings, "updateRateLambdaTimeMode");
 }
 
 
@@ -47,8 +48,9 @@ void LambdaTimeModeProposal::setEventParameters(BranchEvent* event,
 
 void LambdaTimeModeProposal::setModelParameters()
 {
-    _tree->setNodeSpeciationParameters();
-    _tree->setNodeExtinctionParameters();
+    SpExModel& model = static_cast<SpExModel&>(_model);
+    model.setNodeSpeciationParameters();
+    model.setNodeExtinctionParameters();
 }
 
 
@@ -27,6 +27,18 @@ std::ostream& Log::outputStream(LogType logType, std::ostream& out)
 }
 
 
+void Log::setMessagesMuted(bool muted)
+{
+    _messagesMuted = muted;
+}
+
+
+bool Log::messagesMuted() const
+{
+    return _messagesMuted;
+}
+
+
 void Log::startWarning(std::ostream& out)
 {
     out << TEXT_COLOR_WARNING << "\nWARNING: " << TEXT_COLOR_DEFAULT;
@@ -44,7 +56,9 @@ std::ostream& log(LogType logType)
     std::ostream* out;
 
     if (logType == Message) {
-        out = &std::cout;
+        // A stream without a buffer discards its output
+        static std::ostream mutedStream(NULL);
+        out = Log::instance().messagesMuted() ? &mutedStream : &std::cout;
     } else if (logType == Warning) {
         out = &std::cerr;
     } else if (logType == Error) {
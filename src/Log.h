@@ -28,9 +28,14 @@ public:
 
     std::ostream& outputStream(LogType logType, std::ostream& out);
 
+    // While muted, messages (but not warnings or errors) to the screen
+    // are dropped, e.g., while creating many copies of a model
+    void setMessagesMuted(bool muted);
+    bool messagesMuted() const;
+
 private:
 
-    Log() {};
+    Log() : _messagesMuted(false) {};
 
     void startMessage(std::ostream& out);
     void startWarning(std::ostream& out);
@@ -38,6 +43,8 @@ private:
 
     static Log _logger;
 
+    bool _messagesMuted;
+
 };
 
 
@@ -2,22 +2,73 @@
 #include "Random.h"
 #include "Model.h"
 #include "ModelFactory.h"
+#include "ChainWorkerPool.h"
+#include "Log.h"
 
 #include <climits>
+#include <sstream>
+#include <string>
+#include <algorithm>
 
 
 // Choose a random number up to INT_MAX - 1, not INT_MAX,
 // because MbRandom adds 1 internally, causing an overflow
-MCMC::MCMC(Random& seeder, Settings& settings, ModelFactory& modelFactory) :
-    _random(seeder.uniformInteger(0, INT_MAX - 1))
+MCMC::MCMC(Random& seeder, Settings& settings, ModelFactory& modelFactory,
+    Tree& tree, int speculativeThreads, int eventLocationThreads) :
+    _random(seeder.uniformInteger(0, INT_MAX - 1)), _speculationPool(NULL),
+    _helperPool(NULL), _streamSeed(0), _speculativeModelsSynchronized(false)
 {
-    _model = modelFactory.createModel(_random, settings);
- 
+    _model = modelFactory.createModel(_random, settings, tree);
+
+    // The copies only evaluate likelihoods; messages about their
+    // creation would repeat those of the chain's model
+    if (eventLocationThreads > 1) {
+        bool muted = Log::instance().messagesMuted();
+        Log::instance().setMessagesMuted(true);
+        for (int t = 0; t < eventLocationThreads; t++) {
+            Random* random = new Random(_random.getSeed());
+            _helperRandoms.push_back(random);
+            _helperModels.push_back
+                (modelFactory.createModel(*random, settings, tree));
+        }
+        Log::instance().setMessagesMuted(muted);
+
+        _helperPool = new ChainWorkerPool(eventLocationThreads);
+        _model->setHelperModels(_helperModels, _helperPool);
+    }
+
+    if (speculativeThreads <= 0) {
+        return;
+    }
+
+    _streamSeed = _random.uniformInteger(0, INT_MAX - 1);
+
+    for (int t = 1; t < speculativeThreads; t++) {
+        Random* random = new Random(_random.getSeed());
+        _speculativeRandoms.push_back(random);
+        _speculativeModels.push_back
+            (modelFactory.createModel(*random, settings, tree));
+    }
+
+    _speculationPool = new ChainWorkerPool(speculativeThreads);
 }
 
 
 MCMC::~MCMC()
 {
+    delete _speculationPool;
+    delete _helperPool;
+
+    for (int t = 0; t < (int)_helperModels.size(); t++) {
+        delete _helperModels[t];
+        delete _helperRandoms[t];
+    }
+
+    for (int t = 0; t < (int)_speculativeModels.size(); t++) {
+        delete _speculativeModels[t];
+        delete _speculativeRandoms[t];
+    }
+
     delete _model;
 }
 
@@ -30,6 +81,30 @@ void MCMC::run(int generations)
 }
 
 
+void MCMC::writeState(std::ostream& out) const
+{
+    _random.writeState(out);
+    _model->writeState(out);
+}
+
+
+void MCMC::readState(std::istream& in)
+{
+    _random.readState(in);
+    _model->readState(in);
+    _speculativeModelsSynchronized = false;
+}
+
+
+void MCMC::setSampledState(const Model& source)
+{
+    std::stringstream state;
+    source.writeSampledState(state);
+    _model->readSampledState(state);
+    _speculativeModelsSynchronized = false;
+}
+
+
 void MCMC::step()
 {
     //std::cout << _model->getCurrentLogLikelihood() << "\tActual: " << _model->computeLogLikelihood() << std::endl;
@@ -45,3 +120,110 @@ void MCMC::step()
         _model->rejectProposal();
     }
 }
+
+
+void MCMC::runSpeculatively(int genStart, int genEnd,
+    const std::function<void(int, Model&)>& generationDone)
+{
+    int copies = (int)_speculativeModels.size() + 1;
+
+    if (!_speculativeModelsSynchronized) {
+        synchronizeModels(0);
+    }
+
+    // Not vector<bool>: each thread writes its own element
+    std::vector<char> accepted(copies);
+    std::vector<int> acceptDeltas(copies);
+    std::vector<int> rejectDeltas(copies);
+
+    // The acceptance counts a serial run would have
+    int acceptCount = _model->getMHAcceptCount();
+    int rejectCount = _model->getMHRejectCount();
+
+    int g = genStart;
+    while (g < genEnd) {
+        int n = std::min(copies, genEnd - g);
+
+        _speculationPool->run(n, [&, g](int t) {
+            Model& m = model(t);
+            Random& random = (t == 0) ? _random : *_speculativeRandoms[t - 1];
+            random.setSeed(generationSeed(g + t));
+
+            int acceptsBefore = m.getMHAcceptCount();
+            int rejectsBefore = m.getMHRejectCount();
+
+            m.proposeNewState();
+            accepted[t] = random.trueWithProbability(m.acceptanceRatio());
+            if (accepted[t]) {
+                m.acceptProposal();
+            } else {
+                m.rejectProposal();
+            }
+
+            acceptDeltas[t] = m.getMHAcceptCount() - acceptsBefore;
+            rejectDeltas[t] = m.getMHRejectCount() - rejectsBefore;
+        });
+
+        int firstAccepted = (int)(std::find(accepted.begin(),
+            accepted.begin() + n, (char)true) - accepted.begin());
+        int kept = std::min(firstAccepted + 1, n);
+
+        for (int t = 0; t < kept; t++) {
+            acceptCount += acceptDeltas[t];
+            rejectCount += rejectDeltas[t];
+            model(t).setMHAcceptanceCounts(acceptCount, rejectCount);
+
+            generationDone(g + t, model(t));
+
+            acceptCount = model(t).getMHAcceptCount();
+            rejectCount = model(t).getMHRejectCount();
+        }
+
+        // Proposals after the first accepted one started from a state
+        // that no longer exists; the others were all rejected, leaving
+        // every copy in the same state
+        if (firstAccepted < n) {
+            synchronizeModels(firstAccepted);
+        }
+
+        for (int t = 0; t < copies; t++) {
+            model(t).setMHAcceptanceCounts(acceptCount, rejectCount);
+        }
+
+        g += kept;
+    }
+}
+
+
+void MCMC::synchronizeModels(int source)
+{
+    _speculativeModelsSynchronized = true;
+    if (_speculativeModels.empty()) {
+        return;
+    }
+
+    std::ostringstream out;
+    model(source).writeState(out);
+    const std::string state = out.str();
+
+    int copies = (int)_speculativeModels.size() + 1;
+    _speculationPool->run(copies, [&](int t) {
+        if (t != source) {
+            std::istringstream in(state);
+            model(t).readState(in);
+        }
+    });
+}
+
+
+// Mixes the stream seed with the generation (SplitMix64), giving a
+// seed in [1, INT_MAX - 1] (see the constructor)
+unsigned long int MCMC::generationSeed(int generation) const
+{
+    unsigned long long z = _streamSeed +
+        0x9E3779B97F4A7C15ULL * ((unsigned long long)generation + 1);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return 1 + (unsigned long int)(z % (INT_MAX - 1));
+}
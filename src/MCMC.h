@@ -3,37 +3,103 @@
 
 
 #include "Random.h"
+#include <iosfwd>
+#include <vector>
+#include <functional>
 
 class Settings;
 class Model;
 class ModelFactory;
+class Tree;
+class ChainWorkerPool;
 
 
 class MCMC
 {
 public:
 
-    MCMC(Random& seeder, Settings& settings, ModelFactory& modelFactory);
+    // With speculativeThreads > 0, the chain keeps that many copies of
+    // its model and runs speculatively (see runSpeculatively()). With
+    // eventLocationThreads > 1, it keeps that many copies on which
+    // MoveEventProposal scores its candidate positions in parallel.
+    MCMC(Random& seeder, Settings& settings, ModelFactory& modelFactory,
+        Tree& tree, int speculativeThreads = 0, int eventLocationThreads = 0);
     ~MCMC();
 
     void run(int generations);
     void step();
 
+    // Runs generations genStart..genEnd-1 in batches of one generation
+    // per model copy. Every copy proposes from the same current state,
+    // as if all earlier proposals in the batch are rejected; the batch
+    // is kept up to its first acceptance and the copies are resynchronized
+    // from the accepted state. Each generation draws from its own random
+    // stream, so the result does not depend on the number of copies.
+    // generationDone(g, model) is called for each kept generation in order.
+    void runSpeculatively(int genStart, int genEnd,
+        const std::function<void(int, Model&)>& generationDone);
+
+    bool isSpeculative() const;
+
     Model& model();
 
+    // Saves and restores the chain's random number generator and model
+    void writeState(std::ostream& out) const;
+    void readState(std::istream& in);
+
+    // Continues the chain from the sampled state of another model
+    // (see Model::writeSampledState)
+    void setSampledState(const Model& source);
+
 protected:
 
     // MCMC has its own random generator, using the seeder
     // (another random generator) to seed it
     Random _random;
     Model* _model;
+
+private:
+
+    Model& model(int copy);
+
+    // Makes every model copy a copy of the given one
+    void synchronizeModels(int source);
+
+    unsigned long int generationSeed(int generation) const;
+
+    // Model copies beyond the first (which is _model), each with
+    // its own random generator
+    std::vector<Random*> _speculativeRandoms;
+    std::vector<Model*> _speculativeModels;
+    ChainWorkerPool* _speculationPool;
+
+    // Model copies of the chain's model (see Model::helperModels)
+    std::vector<Random*> _helperRandoms;
+    std::vector<Model*> _helperModels;
+    ChainWorkerPool* _helperPool;
+
+    // Seed of the per-generation random streams
+    unsigned long int _streamSeed;
+    bool _speculativeModelsSynchronized;
 };
 
 
+inline bool MCMC::isSpeculative() const
+{
+    return _speculationPool != NULL;
+}
+
+
 inline Model& MCMC::model()
 {
     return *_model;
 }
 
 
+inline Model& MCMC::model(int copy)
+{
+    return copy == 0 ? *_model : *_speculativeModels[copy - 1];
+}
+
+
 #endif
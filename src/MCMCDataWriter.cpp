@@ -24,8 +24,12 @@ MCMCDataWriter::MCMCDataWriter(Settings& settings) :
     
     
     if (_outputFreq > 0) {
-        initializeStream();
-        writeHeader();
+        if (settings.get<bool>("resume")) {
+            appendToExistingOutput();
+        } else {
+            initializeStream();
+            writeHeader();
+        }
     }
     
 
@@ -93,5 +97,10 @@ void MCMCDataWriter::writeData(int generation, Model& model)
 }
 
 
-
-
+void MCMCDataWriter::appendToExistingOutput()
+{
+    if (_outputFreq > 0) {
+        _outputStream.close();
+        _outputStream.open(_outputFileName.c_str(), std::ios::app);
+    }
+}
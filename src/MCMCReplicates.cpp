@@ -0,0 +1,271 @@
+#include "MCMCReplicates.h"
+
+#include "Random.h"
+#include "Settings.h"
+#include "ModelFactory.h"
+#include "MetropolisCoupledMCMC.h"
+#include "Model.h"
+#include "Tree.h"
+#include "ChainWorkerPool.h"
+#include "ProcessGroup.h"
+#include "Stat.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <climits>
+
+
+namespace
+{
+
+const char* const QuantityNames[] = { "logLik", "N_shifts", "eventRate" };
+const int NumberOfQuantities = 3;
+
+// Fewer samples than this (after discarding the first half) are not
+// enough to split each replicate and form batch means
+const int MinimumSamplesForDiagnostics = 8;
+
+const char* const OutputFileParameters[] = {
+    "mcmcOutfile", "eventDataOutfile", "nodeStateOutfile",
+    "acceptanceInfoFileName", "chainSwapFileName",
+    "lambdaOutfile", "muOutfile", "betaOutfile", "proposalProfileFileName"
+};
+const int NumberOfOutputFileParameters = 9;
+
+}
+
+
+MCMCReplicates::MCMCReplicates
+    (Random& random, Settings& settings, ModelFactory* modelFactory) :
+        _settings(settings), _tree(NULL), _workerPool(NULL)
+{
+    _nReplicates = _settings.get<int>("numberOfReplicates");
+    _nGenerations = _settings.get<int>("numberOfGenerations");
+    _swapPeriod = _settings.get<int>("swapPeriod");
+    _sampleFreq = _settings.get<int>("mcmcWriteFreq");
+    _diagnosticsFreq = _settings.get<int>("replicateDiagnosticsFreq");
+
+    if (ProcessGroup::size() > 1) {
+        exitWithError("numberOfReplicates greater than 1 is not supported "
+            "when running in several processes");
+    }
+
+    if (_settings.get<bool>("resume")) {
+        exitWithError("resume is not supported with several replicates");
+    }
+
+    if (_settings.get<int>("checkpointFreq") > 0) {
+        log(Warning) << "Checkpoints are not written with several "
+            << "replicates.\n";
+    }
+
+    if (_settings.get<double>("targetEffectiveSampleSize") > 0) {
+        log(Warning) << "targetEffectiveSampleSize is ignored with several "
+            << "replicates.\n";
+    }
+
+    if (_sampleFreq <= 0) {
+        exitWithError("numberOfReplicates greater than 1 requires "
+            "mcmcWriteFreq to be positive");
+    }
+
+    if (_settings.get<bool>("asynchronousSwaps")) {
+        log(Warning) << "asynchronousSwaps is not supported with several "
+            << "replicates; using synchronous swaps.\n";
+    }
+
+    _nThreads = ChainWorkerPool::numberOfWorkersFor
+        (_settings, _nReplicates * _settings.get<int>("numberOfChains"));
+
+    // Each replicate gets its own random number stream
+    for (int k = 0; k < _nReplicates; k++) {
+        _randoms.push_back(new Random(random.uniformInteger(0, INT_MAX - 1)));
+        _replicateSettings.push_back(new Settings(replicateSettings(k)));
+        _replicates.push_back(new MetropolisCoupledMCMC
+            (*_randoms[k], *_replicateSettings[k], modelFactory));
+    }
+
+    _samples.assign(NumberOfQuantities,
+        std::vector<std::vector<double> >(_nReplicates));
+}
+
+
+MCMCReplicates::~MCMCReplicates()
+{
+    for (int k = 0; k < _nReplicates; k++) {
+        delete _replicates[k];
+        delete _replicateSettings[k];
+        delete _randoms[k];
+    }
+
+    delete _workerPool;
+    delete _tree;
+}
+
+
+Settings MCMCReplicates::replicateSettings(int replicate) const
+{
+    Settings settings(_settings);
+
+    for (int i = 0; i < NumberOfOutputFileParameters; i++) {
+        const char* name = OutputFileParameters[i];
+        if (!settings.has(name)) {
+            continue;
+        }
+        settings.set(name,
+            Settings::replicateFileName(settings.get(name), replicate));
+    }
+
+    settings.set("asynchronousSwaps", "0");
+    settings.set("checkpointFreq", "0");
+    settings.set("targetEffectiveSampleSize", "0");
+
+    // Only the first replicate prints its cold chain to the screen
+    if (replicate > 0) {
+        settings.set("printFreq", "0");
+    }
+
+    return settings;
+}
+
+
+void MCMCReplicates::run()
+{
+    _tree = new Tree(_settings);
+    _workerPool = new ChainWorkerPool(_nThreads);
+
+    for (int k = 0; k < _nReplicates; k++) {
+        _replicates[k]->start(*_tree, *_workerPool);
+
+        for (int t = 0; t < _replicates[k]->numberOfLocalChains(); t++) {
+            _tasks.push_back(std::make_pair(k, t));
+        }
+    }
+
+    log() << "\nRunning " << _nReplicates << " replicates of "
+          << _settings.get<int>("numberOfChains") << " chains on "
+          << _nThreads << (_nThreads == 1 ? " thread" : " threads")
+          << " for " << _nGenerations << " generations.\n";
+
+    log() << "\n";
+
+    int generation = 0;
+    while (generation < _nGenerations) {
+        int generationEnd = nextGeneration(generation);
+        runReplicates(generation, generationEnd);
+        generation = generationEnd;
+
+        if (isSwapGeneration(generation)) {
+            for (int k = 0; k < _nReplicates; k++) {
+                _replicates[k]->endSwapPeriod(generation);
+            }
+        }
+
+        if (generation % _sampleFreq == 0) {
+            recordColdChainValues();
+        }
+
+        if (_diagnosticsFreq > 0 && generation % _diagnosticsFreq == 0 &&
+                generation < _nGenerations) {
+            logDiagnostics(generation);
+        }
+    }
+
+    if (_settings.get<int>("numberOfChains") > 1) {
+        for (int k = 0; k < _nReplicates; k++) {
+            log() << "\nReplicate " << k + 1 << ":";
+            _replicates[k]->finish();
+        }
+    }
+    log() << "\n";
+
+    logDiagnostics(_nGenerations);
+}
+
+
+void MCMCReplicates::runReplicates(int genStart, int genEnd)
+{
+    _workerPool->run((int)_tasks.size(),
+        [this, genStart, genEnd](int i) {
+            _replicates[_tasks[i].first]->runLocalChain
+                (_tasks[i].second, genStart, genEnd);
+        });
+}
+
+
+// The replicates stop at every swap and every sample
+int MCMCReplicates::nextGeneration(int generation) const
+{
+    int next = (generation / _sampleFreq + 1) * _sampleFreq;
+
+    if (_swapPeriod > 0) {
+        next = std::min(next, (generation / _swapPeriod + 1) * _swapPeriod);
+    }
+
+    if (_diagnosticsFreq > 0) {
+        next = std::min(next,
+            (generation / _diagnosticsFreq + 1) * _diagnosticsFreq);
+    }
+
+    return std::min(next, _nGenerations);
+}
+
+
+// A single MC3 group ends a swap period every swapPeriod generations
+// and at the last generation
+bool MCMCReplicates::isSwapGeneration(int generation) const
+{
+    return _swapPeriod > 0 &&
+        (generation % _swapPeriod == 0 || generation == _nGenerations);
+}
+
+
+void MCMCReplicates::recordColdChainValues()
+{
+    for (int k = 0; k < _nReplicates; k++) {
+        Model& model = _replicates[k]->coldChainModel();
+        _samples[0][k].push_back(model.getCurrentLogLikelihood());
+        _samples[1][k].push_back(model.getNumberOfEvents());
+        _samples[2][k].push_back(model.getEventRate());
+    }
+}
+
+
+// The first half of the samples is discarded as burn-in
+void MCMCReplicates::logDiagnostics(int generation) const
+{
+    int nSamples = (int)_samples[0][0].size();
+    int nKept = nSamples / 2;
+
+    log() << "Replicate diagnostics at generation " << generation;
+
+    if (nKept < MinimumSamplesForDiagnostics) {
+        log() << ": too few samples.\n\n";
+        return;
+    }
+
+    log() << " (last " << nKept << " of " << nSamples
+          << " samples per replicate):\n";
+    log() << "                   R-hat         ESS\n";
+
+    for (int q = 0; q < NumberOfQuantities; q++) {
+        std::vector<std::vector<double> > chains;
+        for (int k = 0; k < _nReplicates; k++) {
+            const std::vector<double>& values = _samples[q][k];
+            chains.push_back(std::vector<double>
+                (values.end() - nKept, values.end()));
+        }
+
+        std::ostringstream line;
+        line << std::setw(12) << QuantityNames[q]
+             << std::fixed << std::setprecision(3)
+             << std::setw(12) << Stat::potentialScaleReduction(chains)
+             << std::setprecision(1)
+             << std::setw(12) << Stat::effectiveSampleSize(chains);
+        log() << line.str() << "\n";
+    }
+
+    log() << "\n";
+}
@@ -0,0 +1,72 @@
+#ifndef MCMC_REPLICATES_H
+#define MCMC_REPLICATES_H
+
+
+#include "Settings.h"
+#include <vector>
+#include <string>
+#include <utility>
+
+class Random;
+class ModelFactory;
+class MetropolisCoupledMCMC;
+class Tree;
+class ChainWorkerPool;
+
+
+// Runs several independent MC3 groups (replicates) side by side in one
+// process. The replicates share the tree and the worker pool: every swap
+// period, the chains of all replicates are scheduled together, then each
+// replicate attempts its own chain swaps. Replicate k writes its output to
+// files with "_rep<k>" inserted before the extension. The cold chains are
+// sampled every mcmcWriteFreq generations, and the potential scale
+// reduction (R-hat) and effective sample size of logLik, N_shifts and
+// eventRate across replicates are reported periodically.
+
+class MCMCReplicates
+{
+public:
+
+    MCMCReplicates
+        (Random& random, Settings& settings, ModelFactory* modelFactory);
+    ~MCMCReplicates();
+
+    void run();
+
+private:
+
+    Settings replicateSettings(int replicate) const;
+
+    void runReplicates(int genStart, int genEnd);
+    int nextGeneration(int generation) const;
+    bool isSwapGeneration(int generation) const;
+
+    void recordColdChainValues();
+    void logDiagnostics(int generation) const;
+
+    Settings& _settings;
+
+    std::vector<Random*> _randoms;
+    std::vector<Settings*> _replicateSettings;
+    std::vector<MetropolisCoupledMCMC*> _replicates;
+    int _nReplicates;
+
+    Tree* _tree;
+    ChainWorkerPool* _workerPool;
+    int _nThreads;
+
+    // (replicate, local chain) of each task handed to the worker pool
+    std::vector<std::pair<int, int> > _tasks;
+
+    int _nGenerations;
+    int _swapPeriod;
+    int _sampleFreq;
+    int _diagnosticsFreq;
+
+    // _samples[q][k] holds the values of quantity q (logLik, N_shifts,
+    // eventRate) sampled from the cold chain of replicate k
+    std::vector<std::vector<std::vector<double> > > _samples;
+};
+
+
+#endif
@@ -1177,6 +1177,40 @@ long int MbRandom::getSeed(void) {
     return seed;
 }
 
+/*!
+ * This function gets the complete state of the generator: the seed and
+ * the extra normal random variable kept from the last pair generated.
+ *
+ * \brief Return the generator state.
+ * \param s [out] the current seed
+ * \param hasNormal [out] whether an extra normal random variable is available
+ * \param normal [out] the extra normal random variable
+ * \return This function does not return anything.
+ * \throws Does not throw an error.
+ */
+void MbRandom::getState(long int* s, bool* hasNormal, double* normal) {
+    *s = seed;
+    *hasNormal = availableNormalRv;
+    *normal = extraNormalRv;
+}
+
+/*!
+ * This function restores a state returned by getState, so that the
+ * generator continues the same stream of random variables.
+ *
+ * \brief Restore the generator state.
+ * \param s the seed
+ * \param hasNormal whether an extra normal random variable is available
+ * \param normal the extra normal random variable
+ * \return This function does not return anything.
+ * \throws Does not throw an error.
+ */
+void MbRandom::setState(long int s, bool hasNormal, double normal) {
+    seed = s;
+    availableNormalRv = hasNormal;
+    extraNormalRv = normal;
+}
+
 /*!
  * This function calculates the log of the gamma function, which is equal to:
  * Gamma(alp) = {integral from 0 to infinity} t^{alp-1} e^-t dt
@@ -63,6 +63,8 @@ class MbRandom {
                              MbRandom(void);                                                                           /*!< constructor: initializes the seed with current time                            */
                              MbRandom(long int x);                                                                     /*!< constructor: initializes the seed with supplied value                          */
                   long int   getSeed(void);                                                                            /*!< retreives the seeds                                                            */
+                      void   getState(long int* s, bool* hasNormal, double* normal);                                   /*!< retrieves the complete generator state                                         */
+                      void   setState(long int s, bool hasNormal, double normal);                                      /*!< restores the complete generator state                                          */
                       void   setSeed(void);                                                                            /*!< initializes the seeds using the current time                                   */
                       void   setSeed(long int s);                                                                      /*!< initializes the seeds                                                          */
                     double   chiSquareRv(double v);                                                   /* chi square */ /*!< Chi-square random variable                                                     */
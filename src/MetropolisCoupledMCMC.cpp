@@ -3,31 +3,182 @@
 #include "Random.h"
 #include "Settings.h"
 #include "ModelFactory.h"
+#include "Tree.h"
 #include "MCMC.h"
 #include "Model.h"
 #include "ModelDataWriter.h"
 #include "ChainSwapDataWriter.h"
+#include "ChainWorkerPool.h"
+#include "ProcessGroup.h"
+#include "Checkpoint.h"
+#include "Log.h"
 
 #include <algorithm>
-#include <thread>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <fstream>
+#include <cstdio>
 
 
 MetropolisCoupledMCMC::MetropolisCoupledMCMC
     (Random& random, Settings& settings, ModelFactory* modelFactory) :
         _random(random), _settings(settings), _modelFactory(modelFactory),
-        _chainSwapDataWriter(_settings)
+        _tree(NULL), _ownsTreeAndWorkerPool(false), _workerPool(NULL),
+        _chainSwapDataWriter(_settings), _essMonitor(_settings),
+        _proposalProfileDataWriter(_settings)
 {
     // Total number of generations to run for each chain
     _nGenerations = _settings.get<int>("numberOfGenerations");
 
     // MC3 settings
     _nChains = _settings.get<int>("numberOfChains");
+    assignChainsToProcesses();
+    _nThreads = ChainWorkerPool::numberOfWorkersFor
+        (_settings, (int)_localChains.size());
     _deltaT = _settings.get<double>("deltaT");
     _swapPeriod = _settings.get<int>("swapPeriod");
 
+    _chainSwapScheme = _settings.get("chainSwapScheme");
+    if (_chainSwapScheme != "random" && _chainSwapScheme != "deo") {
+        exitWithError("chainSwapScheme must be \"random\" or \"deo\"");
+    }
+    _swapSweep = 0;
+
+    _temperatureAdaptationGenerations =
+        _settings.get<int>("temperatureAdaptationGenerations");
+    _adjacentSwapSamples = 0;
+    _adaptationRoundLength = 1;
+
     _coldChainIndex = 0;
 
+    _autotune = _settings.get<bool>("autotune");
+    _autotuneGenerations = _settings.get<int>("autotuneGenerations");
+    _proposalScalesLogged = false;
+
+    _adaptProposalWeights = _settings.get<bool>("adaptProposalWeights");
+    _proposalWeightAdaptationGenerations =
+        _settings.get<int>("proposalWeightAdaptationGenerations");
+    _proposalWeightsLogged = false;
+
     _acceptanceResetFreq = _settings.get<int>("acceptanceResetFreq");
+
+    _speculativeThreads = _settings.get<int>("speculativeThreads");
+    if (_speculativeThreads > 0 && _nChains > 1) {
+        log(Warning) << "speculativeThreads is ignored when "
+            << "numberOfChains is greater than 1.\n";
+        _speculativeThreads = 0;
+    }
+
+    // These depend on the outcome of every proposal as it is made,
+    // including the speculative proposals that are discarded
+    if (_speculativeThreads > 0 && (_autotune || _adaptProposalWeights ||
+            _settings.get<bool>("outputProposalProfile"))) {
+        log(Warning) << "speculativeThreads is ignored with autotune, "
+            << "adaptProposalWeights or outputProposalProfile.\n";
+        _speculativeThreads = 0;
+    }
+
+    _eventLocationThreads = _settings.get<int>("eventLocationThreads");
+    if (_eventLocationThreads < 0) {
+        exitWithError("eventLocationThreads must be 0 or positive");
+    }
+    if (_settings.get<int>("eventLocationTries") <= 1) {
+        _eventLocationThreads = 0;
+    }
+    if (_eventLocationThreads > 1 &&
+            (_nChains > 1 || _speculativeThreads > 0)) {
+        log(Warning) << "eventLocationThreads is ignored when "
+            << "numberOfChains is greater than 1 or with speculativeThreads.\n";
+        _eventLocationThreads = 0;
+    }
+
+    _multiStartChains = _settings.get<int>("multiStartChains");
+    _multiStartGenerations = _settings.get<int>("multiStartGenerations");
+    if (_multiStartChains < 0 || _multiStartGenerations < 0) {
+        exitWithError("multiStartChains and multiStartGenerations "
+            "must be 0 or positive");
+    }
+
+    // The starts would be ranked separately in every process
+    if (_multiStartChains > 0 && ProcessGroup::size() > 1) {
+        log(Warning) << "multiStartChains is ignored when running "
+            << "in several processes.\n";
+        _multiStartChains = 0;
+    }
+
+    _proposalProfileFreq = _settings.get<int>("proposalProfileFreq");
+    _lastSwapPeriodEnd = 0;
+    _lastProfileGeneration = 0;
+
+    _asynchronousSwaps = _settings.get<bool>("asynchronousSwaps");
+
+    if (_asynchronousSwaps && ProcessGroup::size() > 1) {
+        log(Warning) << "asynchronousSwaps is not supported when running "
+            << "in several processes; using synchronous swaps.\n";
+        _asynchronousSwaps = false;
+    }
+
+    if (_asynchronousSwaps && _temperatureAdaptationGenerations > 0) {
+        log(Warning) << "Temperatures are not adapted "
+            << "when asynchronousSwaps is 1.\n";
+        _temperatureAdaptationGenerations = 0;
+    }
+
+    _populationMCMC = _settings.get<bool>("populationMCMC");
+    _differentialEvolutionSweeps =
+        _settings.get<int>("differentialEvolutionSweeps");
+    _differentialEvolutionNoise =
+        _settings.get<double>("differentialEvolutionNoise");
+    _differentialEvolutionJumps = 0;
+    _acceptedDifferentialEvolutionJumps = 0;
+
+    // Each half of the population needs two chains to take differences
+    // between, and all chains must be in one place at swap periods
+    if (_populationMCMC && (_nChains < 4 || _asynchronousSwaps ||
+            ProcessGroup::size() > 1)) {
+        log(Warning) << "populationMCMC needs at least 4 chains, "
+            << "synchronous swaps and a single process; "
+            << "running Metropolis-coupled MCMC.\n";
+        _populationMCMC = false;
+    }
+
+    if (_populationMCMC && _differentialEvolutionNoise <= 0.0) {
+        exitWithError("differentialEvolutionNoise must be > 0");
+    }
+
+    if (_populationMCMC) {
+        _deltaT = 0.0;
+        _temperatureAdaptationGenerations = 0;
+    }
+
+    _checkpointFreq = _settings.get<int>("checkpointFreq");
+    _checkpointFileName = _settings.get("checkpointFileName");
+    _resume = _settings.get<bool>("resume");
+
+    // Chains only stop together at the end of synchronous swap periods
+    if (_resume && (_asynchronousSwaps || ProcessGroup::size() > 1)) {
+        exitWithError("resume is not supported with asynchronousSwaps "
+            "or when running in several processes");
+    }
+
+    if (_checkpointFreq > 0 &&
+            (_asynchronousSwaps || ProcessGroup::size() > 1)) {
+        log(Warning) << "Checkpoints are not written with asynchronousSwaps "
+            << "or when running in several processes.\n";
+        _checkpointFreq = 0;
+    }
+
+    // The cold chain's samples are only in one place at swap periods
+    // with synchronous swaps in a single process
+    if (_essMonitor.isEnabled() &&
+            (_asynchronousSwaps || ProcessGroup::size() > 1)) {
+        log(Warning) << "targetEffectiveSampleSize is ignored with "
+            << "asynchronousSwaps or when running in several processes.\n";
+        _essMonitor.disable();
+    }
 }
 
 
@@ -38,40 +189,475 @@ MetropolisCoupledMCMC::~MetropolisCoupledMCMC()
     }
 
     delete _dataWriter;
+
+    if (_ownsTreeAndWorkerPool) {
+        delete _workerPool;
+        delete _tree;
+    }
 }
 
 
 void MetropolisCoupledMCMC::run()
 {
-     createChains();
-    createDataWriter();
- 
-    log() << "\nRunning " << _chains.size() << " chains for "
-          << _nGenerations << " generations.\n";
+    _tree = new Tree(_settings);
+    _workerPool = new ChainWorkerPool(_nThreads);
+    _ownsTreeAndWorkerPool = true;
 
-    log() << "\n";
+    createChains();
+
+    if (_multiStartChains > 0 && !_resume) {
+        runMultiStartBurnIn();
+    }
 
     int generation = 0;
+    if (_resume) {
+        generation = readCheckpoint();
+        _proposalScalesLogged = generation >= _autotuneGenerations;
+        _proposalWeightsLogged =
+            generation >= _proposalWeightAdaptationGenerations;
+        _lastProfileGeneration = generation;
+    }
+
+    createDataWriter();
+
+    if (_checkpointFreq > 0) {
+        Checkpoint::installSignalHandlers();
+    }
+
+    if (ProcessGroup::isRoot()) {
+        log() << "\nRunning " << _nChains << " chains";
+        if (ProcessGroup::size() > 1) {
+            log() << " in " << ProcessGroup::size() << " processes";
+        }
+        log() << " on " << _nThreads
+              << (_nThreads == 1 ? " thread" : " threads")
+              << (ProcessGroup::size() > 1 ? " each" : "") << " for "
+              << _nGenerations << " generations.\n";
+
+        log() << "\n";
+    }
+
+    if (_asynchronousSwaps && _nChains > 1 && _swapPeriod > 0) {
+        runAsynchronously();
+        _lastSwapPeriodEnd = _nGenerations;
+        finish();
+        return;
+    }
+
+    bool targetReached = false;
+
     while (generation < _nGenerations) {
         int generationEnd = std::min(generation + _swapPeriod, _nGenerations);
         runChains(generation, generationEnd);
+        endSwapPeriod(generationEnd);
+
+        if (shouldWriteCheckpoint(generation, generationEnd)) {
+            writeCheckpoint(generationEnd);
+        }
+
+        if (_essMonitor.shouldCheck(generation, generationEnd)) {
+            targetReached = _essMonitor.isTargetReached();
+        }
+
         generation = generationEnd;
+
+        if (targetReached) {
+            break;
+        }
+
+        if (Checkpoint::stopRequested()) {
+            log() << "\nStopped at generation " << generation
+                  << "; resume with --resume 1.\n";
+            break;
+        }
+    }
+
+    if (_essMonitor.isEnabled()) {
+        if (!targetReached) {
+            targetReached = _essMonitor.isTargetReached();
+        }
+        _essMonitor.logEffectiveSampleSizes(generation, targetReached);
+    }
+
+    logBarrierWaitTimes();
+    finish();
+}
+
+
+bool MetropolisCoupledMCMC::shouldWriteCheckpoint
+    (int previousGeneration, int generation) const
+{
+    if (_checkpointFreq == 0) {
+        return false;
+    }
+
+    return generation / _checkpointFreq > previousGeneration / _checkpointFreq
+        || Checkpoint::stopRequested();
+}
+
+
+// The file is written under a temporary name first, so that a run killed
+// while writing it still has the previous checkpoint
+void MetropolisCoupledMCMC::writeCheckpoint(int generation) const
+{
+    std::string tempFileName = _checkpointFileName + ".tmp";
+    std::ofstream out(tempFileName.c_str(), std::ios::binary);
+
+    Checkpoint::writeHeader(out, generation);
+    Checkpoint::write(out, _nChains);
+    _random.writeState(out);
+
+    Checkpoint::writeVector(out, _temperatures);
+    Checkpoint::write(out, _coldChainIndex);
+    Checkpoint::write(out, _swapSweep);
+    Checkpoint::writeVector(out, _adjacentSwapProbabilitySums);
+    Checkpoint::write(out, _adjacentSwapSamples);
+    Checkpoint::write(out, _adaptationRoundLength);
+    _chainSwapDataWriter.writeState(out);
+    _essMonitor.writeState(out);
+
+    for (int i = 0; i < _nChains; i++) {
+        _chains[i]->writeState(out);
+    }
+
+    out.close();
+
+    if (!out || std::rename
+            (tempFileName.c_str(), _checkpointFileName.c_str()) != 0) {
+        log(Warning) << "Could not write checkpoint file <<"
+            << _checkpointFileName << ">>.\n";
+    }
+}
+
+
+// Returns the generation at which the checkpoint was written
+int MetropolisCoupledMCMC::readCheckpoint()
+{
+    std::ifstream in(_checkpointFileName.c_str(), std::ios::binary);
+    if (!in) {
+        exitWithError("Could not read checkpoint file <<" +
+            _checkpointFileName + ">>");
+    }
+
+    int generation = Checkpoint::readHeader(in, _checkpointFileName);
+
+    int nChains = 0;
+    Checkpoint::read(in, nChains);
+    if (nChains != _nChains) {
+        exitWithError("numberOfChains differs from the checkpoint");
+    }
+
+    _random.readState(in);
+
+    Checkpoint::readVector(in, _temperatures);
+    Checkpoint::read(in, _coldChainIndex);
+    Checkpoint::read(in, _swapSweep);
+    Checkpoint::readVector(in, _adjacentSwapProbabilitySums);
+    Checkpoint::read(in, _adjacentSwapSamples);
+    Checkpoint::read(in, _adaptationRoundLength);
+    _chainSwapDataWriter.readState(in);
+    _essMonitor.readState(in);
+
+    for (int i = 0; i < _nChains; i++) {
+        _chains[i]->readState(in);
+    }
+
+    if (!in) {
+        exitWithError("Checkpoint file <<" + _checkpointFileName +
+            ">> is incomplete");
+    }
+
+    log() << "\nResuming from the checkpoint at generation "
+          << generation << ".\n";
+
+    return generation;
+}
+
+
+void MetropolisCoupledMCMC::start(Tree& tree, ChainWorkerPool& workerPool)
+{
+    _tree = &tree;
+    _workerPool = &workerPool;
+
+    createChains();
+
+    if (_multiStartChains > 0) {
+        runMultiStartBurnIn();
+    }
+
+    createDataWriter();
+}
+
+
+int MetropolisCoupledMCMC::numberOfLocalChains() const
+{
+    return (int)_localChains.size();
+}
+
+
+void MetropolisCoupledMCMC::runLocalChain(int t, int genStart, int genEnd)
+{
+    int i = _localChains[t];
+    runChain(i, genStart, genEnd, i == _coldChainIndex);
+}
+
+
+void MetropolisCoupledMCMC::endSwapPeriod(int generation)
+{
+    if (ProcessGroup::size() > 1) {
+        exchangeLogPosteriors();
+    }
+
+    if (_populationMCMC) {
+        sweepDifferentialEvolution();
+    } else {
         tryChainSwap(generation);
     }
+
+    if (generation <= _temperatureAdaptationGenerations) {
+        adaptTemperatures(generation);
+    }
+
+    if (generation >= _autotuneGenerations) {
+        logProposalScales();
+    }
+
+    if (generation >= _proposalWeightAdaptationGenerations) {
+        logProposalWeights();
+    }
+
+    _lastSwapPeriodEnd = generation;
+    if (generation - _lastProfileGeneration >= _proposalProfileFreq) {
+        writeProposalProfiles(generation);
+    }
+}
+
+
+void MetropolisCoupledMCMC::finish()
+{
+    // Runs shorter than the tuning period (or with asynchronous swaps)
+    logProposalScales();
+    logProposalWeights();
+
+    // Population MCMC proposes no swaps
+    if (!_populationMCMC) {
+        _chainSwapDataWriter.logSummary();
+    }
+
+    if (_populationMCMC && _differentialEvolutionJumps > 0) {
+        log() << "\nDifferential-evolution jumps accepted: "
+              << _acceptedDifferentialEvolutionJumps << " of "
+              << _differentialEvolutionJumps << "\n";
+    }
+
+    // The last window may be shorter than proposalProfileFreq
+    writeProposalProfiles(_lastSwapPeriodEnd);
+    _proposalProfileDataWriter.logSummary();
+}
+
+
+// Writes the profiling window of every local chain,
+// from the coldest chain to the hottest
+void MetropolisCoupledMCMC::writeProposalProfiles(int generation)
+{
+    std::vector<int> chainsByTemp = chainsOrderedByTemperature();
+    for (int i = 0; i < (int)chainsByTemp.size(); i++) {
+        int chain = chainsByTemp[i];
+        if (isLocalChain(chain)) {
+            _proposalProfileDataWriter.writeData(generation, chain,
+                chainTemperature(chain), _chains[chain]->model());
+        }
+    }
+
+    _lastProfileGeneration = generation;
+}
+
+
+// Logs the tuned scales of the local chains once
+void MetropolisCoupledMCMC::logProposalScales()
+{
+    if (!_autotune || _proposalScalesLogged) {
+        return;
+    }
+    _proposalScalesLogged = true;
+
+    logProposalSettings("Proposal scales after tuning", false);
+}
+
+
+// Logs the rebalanced weights of the local chains once
+void MetropolisCoupledMCMC::logProposalWeights()
+{
+    if (!_adaptProposalWeights || _proposalWeightsLogged) {
+        return;
+    }
+    _proposalWeightsLogged = true;
+
+    logProposalSettings("Proposal weights after adaptation", true);
+}
+
+
+// Logs the proposal scales or weights of the local chains, from the
+// coldest chain to the hottest, in the units of the settings
+void MetropolisCoupledMCMC::logProposalSettings
+    (const std::string& title, bool weights)
+{
+    log() << "\n" << title << ":\n";
+
+    std::vector<int> chainsByTemp = chainsOrderedByTemperature();
+    for (int i = 0; i < (int)chainsByTemp.size(); i++) {
+        int chain = chainsByTemp[i];
+        if (!isLocalChain(chain)) {
+            continue;
+        }
+
+        log() << "    Chain " << chain + 1 << " (temperature "
+              << chainTemperature(chain) << "):";
+
+        Model& model = _chains[chain]->model();
+        std::vector<std::pair<std::string, double> > values =
+            weights ? model.proposalWeights() : model.proposalScales();
+        for (int k = 0; k < (int)values.size(); k++) {
+            log() << " " << values[k].first << " = " << values[k].second;
+        }
+        log() << "\n";
+    }
+
+    log() << "\n";
+}
+
+
+Model& MetropolisCoupledMCMC::coldChainModel()
+{
+    return _chains[_coldChainIndex]->model();
+}
+
+
+void MetropolisCoupledMCMC::assignChainsToProcesses()
+{
+    if (_nChains < ProcessGroup::size()) {
+        exitWithError("numberOfChains must be at least "
+            "the number of processes");
+    }
+
+    for (int i = 0; i < _nChains; i++) {
+        if (i % ProcessGroup::size() == ProcessGroup::rank()) {
+            _localChains.push_back(i);
+        }
+    }
 }
 
 
 void MetropolisCoupledMCMC::createChains()
 {
     for (int i = 0; i < _nChains; i++) {
-        _chains.push_back(createMCMC(i));
+        _temperatures.push_back(calculateTemperature(i, _deltaT));
+
+        if (isLocalChain(i)) {
+            _chains.push_back(createMCMC(i));
+        } else {
+            // Draw the seed the chain would have taken (see MCMC),
+            // so that every chain gets the same seed in every process
+            _random.uniformInteger(0, INT_MAX - 1);
+            _chains.push_back(NULL);
+        }
+    }
+}
+
+
+// The starts run on their own threads (up to the available ones), which
+// the chains of the run may not use all of
+void MetropolisCoupledMCMC::runMultiStartBurnIn()
+{
+    int nStarts = _multiStartChains;
+
+    int nThreads = ChainWorkerPool::numberOfWorkersFor(_settings, nStarts);
+
+    std::vector<MCMC*> starts;
+    for (int j = 0; j < nStarts; j++) {
+        starts.push_back(new MCMC(_random, _settings, *_modelFactory, *_tree));
+    }
+
+    // The first start keeps the initial state; the others are dispersed
+    // around the prior, with between 0 and twice the expected number of
+    // events. A configuration with an infinite log-likelihood is
+    // replaced by the initial one.
+    std::vector<int> initialEvents;
+    for (int j = 0; j < nStarts; j++) {
+        Model& model = starts[j]->model();
+
+        if (j > 0) {
+            int maxEvents = (int)std::ceil(2.0 * model.getEventRate());
+            int numberOfEvents = _random.uniformInteger(0, maxEvents);
+
+            std::stringstream initialState;
+            model.writeSampledState(initialState);
+            model.setRandomEventConfiguration(numberOfEvents);
+            if (!std::isfinite(model.getCurrentLogLikelihood())) {
+                model.readSampledState(initialState);
+            }
+        }
+
+        initialEvents.push_back(model.getNumberOfEvents());
+    }
+
+    log() << "\nMulti-start burn-in: running " << nStarts
+          << (nStarts == 1 ? " chain" : " chains") << " on " << nThreads
+          << (nThreads == 1 ? " thread" : " threads") << " for "
+          << _multiStartGenerations << " generations.\n";
+
+    ChainWorkerPool pool(nThreads);
+    pool.run(nStarts, [&](int j) {
+        starts[j]->run(_multiStartGenerations);
+    });
+
+    std::vector<double> logPosteriors;
+    std::vector<int> ranking;
+    for (int j = 0; j < nStarts; j++) {
+        logPosteriors.push_back(calculateLogPosterior(starts[j]->model()));
+        ranking.push_back(j);
+    }
+
+    std::stable_sort(ranking.begin(), ranking.end(), [&](int a, int b) {
+        return logPosteriors[a] > logPosteriors[b];
+    });
+
+    log() << "    Start  Initial events  Final events  Log-posterior\n";
+    for (int r = 0; r < nStarts; r++) {
+        int j = ranking[r];
+        std::ostringstream row;
+        row << std::setw(9) << (j + 1)
+            << std::setw(16) << initialEvents[j]
+            << std::setw(14) << starts[j]->model().getNumberOfEvents()
+            << std::setw(15) << std::fixed << std::setprecision(2)
+            << logPosteriors[j];
+        log() << row.str() << "\n";
+    }
+
+    // From the coldest chain to the hottest, the best starts first
+    // (cycling through them if there are more chains than starts)
+    std::vector<int> chainsByTemp = chainsOrderedByTemperature();
+    for (int r = 0; r < (int)chainsByTemp.size(); r++) {
+        int chain = chainsByTemp[r];
+        if (isLocalChain(chain)) {
+            _chains[chain]->setSampledState
+                (starts[ranking[r % nStarts]]->model());
+        }
+    }
+
+    log() << "The run starts from the best states; "
+          << "its samples still include a burn-in.\n";
+
+    for (int j = 0; j < nStarts; j++) {
+        delete starts[j];
     }
 }
 
 
 MCMC* MetropolisCoupledMCMC::createMCMC(int chainIndex) const
 {
-    MCMC* mcmc = new MCMC(_random, _settings, *_modelFactory);
+    MCMC* mcmc = new MCMC(_random, _settings, *_modelFactory, *_tree,
+        _speculativeThreads, _eventLocationThreads);
     mcmc->model().setTemperatureMH(calculateTemperature(chainIndex, _deltaT));
     return mcmc;
 }
@@ -90,54 +676,356 @@ void MetropolisCoupledMCMC::createDataWriter()
     //  such as updateRatePreservationRate within the SpeciationExtinction
     // Parameters block, this line of code will cause an error for BAMM trait
  
-    _dataWriter = _modelFactory->createModelDataWriter(_settings);
- 
+    if (ProcessGroup::size() == 1) {
+        _dataWriter = _modelFactory->createModelDataWriter(_settings);
+        return;
+    }
+
+    // The cold chain moves between processes as temperatures are swapped,
+    // and whichever process has it writes its data. Other processes
+    // create their writers (truncating the files) before the root process
+    // creates the files with their headers; then all of them append.
+    if (!ProcessGroup::isRoot()) {
+        _dataWriter = _modelFactory->createModelDataWriter(_settings);
+    }
+
+    ProcessGroup::barrier();
 
+    if (ProcessGroup::isRoot()) {
+        _dataWriter = _modelFactory->createModelDataWriter(_settings);
+    }
+
+    _dataWriter->appendToExistingOutput(!ProcessGroup::isRoot());
 }
 
 
 void MetropolisCoupledMCMC::runChains(int genStart, int genEnd)
 {
-    std::vector<std::thread> chainThreads;
-    chainThreads.reserve(_chains.size());
+    _workerPool->run((int)_localChains.size(),
+        [this, genStart, genEnd](int t) {
+            runLocalChain(t, genStart, genEnd);
+        });
+}
 
-    for (int i = 0; i < (int)_chains.size(); i++) {
-        chainThreads.push_back(std::thread
-            {&MetropolisCoupledMCMC::runChain, this, i, genStart, genEnd});
+
+void MetropolisCoupledMCMC::runChain
+    (int i, int genStart, int genEnd, bool isColdChain)
+{
+    if (_chains[i]->isSpeculative()) {
+        _chains[i]->runSpeculatively(genStart, genEnd,
+            [this](int g, Model& model) {
+                recordColdChainGeneration(g, model);
+            });
+        return;
     }
 
-    for (std::thread& chainThread : chainThreads) {
-        chainThread.join();
+    for (int g = genStart; g < genEnd; g++) {
+        _chains[i]->step();
+
+        if (isColdChain) {
+            recordColdChainGeneration(g, _chains[i]->model());
+        }
     }
 }
 
 
-void MetropolisCoupledMCMC::runChain(int i, int genStart, int genEnd)
+void MetropolisCoupledMCMC::recordColdChainGeneration
+    (int generation, Model& model)
 {
-    for (int g = genStart; g < genEnd; g++) {
-        _chains[i]->step();
+    _dataWriter->writeData(generation, model);
+    _essMonitor.recordSample(generation, model);
+
+    if (generation % _acceptanceResetFreq == 0) {
+        model.resetMHAcceptanceParameters();
+    }
+}
+
+
+void MetropolisCoupledMCMC::logBarrierWaitTimes() const
+{
+    if (_nThreads == 1 || !ProcessGroup::isRoot()) {
+        return;
+    }
+
+    log() << "\nTime each thread spent waiting for the other threads "
+          << "before swaps (s):\n";
+    for (int i = 0; i < _workerPool->numberOfWorkers(); i++) {
+        std::ostringstream waitTime;
+        waitTime << std::fixed << std::setprecision(3)
+                 << _workerPool->barrierWaitTime(i);
+        log() << "    Thread " << i + 1 << ": " << waitTime.str() << "\n";
+    }
+}
+
+
+std::vector<double> MetropolisCoupledMCMC::temperatureLadder() const
+{
+    std::vector<int> chainsByTemp = chainsOrderedByTemperature();
+
+    std::vector<double> temps;
+    for (int i = 0; i < (int)chainsByTemp.size(); i++) {
+        temps.push_back(chainTemperature(chainsByTemp[i]));
+    }
+    return temps;
+}
+
+
+void MetropolisCoupledMCMC::adaptTemperatures(int generation)
+{
+    // Only intermediate temperatures move, so at least three are needed
+    if (_nChains < 3 || _swapPeriod == 0) {
+        return;
+    }
 
-        if (i == _coldChainIndex) {
-            _dataWriter->writeData(g, _chains[i]->model());
+    recordAdjacentSwapProbabilities();
 
-            if (g % _acceptanceResetFreq == 0) {
-                _chains[i]->model().resetMHAcceptanceParameters();
+    bool isLastPeriod = generation + _swapPeriod >
+        std::min(_temperatureAdaptationGenerations, _nGenerations);
+
+    if (_adjacentSwapSamples == _adaptationRoundLength || isLastPeriod) {
+        updateTemperatureLadder();
+        _adaptationRoundLength *= 2;
+    }
+
+    if (isLastPeriod && ProcessGroup::isRoot()) {
+        std::vector<double> temps = temperatureLadder();
+        log() << "\nTemperatures after adaptation (generation "
+              << generation << "):";
+        for (int i = 0; i < (int)temps.size(); i++) {
+            log() << " " << temps[i];
+        }
+        log() << "\n\n";
+    }
+}
+
+
+void MetropolisCoupledMCMC::recordAdjacentSwapProbabilities()
+{
+    std::vector<int> chainsByTemp = chainsOrderedByTemperature();
+    int nPairs = (int)chainsByTemp.size() - 1;
+
+    if (_adjacentSwapSamples == 0) {
+        _adjacentSwapProbabilitySums.assign(nPairs, 0.0);
+    }
+
+    for (int k = 0; k < nPairs; k++) {
+        _adjacentSwapProbabilitySums[k] +=
+            chainSwapProbability(chainsByTemp[k], chainsByTemp[k + 1]);
+    }
+
+    _adjacentSwapSamples++;
+}
+
+
+// Places the temperatures so that the cumulative rejection rate along the
+// ladder (the "communication barrier") is split into equal parts, using
+// piecewise-linear interpolation of the current estimate
+void MetropolisCoupledMCMC::updateTemperatureLadder()
+{
+    std::vector<int> chainsByTemp = chainsOrderedByTemperature();
+    std::vector<double> temps = temperatureLadder();
+    int nTemps = (int)temps.size();
+
+    // A small floor keeps the barrier strictly increasing
+    std::vector<double> barrier(nTemps, 0.0);
+    for (int k = 0; k < nTemps - 1; k++) {
+        double rejectionRate = 1.0 -
+            _adjacentSwapProbabilitySums[k] / _adjacentSwapSamples;
+        barrier[k + 1] = barrier[k] + std::max(rejectionRate, 1e-6);
+    }
+
+    std::vector<double> newTemps(temps);
+    int k = 0;
+    for (int j = 1; j < nTemps - 1; j++) {
+        double target = barrier[nTemps - 1] * j / (nTemps - 1);
+        while (barrier[k + 1] < target) {
+            k++;
+        }
+
+        double fraction = (target - barrier[k]) / (barrier[k + 1] - barrier[k]);
+        newTemps[j] = temps[k] + fraction * (temps[k + 1] - temps[k]);
+    }
+
+    for (int j = 0; j < nTemps; j++) {
+        setChainTemperature(chainsByTemp[j], newTemps[j]);
+    }
+
+    _adjacentSwapSamples = 0;
+}
+
+
+// The population is split into the even and the odd chains. Each chain
+// of one half jumps by a multiple of the difference between the global
+// parameters of two chains of the other half, which stays fixed
+// meanwhile (ter Braak 2006; ter Braak and Vrugt 2008), so the chains of
+// a half can jump in parallel. The multiple is 2.38 / sqrt(2d) for d
+// parameters, or 1 for one jump in ten, to move between modes. Parameters
+// held fixed by their update rates do not jump.
+void MetropolisCoupledMCMC::sweepDifferentialEvolution()
+{
+    std::vector<int> halves[2];
+    for (int i = 0; i < _nChains; i++) {
+        halves[i % 2].push_back(i);
+    }
+
+    std::vector<bool> isFixed = _chains[0]->model().fixedGlobalParameters();
+    int numberOfParameters =
+        (int)std::count(isFixed.begin(), isFixed.end(), false);
+    if (numberOfParameters == 0) {
+        return;
+    }
+
+    double gamma = 2.38 / std::sqrt(2.0 * numberOfParameters);
+
+    for (int sweep = 0; sweep < _differentialEvolutionSweeps; sweep++) {
+        jumpGlobalParameters(halves[0], halves[1], isFixed, gamma);
+        jumpGlobalParameters(halves[1], halves[0], isFixed, gamma);
+    }
+}
+
+
+void MetropolisCoupledMCMC::jumpGlobalParameters(const std::vector<int>&
+    chains, const std::vector<int>& partners,
+    const std::vector<bool>& isFixed, double gamma)
+{
+    int numberOfChains = (int)chains.size();
+    int numberOfPartners = (int)partners.size();
+
+    // Jumps are drawn here, in chain order, so that they do not depend
+    // on the threads
+    std::vector<std::vector<double> > jumps(numberOfChains);
+    for (int k = 0; k < numberOfChains; k++) {
+        int a = 0;
+        int b = 0;
+        chooseTwoNumbers(&a, &b, 0, numberOfPartners - 1);
+
+        std::vector<double> x_a =
+            _chains[partners[a]]->model().globalParameters();
+        std::vector<double> x_b =
+            _chains[partners[b]]->model().globalParameters();
+
+        double multiple = _random.uniform() < 0.1 ? 1.0 : gamma;
+        for (int i = 0; i < (int)x_a.size(); i++) {
+            if (isFixed[i]) {
+                jumps[k].push_back(0.0);
+            } else {
+                jumps[k].push_back(multiple * (x_a[i] - x_b[i]) +
+                    _random.normal(0.0, _differentialEvolutionNoise));
             }
         }
     }
+
+    std::vector<char> accepted(numberOfChains);
+    _workerPool->run(numberOfChains, [&](int k) {
+        accepted[k] =
+            _chains[chains[k]]->model().jumpGlobalParameters(jumps[k]);
+    });
+
+    _differentialEvolutionJumps += numberOfChains;
+    _acceptedDifferentialEvolutionJumps +=
+        std::count(accepted.begin(), accepted.end(), (char)true);
 }
 
 
 void MetropolisCoupledMCMC::tryChainSwap(int generation)
 {
-    if ((_chains.size() == 1) || (_swapPeriod == 0) ||
+    if ((_nChains == 1) || (_swapPeriod == 0) ||
             (generation % _swapPeriod != 0)) {
         return;
     }
 
+    if (_chainSwapScheme == "deo") {
+        sweepAdjacentChainSwaps(generation);
+        return;
+    }
+
     int chain_1, chain_2;
-    chooseTwoNumbers(&chain_1, &chain_2, 0, (int)_chains.size() - 1);
+    chooseTwoNumbers(&chain_1, &chain_2, 0, _nChains - 1);
 
+    attemptChainSwap(generation, chain_1, chain_2);
+}
+
+
+void MetropolisCoupledMCMC::sweepAdjacentChainSwaps(int generation)
+{
+    // The pairs of a sweep are disjoint, so the order can be taken once
+    std::vector<int> chainsByTemp = chainsOrderedByTemperature();
+
+    for (int r = _swapSweep % 2; r + 1 < (int)chainsByTemp.size(); r += 2) {
+        attemptChainSwap(generation, chainsByTemp[r], chainsByTemp[r + 1]);
+    }
+
+    _swapSweep++;
+}
+
+
+// Returns chain indices from the coldest (highest beta) to the hottest
+std::vector<int> MetropolisCoupledMCMC::chainsOrderedByTemperature() const
+{
+    std::vector<std::pair<double, int> > temps;
+    for (int i = 0; i < _nChains; i++) {
+        temps.push_back(std::make_pair(-chainTemperature(i), i));
+    }
+    std::sort(temps.begin(), temps.end());
+
+    std::vector<int> chains;
+    for (int i = 0; i < (int)temps.size(); i++) {
+        chains.push_back(temps[i].second);
+    }
+    return chains;
+}
+
+
+bool MetropolisCoupledMCMC::isLocalChain(int chain) const
+{
+    return chain % ProcessGroup::size() == ProcessGroup::rank();
+}
+
+
+double MetropolisCoupledMCMC::chainTemperature(int chain) const
+{
+    return _temperatures[chain];
+}
+
+
+void MetropolisCoupledMCMC::setChainTemperature(int chain, double temperature)
+{
+    _temperatures[chain] = temperature;
+
+    if (isLocalChain(chain)) {
+        _chains[chain]->model().setTemperatureMH(temperature);
+    }
+}
+
+
+double MetropolisCoupledMCMC::chainLogPosterior(int chain) const
+{
+    if (isLocalChain(chain)) {
+        return calculateLogPosterior(_chains[chain]->model());
+    }
+
+    return _logPosteriors[chain];
+}
+
+
+// Each process fills in the log-posteriors of its own chains; the sum
+// over processes then holds every chain's value
+void MetropolisCoupledMCMC::exchangeLogPosteriors()
+{
+    _logPosteriors.assign(_nChains, 0.0);
+
+    for (int i = 0; i < (int)_localChains.size(); i++) {
+        int chain = _localChains[i];
+        _logPosteriors[chain] = calculateLogPosterior(_chains[chain]->model());
+    }
+
+    ProcessGroup::sum(_logPosteriors);
+}
+
+
+bool MetropolisCoupledMCMC::attemptChainSwap
+    (int generation, int chain_1, int chain_2)
+{
     bool chainSwapAccepted = acceptChainSwap(chain_1, chain_2);
 
     if (chainSwapAccepted) {
@@ -145,7 +1033,155 @@ void MetropolisCoupledMCMC::tryChainSwap(int generation)
     }
 
     _chainSwapDataWriter.writeData
-        (generation, _chains, chain_1, chain_2, chainSwapAccepted);
+        (generation, _temperatures, chain_1, chain_2, chainSwapAccepted);
+
+    return chainSwapAccepted;
+}
+
+
+// Each thread repeatedly takes a runnable chain and runs it from one
+// checkpoint (a multiple of swapPeriod generations) to the next. As in the
+// synchronous random scheme, one swap is proposed at every checkpoint
+// between two chains chosen at random, but the pairs are drawn before the
+// run. At its checkpoint, the first chain of a pair parks until the other
+// arrives, while its thread moves on to other runnable chains; both are
+// then stopped at the same generation, so the usual swap acceptance rule
+// applies to their current states. The other chains go on without
+// stopping. Which chains swap therefore does not depend on how long each
+// chain takes to run (which depends on its state).
+void MetropolisCoupledMCMC::runAsynchronously()
+{
+    _generations.assign(_chains.size(), 0);
+    _parkedChains.assign(_chains.size(), false);
+    _idleTimes.assign(_nThreads, 0.0);
+    drawSwapSchedule();
+
+    for (int i = 0; i < (int)_chains.size(); i++) {
+        _runnableChains.push_back(i);
+    }
+
+    _workerPool->run(_nThreads, [this](int worker) {
+        runAsynchronousWorker(worker);
+    });
+
+    log() << "\nTime each thread spent waiting for a chain to run (s):\n";
+    for (int i = 0; i < _nThreads; i++) {
+        std::ostringstream idleTime;
+        idleTime << std::fixed << std::setprecision(3) << _idleTimes[i];
+        log() << "    Thread " << i + 1 << ": " << idleTime.str() << "\n";
+    }
+}
+
+
+void MetropolisCoupledMCMC::runAsynchronousWorker(int worker)
+{
+    std::unique_lock<std::mutex> lock(_exchangeMutex);
+
+    while (true) {
+        std::chrono::steady_clock::time_point waitStart =
+            std::chrono::steady_clock::now();
+        _runnableCondition.wait(lock, [this] {
+            return !_runnableChains.empty() || numberOfUnfinishedChains() == 0;
+        });
+        _idleTimes[worker] += std::chrono::duration<double>
+            (std::chrono::steady_clock::now() - waitStart).count();
+
+        if (_runnableChains.empty()) {
+            return;
+        }
+
+        int chain = _runnableChains.front();
+        _runnableChains.pop_front();
+
+        // A chain's temperature and generation only change while it is
+        // at a checkpoint, so they can be read once per segment
+        while (chain >= 0) {
+            int genStart = _generations[chain];
+            int genEnd = std::min(genStart + _swapPeriod, _nGenerations);
+            bool isColdChain = chain == _coldChainIndex;
+
+            lock.unlock();
+            runChain(chain, genStart, genEnd, isColdChain);
+            lock.lock();
+
+            _generations[chain] = genEnd;
+            chain = exchangeAtCheckpoint(chain);
+        }
+    }
+}
+
+
+void MetropolisCoupledMCMC::drawSwapSchedule()
+{
+    int nCheckpoints = (_nGenerations + _swapPeriod - 1) / _swapPeriod;
+
+    _swapSchedule.resize(nCheckpoints);
+    for (int i = 0; i < nCheckpoints; i++) {
+        chooseTwoNumbers(&_swapSchedule[i].first, &_swapSchedule[i].second,
+            0, _nChains - 1);
+    }
+}
+
+
+// Returns the chain the calling thread should continue running, or -1
+int MetropolisCoupledMCMC::exchangeAtCheckpoint(int chain)
+{
+    int generation = _generations[chain];
+    const std::pair<int, int>& pair =
+        _swapSchedule[(generation - 1) / _swapPeriod];
+
+    int partner = -1;
+    if (chain == pair.first) {
+        partner = pair.second;
+    } else if (chain == pair.second) {
+        partner = pair.first;
+    }
+
+    if (partner >= 0) {
+        // The partner cannot have passed this checkpoint without stopping
+        if (!_parkedChains[partner] || _generations[partner] != generation) {
+            _parkedChains[chain] = true;
+            return -1;
+        }
+
+        _parkedChains[partner] = false;
+        attemptChainSwap(generation, pair.first, pair.second);
+        releaseChain(partner);
+    }
+
+    if (isFinished(chain)) {
+        _runnableCondition.notify_all();
+        return -1;
+    }
+
+    return chain;
+}
+
+
+void MetropolisCoupledMCMC::releaseChain(int chain)
+{
+    if (!isFinished(chain)) {
+        _runnableChains.push_back(chain);
+    }
+    _runnableCondition.notify_all();
+}
+
+
+bool MetropolisCoupledMCMC::isFinished(int chain) const
+{
+    return _generations[chain] >= _nGenerations;
+}
+
+
+int MetropolisCoupledMCMC::numberOfUnfinishedChains() const
+{
+    int n = 0;
+    for (int i = 0; i < (int)_generations.size(); i++) {
+        if (!isFinished(i)) {
+            n++;
+        }
+    }
+    return n;
 }
 
 
@@ -168,14 +1204,11 @@ bool MetropolisCoupledMCMC::acceptChainSwap(int chain_1, int chain_2) const
 double MetropolisCoupledMCMC::chainSwapProbability
     (int chain_1, int chain_2) const
 {
-    Model& model_1 = _chains[chain_1]->model();
-    Model& model_2 = _chains[chain_2]->model();
-
-    double beta_1 = model_1.getTemperatureMH();
-    double beta_2 = model_2.getTemperatureMH();
+    double beta_1 = chainTemperature(chain_1);
+    double beta_2 = chainTemperature(chain_2);
 
-    double log_post_1 = calculateLogPosterior(model_1);
-    double log_post_2 = calculateLogPosterior(model_2);
+    double log_post_1 = chainLogPosterior(chain_1);
+    double log_post_2 = chainLogPosterior(chain_2);
 
     double swapPosteriorRatio = std::exp
         (logSwapPosteriorRatio(beta_1, beta_2, log_post_1, log_post_2));
@@ -199,11 +1232,11 @@ double MetropolisCoupledMCMC::logSwapPosteriorRatio
 
 void MetropolisCoupledMCMC::swapTemperature(int chain_1, int chain_2)
 {
-    double beta_1 = _chains[chain_1]->model().getTemperatureMH();
-    double beta_2 = _chains[chain_2]->model().getTemperatureMH();
+    double beta_1 = chainTemperature(chain_1);
+    double beta_2 = chainTemperature(chain_2);
 
-    _chains[chain_1]->model().setTemperatureMH(beta_2);
-    _chains[chain_2]->model().setTemperatureMH(beta_1);
+    setChainTemperature(chain_1, beta_2);
+    setChainTemperature(chain_2, beta_1);
 
     // Properly keep track of the cold chain
     if (chain_1 == _coldChainIndex) {
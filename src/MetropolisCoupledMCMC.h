@@ -3,7 +3,14 @@
 
 
 #include "ChainSwapDataWriter.h"
+#include "EffectiveSampleSizeMonitor.h"
+#include "ProposalProfileDataWriter.h"
 #include <vector>
+#include <deque>
+#include <string>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
 
 class Random;
 class Settings;
@@ -11,6 +18,8 @@ class ModelFactory;
 class MCMC;
 class Model;
 class ModelDataWriter;
+class Tree;
+class ChainWorkerPool;
 
 
 class MetropolisCoupledMCMC
@@ -23,17 +32,71 @@ public:
 
     void run();
 
+    // Running in lockstep with other MC3 groups (see MCMCReplicates):
+    // the chains are created on a tree and scheduled on a worker pool
+    // that are owned by the caller, which runs the local chains of all
+    // groups for a swap period before ending it in every group
+    void start(Tree& tree, ChainWorkerPool& workerPool);
+    int numberOfLocalChains() const;
+    void runLocalChain(int t, int genStart, int genEnd);
+    void endSwapPeriod(int generation);
+    void finish();
+
+    Model& coldChainModel();
+
+    // Chain temperatures (betas) from the cold chain to the hottest
+    std::vector<double> temperatureLadder() const;
+
 private:
 
     void createChains();
+    void assignChainsToProcesses();
     MCMC* createMCMC(int chainIndex) const;
     double calculateTemperature(int i, double deltaT) const;
 
     void createDataWriter();
 
+    void runMultiStartBurnIn();
+
     void runChains(int genStart, int genEnd);
-    void runChain(int i, int genStart, int genEnd);
+    void runChain(int i, int genStart, int genEnd, bool isColdChain);
+    void recordColdChainGeneration(int generation, Model& model);
+    void logBarrierWaitTimes() const;
     void tryChainSwap(int generation);
+    void sweepDifferentialEvolution();
+    void jumpGlobalParameters(const std::vector<int>& chains,
+        const std::vector<int>& partners, const std::vector<bool>& isFixed,
+        double gamma);
+    bool attemptChainSwap(int generation, int chain_1, int chain_2);
+    void sweepAdjacentChainSwaps(int generation);
+    std::vector<int> chainsOrderedByTemperature() const;
+
+    bool isLocalChain(int chain) const;
+    double chainTemperature(int chain) const;
+    void setChainTemperature(int chain, double temperature);
+    double chainLogPosterior(int chain) const;
+    void exchangeLogPosteriors();
+
+    void adaptTemperatures(int generation);
+    void recordAdjacentSwapProbabilities();
+    void updateTemperatureLadder();
+
+    void logProposalScales();
+    void logProposalWeights();
+    void logProposalSettings(const std::string& title, bool weights);
+    void writeProposalProfiles(int generation);
+
+    bool shouldWriteCheckpoint(int previousGeneration, int generation) const;
+    void writeCheckpoint(int generation) const;
+    int readCheckpoint();
+
+    void runAsynchronously();
+    void runAsynchronousWorker(int worker);
+    void drawSwapSchedule();
+    int exchangeAtCheckpoint(int chain);
+    void releaseChain(int chain);
+    bool isFinished(int chain) const;
+    int numberOfUnfinishedChains() const;
 
     void chooseTwoNumbers(int* x, int* y, int from, int to);
     bool acceptChainSwap(int chain_1, int chain_2) const;
@@ -48,12 +111,39 @@ private:
     Settings& _settings;
     ModelFactory* _modelFactory;
 
+    // Read once and shared (read-only) by all chains
+    Tree* _tree;
+
+    // Whether _tree and _workerPool were created by run() (rather than
+    // passed to start()) and are deleted with this object
+    bool _ownsTreeAndWorkerPool;
+
     int _nGenerations;
 
-    // Holds a variable number of Markov chains
+    // Holds a variable number of Markov chains. When running in several
+    // processes (see ProcessGroup), chain i belongs to process
+    // i % (number of processes) and is NULL in all other processes.
     std::vector<MCMC*> _chains;
     int _nChains;
 
+    // Indices of the chains that belong to this process
+    std::vector<int> _localChains;
+
+    // Temperature of every chain, including those of other processes.
+    // All processes make the same swap decisions from the same random
+    // numbers, so they keep the same copy.
+    std::vector<double> _temperatures;
+
+    // Log-posterior of every chain, exchanged between processes at the
+    // end of each swap period (only used with several processes)
+    std::vector<double> _logPosteriors;
+
+    // Number of worker threads the chains are scheduled on
+    int _nThreads;
+
+    // Runs the chains as tasks on _nThreads threads; created once per run
+    ChainWorkerPool* _workerPool;
+
     // From Altekar, et al. 2004: delta T (> 1) is a temparature
     // increment parameter chosen such that swaps are accepted
     // between 20 and 60% of the time.
@@ -62,14 +152,116 @@ private:
     // Number of steps/generations in which chair swapping occurs
     int _swapPeriod;
 
+    // "random": one swap between two random chains per swap period.
+    // "deo": a deterministic even/odd sweep; every swap period attempts
+    // swaps between all adjacent temperatures (1-2, 3-4, ...) or
+    // (2-3, 4-5, ...), alternating between the two sets
+    std::string _chainSwapScheme;
+    int _swapSweep;
+
+    // Temperature ladder adaptation (synchronous swaps only). For the
+    // first _temperatureAdaptationGenerations generations, the swap
+    // acceptance probability of every adjacent pair of temperatures is
+    // recorded at each swap period. At the end of each round (which
+    // doubles in length), the intermediate temperatures are moved so
+    // that the rejection rates of all adjacent pairs become equal. The
+    // coldest and hottest temperatures are kept fixed.
+    int _temperatureAdaptationGenerations;
+    std::vector<double> _adjacentSwapProbabilitySums;
+    int _adjacentSwapSamples;
+    int _adaptationRoundLength;
+
+    // With _autotune, every chain adapts its proposal scales during the
+    // first _autotuneGenerations generations (see Model); the final
+    // scales are logged once
+    bool _autotune;
+    int _autotuneGenerations;
+    bool _proposalScalesLogged;
+
+    // Same for the rebalancing of proposal weights
+    bool _adaptProposalWeights;
+    int _proposalWeightAdaptationGenerations;
+    bool _proposalWeightsLogged;
+
+    // With a single chain, the number of threads evaluating its
+    // proposals speculatively (see MCMC::runSpeculatively); 0 to run
+    // it normally
+    int _speculativeThreads;
+
+    // With a single chain, the number of threads scoring the candidate
+    // positions of multiple-try moves of events (see MoveEventProposal);
+    // 0 or 1 to score them on the chain's model
+    int _eventLocationThreads;
+
+    // Multi-start burn-in: before the run, _multiStartChains chains at
+    // temperature 1 run for _multiStartGenerations generations in
+    // parallel, the first from the configured initial state and the
+    // others from random event configurations. The chains of the run
+    // then start from their final states, ranked by log-posterior
+    // (the best for the cold chain).
+    int _multiStartChains;
+    int _multiStartGenerations;
+
+    // Population MCMC: all chains run at temperature 1 and, instead of
+    // swapping, their global parameters (see Model::globalParameters)
+    // make _differentialEvolutionSweeps sweeps of differential-evolution
+    // jumps at the end of each swap period
+    bool _populationMCMC;
+    int _differentialEvolutionSweeps;
+    double _differentialEvolutionNoise;
+    long _differentialEvolutionJumps;
+    long _acceptedDifferentialEvolutionJumps;
+
     // Current index of the cold chain (it changes when a swap occurs)
     int _coldChainIndex;
 
     ChainSwapDataWriter _chainSwapDataWriter;
 
+    // Stops the run early once the cold chain's samples reach
+    // the target effective sample size
+    EffectiveSampleSizeMonitor _essMonitor;
+
+    // Proposal profiles of the chains (see ProposalProfiler) are written
+    // at the end of the first swap period after every
+    // _proposalProfileFreq generations, and at the end of the run
+    ProposalProfileDataWriter _proposalProfileDataWriter;
+    int _proposalProfileFreq;
+    int _lastSwapPeriodEnd;
+    int _lastProfileGeneration;
+
     ModelDataWriter* _dataWriter;
 
     int _acceptanceResetFreq;
+
+    // A checkpoint (see Checkpoint) is written at the end of the first
+    // swap period after every _checkpointFreq generations, and when the
+    // run is stopped by a signal. With _resume, the run starts from the
+    // checkpoint instead of generation 0.
+    int _checkpointFreq;
+    std::string _checkpointFileName;
+    bool _resume;
+
+    // Asynchronous exchange: instead of stopping all chains every
+    // swapPeriod generations, only the two chains scheduled to swap at a
+    // checkpoint stop there, and the first to arrive waits for the other
+    bool _asynchronousSwaps;
+
+    // Generations run by each chain; chains that swap are at the same one
+    std::vector<int> _generations;
+
+    // The two chains that propose a swap at each checkpoint, drawn before
+    // the run so that the pairing does not depend on the chains' states
+    std::vector<std::pair<int, int> > _swapSchedule;
+
+    // Chains waiting for a thread, and chains waiting for their partner
+    std::deque<int> _runnableChains;
+    std::vector<bool> _parkedChains;
+
+    std::mutex _exchangeMutex;
+    std::condition_variable _runnableCondition;
+
+    // Time each thread spent with no chain to run (seconds)
+    std::vector<double> _idleTimes;
 };
 
 
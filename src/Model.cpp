@@ -13,18 +13,31 @@
 #include "BranchEvent.h"
 #include "BranchHistory.h"
 #include "Tools.h"
+#include "Checkpoint.h"
+#include "Log.h"
 
 #include <string>
 #include <fstream>
 #include <cstdlib>
 #include <vector>
+#include <algorithm>
+#include <cmath>
 
 #define ENABLE_HASTINGS_RATIO_BUG
 
 
-Model::Model(Random& random, Settings& settings) :
+// Quantities whose jumps measure how far a proposal moves the chain
+// (logLik, N_shifts and eventRate)
+static const int NumberOfMeasuredQuantities = 3;
+
+
+Model::Model(Random& random, Settings& settings, Tree& tree,
+    int numberOfEventParameters) :
     _random(random), _settings(settings), _prior(_random, &_settings),
-    _tree(new Tree(_random, _settings))
+    _tree(&tree), _branchHistories(tree.getNumberOfNodes()),
+    _eventParameters(numberOfEventParameters),
+    _profiler(settings.get<bool>("outputProposalProfile")),
+    _likelihoodEvaluations(0), _helperPool(NULL)
 {
     // Initialize event rate to generate expected number of prior events
     _eventRate = 1 / _settings.get<double>("poissonRatePrior");
@@ -33,6 +46,33 @@ Model::Model(Random& random, Settings& settings) :
     _rejectCount = 0;
     _acceptLast = -1;
 
+    _autotuneGenerationsLeft = 0;
+    if (_settings.get<bool>("autotune")) {
+        _autotuneGenerationsLeft = _settings.get<int>("autotuneGenerations");
+    }
+    _autotuneTargetAcceptanceRate =
+        _settings.get<double>("autotuneTargetAcceptanceRate");
+
+    _weightAdaptationGenerationsLeft = 0;
+    if (_settings.get<bool>("adaptProposalWeights")) {
+        _weightAdaptationGenerationsLeft =
+            _settings.get<int>("proposalWeightAdaptationGenerations");
+    }
+    _minProposalWeightFactor =
+        _settings.get<double>("minProposalWeightFactor");
+    _maxProposalWeightFactor =
+        _settings.get<double>("maxProposalWeightFactor");
+    if (_minProposalWeightFactor <= 0.0 ||
+            _maxProposalWeightFactor < _minProposalWeightFactor) {
+        exitWithError("minProposalWeightFactor must be greater than 0 and "
+            "not greater than maxProposalWeightFactor");
+    }
+
+    _stateSamples = 0;
+    _stateBeforeProposal.assign(NumberOfMeasuredQuantities, 0.0);
+    _stateMeans.assign(NumberOfMeasuredQuantities, 0.0);
+    _stateSquaredDeviations.assign(NumberOfMeasuredQuantities, 0.0);
+
     _lastDeletedEventMapTime = 0;
 
     _logQRatioJump = 0.0;
@@ -41,6 +81,7 @@ Model::Model(Random& random, Settings& settings) :
     // This must be explicitly set by calling the public
     // function Model::setModelTemperature
     _temperatureMH = 1.0;
+    _likelihoodPower = 1.0;
 
     // Add proposals
     _proposals.push_back(new EventNumberProposal(random, settings, *this));
@@ -60,8 +101,6 @@ Model::~Model()
         delete *it;
     }
 
-    delete _tree;
-
     // Delete all proposals (including those created by derived classes)
     for (Proposal* proposal : _proposals) {
         delete proposal;
@@ -99,6 +138,11 @@ void Model::initializeModelFromEventDataFile(const std::string& fileName)
     for (int i = lines.size() - 1; i != -1; --i) {
         const std::vector<std::string>& tokens = split_string(lines[i], ',');
 
+        // A file with a single generation ends at the header
+        if (tokens[0] == "generation") {
+            break;
+        }
+
         // Get the generation, but if it differs from previous, stop
         int gen = convert_string<int>(tokens[0]);
         if (prevGeneration == 0) {
@@ -133,6 +177,7 @@ void Model::initializeModelFromEventDataFile(const std::string& fileName)
         if (x == _tree->getRoot()) {
             // Set the root event with model-specific parameters
             setRootEventWithReadParameters(parameters);
+            flagBranchesGovernedByEvent(_rootEvent);
             setMeanBranchParameters();
         } else {
             double deltaT = x->getTime() - eventTime;
@@ -152,7 +197,7 @@ void Model::initializeModelFromEventDataFile(const std::string& fileName)
 }
 
 
-void Model::forwardSetBranchHistories(BranchEvent* x)
+const std::vector<Node*>& Model::forwardSetBranchHistories(BranchEvent* x)
 {
     // If there is another event occurring more recent (closer to tips),
     // do nothing. Even just sits in BranchHistory but doesn't affect
@@ -166,20 +211,42 @@ void Model::forwardSetBranchHistories(BranchEvent* x)
     Node* myNode = x->getEventNode();
 
     if (x == _rootEvent) {
-        forwardSetHistoriesRecursive(myNode->getLfDesc());
-        forwardSetHistoriesRecursive(myNode->getRtDesc());
-    } else if (x == myNode->getBranchHistory()->getLastEvent()) {
+        forwardSetHistoriesForDescendants(myNode);
+    } else if (x == getBranchHistory(myNode)->getLastEvent()) {
         // If true, x is the most tip-wise event on branch.
-        myNode->getBranchHistory()->setNodeEvent(x);
-
-        // If myNode is not a tip
-        if (myNode->getLfDesc() != NULL && myNode->getRtDesc() != NULL) {
-            forwardSetHistoriesRecursive(myNode->getLfDesc());
-            forwardSetHistoriesRecursive(myNode->getRtDesc());
-        }
-        // Else: node is a tip; do nothing
+        forwardSetBranchHistories(myNode);
     }
     // Else: there is another more tipwise event on the same branch; do nothing
+
+    return _nodesWithChangedHistory;
+}
+
+
+/*
+    Call this after an event has been added to or removed from the branch
+    defined by node. The node is always flagged as changed (its mean rates
+    depend on the events on its branch); its node event is reset to the most
+    tip-wise event on the branch (or the ancestral event if there is none),
+    and the change is propagated toward the tips.
+*/
+
+const std::vector<Node*>& Model::forwardSetBranchHistories(Node* node)
+{
+    _nodesWithChangedHistory.push_back(node);
+
+    BranchHistory* history = getBranchHistory(node);
+
+    BranchEvent* nodeEvent = _rootEvent;
+    if (history->getNumberOfBranchEvents() > 0) {
+        nodeEvent = history->getLastEvent();
+    } else if (node != _tree->getRoot()) {
+        nodeEvent = history->getAncestralNodeEvent();
+    }
+    history->setNodeEvent(nodeEvent);
+
+    forwardSetHistoriesForDescendants(node);
+
+    return _nodesWithChangedHistory;
 }
 
 
@@ -187,37 +254,112 @@ void Model::forwardSetBranchHistories(BranchEvent* x)
     If this works correctly, this will take care of the following:
     1. if a new event is created or added to tree,
        this will forward set all branch histories from the insertion point
-    2. If an event is deleted, you find the next event rootwards,
-       and call forwardSetBranchHistories from that point. It will replace
-       settings due to the deleted node with the next rootwards node.
+    2. If an event is deleted, the branch it was on is reset with
+       forwardSetBranchHistories(Node*). It will replace settings due to
+       the deleted node with the next rootwards node.
+
+    The descendants of p are a contiguous range of the tree's pre-order
+    nodes, and each node comes after its parent, so this is a single linear
+    sweep. Subtrees are skipped where the sweep hits another event on a branch
+    or a node whose history is unchanged (everything tipwards of it is then
+    already up to date).
 */
 
-void Model::forwardSetHistoriesRecursive(Node* p)
+void Model::forwardSetHistoriesForDescendants(Node* p)
 {
-    // Get event that characterizes parent node
-    BranchEvent* lastEvent = p->getAnc()->getBranchHistory()->getNodeEvent();
+    const std::vector<Node*>& preOrderNodes = _tree->preOrderNodes();
+
+    int i = p->getPreOrderIndex() + 1;
+    int end = p->getPreOrderIndex() + p->getSubtreeSize();
 
-    // Set the ancestor equal to the event state of parent node:
-    p->getBranchHistory()->setAncestralNodeEvent(lastEvent);
+    while (i < end) {
+        Node* node = preOrderNodes[i];
+        BranchHistory* history = getBranchHistory(node);
 
-    // Ff no events on the branch, go down to descendants and do same thing;
-    // otherwise, process terminates (because it hits another event on branch
-    if (p->getBranchHistory()->getNumberOfBranchEvents() == 0) {
-        p->getBranchHistory()->setNodeEvent(lastEvent);
+        // Get event that characterizes parent node
+        BranchEvent* lastEvent =
+            getBranchHistory(node->getAnc())->getNodeEvent();
 
-        if (p->getLfDesc() != NULL) {
-            forwardSetHistoriesRecursive(p->getLfDesc());
+        bool hasBranchEvents = history->getNumberOfBranchEvents() > 0;
+
+        if (history->getAncestralNodeEvent() == lastEvent &&
+                (hasBranchEvents || history->getNodeEvent() == lastEvent)) {
+            i += node->getSubtreeSize();
+            continue;
         }
 
-        if (p->getRtDesc() != NULL) {
-            forwardSetHistoriesRecursive(p->getRtDesc());
+        _nodesWithChangedHistory.push_back(node);
+
+        // Set the ancestor equal to the event state of parent node
+        history->setAncestralNodeEvent(lastEvent);
+
+        // If no events on the branch, go down to descendants and do same thing;
+        // otherwise, skip them (because it hits another event on branch)
+        if (hasBranchEvents) {
+            i += node->getSubtreeSize();
+        } else {
+            history->setNodeEvent(lastEvent);
+            i++;
         }
     }
 }
 
 
+void Model::flagBranchesGovernedByEvent(BranchEvent* x)
+{
+    Node* myNode = x->getEventNode();
+    _nodesWithChangedHistory.push_back(myNode);
+
+    if (getBranchHistory(myNode)->getNodeEvent() != x) {
+        return;
+    }
+
+    const std::vector<Node*>& preOrderNodes = _tree->preOrderNodes();
+
+    int i = myNode->getPreOrderIndex() + 1;
+    int end = myNode->getPreOrderIndex() + myNode->getSubtreeSize();
+
+    while (i < end) {
+        Node* node = preOrderNodes[i];
+        BranchHistory* history = getBranchHistory(node);
+
+        if (history->getAncestralNodeEvent() != x) {
+            i += node->getSubtreeSize();
+            continue;
+        }
+
+        _nodesWithChangedHistory.push_back(node);
+
+        if (history->getNodeEvent() == x) {
+            i++;
+        } else {
+            i += node->getSubtreeSize();
+        }
+    }
+}
+
+
+// Returns the flagged nodes with duplicates removed
+const std::vector<Node*>& Model::nodesWithChangedHistory()
+{
+    std::sort(_nodesWithChangedHistory.begin(), _nodesWithChangedHistory.end());
+    _nodesWithChangedHistory.erase(std::unique(_nodesWithChangedHistory.begin(),
+        _nodesWithChangedHistory.end()), _nodesWithChangedHistory.end());
+
+    return _nodesWithChangedHistory;
+}
+
+
+void Model::clearNodesWithChangedHistory()
+{
+    _nodesWithChangedHistory.clear();
+}
+
+
 void Model::calculateUpdateWeights()
 {
+    _updateWeights.clear();
+
     // Add un-normalized weights of proposals
     for (Proposal* proposal : _proposals) {
         _updateWeights.push_back(proposal->weight());
@@ -247,7 +389,19 @@ void Model::proposeNewState()
     _lastParameterUpdated = parameterToUpdate;
 
     Proposal* proposal = _proposals[parameterToUpdate];
-    proposal->propose();
+
+    if (_weightAdaptationGenerationsLeft > 0) {
+        startMeasuringProposal();
+    }
+
+    if (_profiler.isEnabled()) {
+        _likelihoodEvaluations = 0;
+        _profiler.startPhase();
+        proposal->propose();
+        _profiler.endPhase(parameterToUpdate, ProposalProfiler::Propose);
+    } else {
+        proposal->propose();
+    }
 
     _lastProposal = proposal;
 }
@@ -273,6 +427,12 @@ BranchEvent* Model::addRandomEventToTree()
     double bb = _tree->getTotalMapLength();
     double x = _random.uniform(aa, bb);
 
+    return addRandomEventToTree(x);
+}
+
+
+BranchEvent* Model::addRandomEventToTree(double x)
+{
     BranchEvent* newEvent = newBranchEventWithRandomParameters(x);
     return addEventToTree(newEvent);
 }
@@ -291,7 +451,7 @@ BranchEvent* Model::addFixedParameterEventToRandomLocation()
 
 BranchEvent* Model::addRandomEventToTreeOnRandomBranch()
 {
-    Node* randomNode = _tree->getRandomNonRootNode();
+    Node* randomNode = _tree->getRandomNonRootNode(_random);
 
     double mapStart = randomNode->getMapStart();
     double mapEnd = randomNode->getMapEnd();
@@ -307,11 +467,12 @@ BranchEvent* Model::addEventToTree(BranchEvent* newEvent)
 {
     // Add the event to the branch history.
     // Always done after event is added to tree.
-    newEvent->getEventNode()->getBranchHistory()->
+    getBranchHistory(newEvent->getEventNode())->
         addEventToBranchHistory(newEvent);
 
     _eventCollection.insert(newEvent);
-    forwardSetBranchHistories(newEvent);
+    _eventParameters.setInTree(newEvent->getParameterId(), true);
+    forwardSetBranchHistories(newEvent->getEventNode());
     setMeanBranchParameters();
 
     _lastEventModified = newEvent;
@@ -352,40 +513,50 @@ BranchEvent* Model::removeEventFromTree(BranchEvent* be)
     // Erase from branch history
     Node* currNode = be->getEventNode();
 
-    // Get event downstream of i
-    BranchEvent* newLastEvent = currNode->getBranchHistory()->getLastEvent(be);
-
     _lastDeletedEventMapTime = be->getMapTime();
 
     setDeletedEventParameters(be);
     _logQRatioJump = calculateLogQRatioJump();
 
-    currNode->getBranchHistory()->popEventOffBranchHistory(be);
+    getBranchHistory(currNode)->popEventOffBranchHistory(be);
+
+    eraseFromEventCollection(be);
+    _eventParameters.setInTree(be->getParameterId(), false);
+
+    forwardSetBranchHistories(currNode);
+
+    setMeanBranchParameters();
+
+    return be;
+}
+
 
-    // Cannot remove "be" with _eventCollection.erase(be) because
-    // it is not always found in the collection, even though it is there.
-    // It seems that, because event pointers are compared by comparing
-    // doubles, the event is sometimes not seen (floating-point issue).
-    bool eventFound = false;
+void Model::eraseFromEventCollection(BranchEvent* be)
+{
+    // Cannot remove "be" with _eventCollection.erase(be) because that
+    // would also erase other events with the same map time
     EventSet::iterator it;
     for (it = _eventCollection.begin(); it != _eventCollection.end(); ++it) {
         if (*it == be) {    // Compare pointers directly, not using comparer
             _eventCollection.erase(it);
-            eventFound = true;
-            break;
+            return;
         }
     }
 
-    if (!eventFound) {
-        log(Error) << "Could not find event to delete.\n";
-        std::exit(1);
-    }
+    log(Error) << "Could not find event to delete.\n";
+    std::exit(1);
+}
 
-    forwardSetBranchHistories(newLastEvent);
 
-    setMeanBranchParameters();
+void Model::beginEventMove(BranchEvent* be)
+{
+    eraseFromEventCollection(be);
+}
 
-    return be;
+
+void Model::endEventMove(BranchEvent* be)
+{
+    _eventCollection.insert(be);
 }
 
 
@@ -456,8 +627,8 @@ bool Model::isEventConfigurationValid(BranchEvent* be)
     if (be->getEventNode() == _tree->getRoot()) {
         Node* rt = _tree->getRoot()->getRtDesc();
         Node* lf = _tree->getRoot()->getLfDesc();
-        if (rt->getBranchHistory()->getNumberOfBranchEvents() > 0 &&
-            lf->getBranchHistory()->getNumberOfBranchEvents() > 0) {
+        if (getBranchHistory(rt)->getNumberOfBranchEvents() > 0 &&
+            getBranchHistory(lf)->getNumberOfBranchEvents() > 0) {
             // Events on both descendants of root. This fails.
             isValidConfig = false;
         } else {
@@ -480,18 +651,18 @@ bool Model::isEventConfigurationValid(BranchEvent* be)
 
         if (anc == _tree->getRoot()) {
             badsum++;
-        } else if (anc->getBranchHistory()->getNumberOfBranchEvents() > 0) {
+        } else if (getBranchHistory(anc)->getNumberOfBranchEvents() > 0) {
             badsum++;
         } else {
             // nothing
         }
 
         // Test lf desc
-        if (lf->getBranchHistory()->getNumberOfBranchEvents() > 0)
+        if (getBranchHistory(lf)->getNumberOfBranchEvents() > 0)
             badsum++;
 
         // Test rt desc
-        if (rt->getBranchHistory()->getNumberOfBranchEvents() > 0)
+        if (getBranchHistory(rt)->getNumberOfBranchEvents() > 0)
             badsum++;
 
         if (badsum == 3) {
@@ -512,10 +683,10 @@ bool Model::isEventConfigurationValid(BranchEvent* be)
         badsum = 0;
         
         if (lf != NULL && rt != NULL && backwardConfigValid){
-            if (lf->getBranchHistory()->getNumberOfBranchEvents() > 0){
+            if (getBranchHistory(lf)->getNumberOfBranchEvents() > 0){
                 badsum++;
             }
-            if (rt->getBranchHistory()->getNumberOfBranchEvents() > 0){
+            if (getBranchHistory(rt)->getNumberOfBranchEvents() > 0){
                 badsum++;
             }
             
@@ -541,24 +712,533 @@ bool Model::isEventConfigurationValid(BranchEvent* be)
 void Model::acceptProposal()
 {
     if (_lastProposal != NULL) {
-        _lastProposal->accept();
+        if (_profiler.isEnabled()) {
+            _profiler.startPhase();
+            _lastProposal->accept();
+            _profiler.endPhase(_lastParameterUpdated, ProposalProfiler::Accept);
+            _profiler.addLikelihoodEvaluations
+                (_lastParameterUpdated, _likelihoodEvaluations);
+        } else {
+            _lastProposal->accept();
+        }
         _acceptCount++;
         _acceptLast = 1;
     } else {
         _acceptLast = -1;
     }
+
+    adaptProposalScale(true);
+
+    if (_weightAdaptationGenerationsLeft > 0) {
+        finishMeasuringProposal();
+    }
 }
 
 
 void Model::rejectProposal()
 {
     if (_lastProposal != NULL) {
-        _lastProposal->reject();
+        if (_profiler.isEnabled()) {
+            _profiler.startPhase();
+            _lastProposal->reject();
+            _profiler.endPhase(_lastParameterUpdated, ProposalProfiler::Reject);
+            _profiler.addLikelihoodEvaluations
+                (_lastParameterUpdated, _likelihoodEvaluations);
+        } else {
+            _lastProposal->reject();
+        }
         _rejectCount++;
         _acceptLast = 0;
     } else {
         _acceptLast = -1;
     }
+
+    adaptProposalScale(false);
+
+    if (_weightAdaptationGenerationsLeft > 0) {
+        finishMeasuringProposal();
+    }
+}
+
+
+std::vector<double> Model::globalParameters()
+{
+    std::vector<double> values;
+    std::vector<bool> isLogScale;
+    std::vector<bool> isHeld;
+    getGlobalParameters(values, isLogScale, isHeld);
+
+    for (int i = 0; i < (int)values.size(); i++) {
+        if (isLogScale[i]) {
+            values[i] = std::log(values[i]);
+        }
+    }
+
+    return values;
+}
+
+
+// The event rate's part of the target includes the Poisson probability of
+// the number of events, as in EventRateProposal; other global parameters
+// enter through the likelihood and the prior
+bool Model::jumpGlobalParameters(const std::vector<double>& jump)
+{
+    std::vector<double> currentValues;
+    std::vector<bool> isLogScale;
+    std::vector<bool> isHeld;
+    getGlobalParameters(currentValues, isLogScale, isHeld);
+
+    double numberOfEvents = (double)_eventCollection.size();
+    double currentLogLikelihood = _logLikelihood;
+    double currentLogPrior = computeLogPrior() +
+        numberOfEvents * std::log(_eventRate) - _eventRate;
+
+    std::vector<double> values(currentValues);
+    for (int i = 0; i < (int)values.size(); i++) {
+        if (isLogScale[i]) {
+            values[i] *= std::exp(jump[i]);
+        } else {
+            values[i] += jump[i];
+        }
+    }
+
+    _eventRate = values[0];
+    setModelGlobalParameters(&values[1]);
+
+    // Parameters that could not change keep their values
+    values.assign(1, _eventRate);
+    std::vector<bool> isModelLogScale(1, true);
+    getModelGlobalParameters(values, isModelLogScale);
+
+    // Only the log-scale parameters that moved have a Jacobian
+    double logJacobian = 0.0;
+    for (int i = 0; i < (int)values.size(); i++) {
+        if (isLogScale[i] && values[i] != currentValues[i]) {
+            logJacobian += std::log(values[i] / currentValues[i]);
+        }
+    }
+
+    double proposedLogLikelihood = computeLogLikelihood();
+    double proposedLogPrior = computeLogPrior() +
+        numberOfEvents * std::log(_eventRate) - _eventRate;
+
+    double logRatio = _temperatureMH *
+        (_likelihoodPower * (proposedLogLikelihood - currentLogLikelihood) +
+         proposedLogPrior - currentLogPrior) + logJacobian;
+
+    double acceptanceRatio = 0.0;
+    if (std::isfinite(logRatio)) {
+        acceptanceRatio = std::min(1.0, std::exp(logRatio));
+    }
+
+    if (_random.trueWithProbability(acceptanceRatio)) {
+        _logLikelihood = proposedLogLikelihood;
+        return true;
+    }
+
+    _eventRate = currentValues[0];
+    setModelGlobalParameters(&currentValues[1]);
+    return false;
+}
+
+
+std::vector<bool> Model::fixedGlobalParameters()
+{
+    std::vector<bool> isFixed
+        (1, _settings.get<double>("updateRateEventRate") == 0.0);
+    getModelFixedGlobalParameters(isFixed);
+    return isFixed;
+}
+
+
+// The global parameters on their natural scale. A positive parameter is
+// on the log scale unless it is fixed or 0 (e.g., muInit under pure
+// birth), as the log of 0 does not exist and a fixed parameter must keep
+// its exact value.
+void Model::getGlobalParameters(std::vector<double>& values,
+    std::vector<bool>& isLogScale, std::vector<bool>& isHeld)
+{
+    values.assign(1, _eventRate);
+    isLogScale.assign(1, true);
+    getModelGlobalParameters(values, isLogScale);
+
+    isHeld = fixedGlobalParameters();
+    holdParameters(values, isLogScale, isHeld);
+}
+
+
+void Model::getEventParameters(BranchEvent* event, std::vector<double>& values,
+    std::vector<bool>& isLogScale, std::vector<bool>& isHeld)
+{
+    values.clear();
+    isLogScale.clear();
+    getModelEventParameters(event, values, isLogScale);
+
+    isHeld.clear();
+    getModelFixedEventParameters(isHeld);
+    holdParameters(values, isLogScale, isHeld);
+}
+
+
+// A positive parameter at 0 (e.g., the extinction rate of a pure-birth
+// model) cannot be moved by multiplicative updates, so it is held as if
+// it were fixed; held parameters stay on their natural scale
+void Model::holdParameters(const std::vector<double>& values,
+    std::vector<bool>& isLogScale, std::vector<bool>& isHeld)
+{
+    for (int i = 0; i < (int)values.size(); i++) {
+        if (isLogScale[i] && values[i] <= 0.0) {
+            isHeld[i] = true;
+        }
+        if (isHeld[i]) {
+            isLogScale[i] = false;
+        }
+    }
+}
+
+
+std::vector<bool> Model::heldGlobalParameters()
+{
+    std::vector<double> values;
+    std::vector<bool> isLogScale;
+    std::vector<bool> isHeld;
+    getGlobalParameters(values, isLogScale, isHeld);
+    return isHeld;
+}
+
+
+std::vector<bool> Model::heldEventParameters(BranchEvent* event)
+{
+    std::vector<double> values;
+    std::vector<bool> isLogScale;
+    std::vector<bool> isHeld;
+    getEventParameters(event, values, isLogScale, isHeld);
+    return isHeld;
+}
+
+
+void Model::setGlobalParameters(const std::vector<double>& values)
+{
+    std::vector<double> currentValues;
+    std::vector<bool> isLogScale;
+    std::vector<bool> isHeld;
+    getGlobalParameters(currentValues, isLogScale, isHeld);
+
+    std::vector<double> naturalValues(values);
+    for (int i = 0; i < (int)naturalValues.size(); i++) {
+        if (isLogScale[i]) {
+            naturalValues[i] = std::exp(naturalValues[i]);
+        }
+    }
+
+    _eventRate = naturalValues[0];
+    setModelGlobalParameters(&naturalValues[1]);
+    _logLikelihood = computeLogLikelihood();
+}
+
+
+std::vector<double> Model::eventParameters(BranchEvent* event)
+{
+    std::vector<double> values;
+    std::vector<bool> isLogScale;
+    std::vector<bool> isHeld;
+    getEventParameters(event, values, isLogScale, isHeld);
+
+    for (int i = 0; i < (int)values.size(); i++) {
+        if (isLogScale[i]) {
+            values[i] = std::log(values[i]);
+        }
+    }
+
+    return values;
+}
+
+
+void Model::setEventParameters
+    (BranchEvent* event, const std::vector<double>& values)
+{
+    std::vector<double> currentValues;
+    std::vector<bool> isLogScale;
+    std::vector<bool> isHeld;
+    getEventParameters(event, currentValues, isLogScale, isHeld);
+
+    std::vector<double> naturalValues(values);
+    for (int i = 0; i < (int)naturalValues.size(); i++) {
+        if (isLogScale[i]) {
+            naturalValues[i] = std::exp(naturalValues[i]);
+        }
+    }
+
+    setModelEventParameters(event, &naturalValues[0]);
+    flagBranchesGovernedByEvent(event);
+    setMeanBranchParameters();
+    _logLikelihood = computeLogLikelihood();
+}
+
+
+void Model::copyEventParameters(BranchEvent* event, BranchEvent* source)
+{
+    std::vector<double> values;
+    std::vector<bool> isLogScale;
+    getModelEventParameters(source, values, isLogScale);
+
+    setModelEventParameters(event, &values[0]);
+    flagBranchesGovernedByEvent(event);
+    setMeanBranchParameters();
+    _logLikelihood = computeLogLikelihood();
+}
+
+
+// Positive parameters that are not held are on the log scale (the
+// density includes their Jacobian), so that a rate of a short branch does
+// not go to 0, where the density on the natural scale may be unbounded
+double Model::logPosterior()
+{
+    std::vector<double> values;
+    std::vector<bool> isLogScale;
+    std::vector<bool> isHeld;
+    getGlobalParameters(values, isLogScale, isHeld);
+
+    EventSet::iterator it;
+    for (it = _eventCollection.begin(); it != _eventCollection.end(); ++it) {
+        std::vector<double> eventValues;
+        std::vector<bool> isEventLogScale;
+        getEventParameters(*it, eventValues, isEventLogScale, isHeld);
+        values.insert(values.end(), eventValues.begin(), eventValues.end());
+        isLogScale.insert(isLogScale.end(),
+            isEventLogScale.begin(), isEventLogScale.end());
+    }
+
+    double logJacobian = 0.0;
+    for (int i = 0; i < (int)values.size(); i++) {
+        if (isLogScale[i]) {
+            logJacobian += std::log(values[i]);
+        }
+    }
+
+    double numberOfEvents = (double)_eventCollection.size();
+    return _logLikelihood + computeLogPrior() + logJacobian +
+        numberOfEvents * std::log(_eventRate) - _eventRate -
+        std::lgamma(numberOfEvents + 1.0);
+}
+
+
+void Model::adaptProposalScale(bool accepted)
+{
+    if (_autotuneGenerationsLeft == 0) {
+        return;
+    }
+
+    if (_lastProposal != NULL) {
+        _lastProposal->adaptScale(accepted, _autotuneTargetAcceptanceRate);
+    }
+
+    _autotuneGenerationsLeft--;
+}
+
+
+void Model::startMeasuringProposal()
+{
+    _stateBeforeProposal[0] = _logLikelihood;
+    _stateBeforeProposal[1] = (double)_eventCollection.size();
+    _stateBeforeProposal[2] = _eventRate;
+
+    _proposalStartTime = std::chrono::steady_clock::now();
+}
+
+
+// Called once the proposal was accepted or rejected
+void Model::finishMeasuringProposal()
+{
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - _proposalStartTime;
+
+    if (_proposalCounts.empty()) {
+        _proposalCounts.assign(_proposals.size(), 0);
+        _proposalSeconds.assign(_proposals.size(), 0.0);
+        _proposalSquaredJumps.assign(_proposals.size(),
+            std::vector<double>(NumberOfMeasuredQuantities, 0.0));
+    }
+
+    double state[NumberOfMeasuredQuantities] =
+        { _logLikelihood, (double)_eventCollection.size(), _eventRate };
+
+    int p = _lastParameterUpdated;
+    _proposalCounts[p]++;
+    _proposalSeconds[p] += elapsed.count();
+
+    // Welford's algorithm for the variance of each quantity
+    _stateSamples++;
+    for (int q = 0; q < NumberOfMeasuredQuantities; q++) {
+        double jump = state[q] - _stateBeforeProposal[q];
+        _proposalSquaredJumps[p][q] += jump * jump;
+
+        double delta = state[q] - _stateMeans[q];
+        _stateMeans[q] += delta / _stateSamples;
+        _stateSquaredDeviations[q] += delta * (state[q] - _stateMeans[q]);
+    }
+
+    _weightAdaptationGenerationsLeft--;
+    if (_weightAdaptationGenerationsLeft == 0) {
+        rebalanceProposalWeights();
+    }
+}
+
+
+// The weights w maximize the expected squared jump per second,
+// sum(w J) / sum(w c), where J is the mean squared jump of a proposal
+// (the jumps of each quantity divided by its variance) and c its mean
+// cost, with each weight between the min and max factors of its setting.
+// The optimum puts every weight at one of its bounds: at the max if
+// J - r c > 0, where r is the optimal ratio, found by Dinkelbach's
+// iteration. Proposals that were never made keep their weight.
+void Model::rebalanceProposalWeights()
+{
+    int nProposals = (int)_proposals.size();
+    if (_proposalCounts.empty()) {
+        return;
+    }
+
+    std::vector<double> variances(NumberOfMeasuredQuantities, 0.0);
+    if (_stateSamples > 1) {
+        for (int q = 0; q < NumberOfMeasuredQuantities; q++) {
+            variances[q] = _stateSquaredDeviations[q] / (_stateSamples - 1);
+        }
+    }
+
+    std::vector<double> jumps(nProposals, 0.0);
+    std::vector<double> costs(nProposals, 0.0);
+    std::vector<double> minWeights(nProposals, 0.0);
+    std::vector<double> maxWeights(nProposals, 0.0);
+    std::vector<bool> isMeasured(nProposals, false);
+
+    for (int i = 0; i < nProposals; i++) {
+        isMeasured[i] = _proposalCounts[i] > 0 && _proposals[i]->weight() > 0;
+        if (!isMeasured[i]) {
+            continue;
+        }
+
+        for (int q = 0; q < NumberOfMeasuredQuantities; q++) {
+            if (variances[q] > 0.0) {
+                jumps[i] += _proposalSquaredJumps[i][q] / variances[q];
+            }
+        }
+        jumps[i] /= _proposalCounts[i];
+        costs[i] = _proposalSeconds[i] / _proposalCounts[i];
+
+        double settingWeight = _settings.get<double>
+            (_proposals[i]->weightSettingName());
+        minWeights[i] = _minProposalWeightFactor * settingWeight;
+        maxWeights[i] = _maxProposalWeightFactor * settingWeight;
+    }
+
+    std::vector<double> weights(nProposals, 0.0);
+    double ratio = 0.0;
+    for (int iteration = 0; iteration < 100; iteration++) {
+        double sumJumps = 0.0;
+        double sumCosts = 0.0;
+        for (int i = 0; i < nProposals; i++) {
+            if (!isMeasured[i]) {
+                continue;
+            }
+            weights[i] = (jumps[i] - ratio * costs[i] > 0.0) ?
+                maxWeights[i] : minWeights[i];
+            sumJumps += weights[i] * jumps[i];
+            sumCosts += weights[i] * costs[i];
+        }
+
+        if (sumCosts <= 0.0) {
+            return;
+        }
+
+        double newRatio = sumJumps / sumCosts;
+        if (newRatio <= ratio) {
+            break;
+        }
+        ratio = newRatio;
+    }
+
+    for (int i = 0; i < nProposals; i++) {
+        if (isMeasured[i]) {
+            _proposals[i]->setWeight(weights[i]);
+        }
+    }
+
+    calculateUpdateWeights();
+}
+
+
+std::vector<std::pair<std::string, double> > Model::proposalWeights() const
+{
+    std::vector<std::pair<std::string, double> > weights;
+
+    for (int i = 0; i < (int)_proposals.size(); i++) {
+        if (_proposals[i]->weight() > 0) {
+            weights.push_back(std::make_pair
+                (_proposals[i]->weightSettingName(), _proposals[i]->weight()));
+        }
+    }
+
+    return weights;
+}
+
+
+void Model::writeProposalWeightState(std::ostream& out) const
+{
+    Checkpoint::write(out, _weightAdaptationGenerationsLeft);
+
+    for (int i = 0; i < (int)_proposals.size(); i++) {
+        Checkpoint::write(out, _proposals[i]->weight());
+    }
+
+    Checkpoint::writeVector(out, _proposalCounts);
+    Checkpoint::writeVector(out, _proposalSeconds);
+    for (int i = 0; i < (int)_proposalCounts.size(); i++) {
+        Checkpoint::writeVector(out, _proposalSquaredJumps[i]);
+    }
+
+    Checkpoint::write(out, _stateSamples);
+    Checkpoint::writeVector(out, _stateMeans);
+    Checkpoint::writeVector(out, _stateSquaredDeviations);
+}
+
+
+void Model::readProposalWeightState(std::istream& in)
+{
+    Checkpoint::read(in, _weightAdaptationGenerationsLeft);
+
+    for (int i = 0; i < (int)_proposals.size(); i++) {
+        double weight = 0.0;
+        Checkpoint::read(in, weight);
+        _proposals[i]->setWeight(weight);
+    }
+    calculateUpdateWeights();
+
+    Checkpoint::readVector(in, _proposalCounts);
+    Checkpoint::readVector(in, _proposalSeconds);
+    _proposalSquaredJumps.resize(_proposalCounts.size());
+    for (int i = 0; i < (int)_proposalCounts.size(); i++) {
+        Checkpoint::readVector(in, _proposalSquaredJumps[i]);
+    }
+
+    Checkpoint::read(in, _stateSamples);
+    Checkpoint::readVector(in, _stateMeans);
+    Checkpoint::readVector(in, _stateSquaredDeviations);
+}
+
+
+std::vector<std::pair<std::string, double> > Model::proposalScales() const
+{
+    std::vector<std::pair<std::string, double> > scales;
+
+    for (int i = 0; i < (int)_proposals.size(); i++) {
+        if (_proposals[i]->hasTunableScale() && _proposals[i]->weight() > 0) {
+            scales.push_back(std::make_pair(_proposals[i]->scaleSettingName(),
+                _proposals[i]->scaleSettingValue()));
+        }
+    }
+
+    return scales;
 }
 
 
@@ -568,6 +1248,14 @@ double Model::acceptanceRatio()
         return 0.0;
     }
 
+    if (_profiler.isEnabled()) {
+        _profiler.startPhase();
+        double ratio = _lastProposal->acceptanceRatio();
+        _profiler.endPhase
+            (_lastParameterUpdated, ProposalProfiler::AcceptanceRatio);
+        return ratio;
+    }
+
     return _lastProposal->acceptanceRatio();
 }
 
@@ -596,9 +1284,10 @@ double Model::safeExponentiation(double x)
 }
 
 
+// Temperatures above 1 sharpen the posterior (see PosteriorOptimizer)
 void Model::setTemperatureMH(double x)
 {
-    if ((x >= 0) && (x <= 1.0)) {
+    if (x >= 0) {
         _temperatureMH = x;
     } else {
         log(Error) << "Attempt to set invalid temperature in "
@@ -652,3 +1341,157 @@ bool Model::testEventConfigurationComprehensive()
 
 
 
+
+
+void Model::writeState(std::ostream& out) const
+{
+    Checkpoint::write(out, _acceptCount);
+    Checkpoint::write(out, _rejectCount);
+    Checkpoint::write(out, _acceptLast);
+    Checkpoint::write(out, _autotuneGenerationsLeft);
+    Checkpoint::write(out, _temperatureMH);
+
+    writeSampledState(out);
+
+    for (int i = 0; i < (int)_proposals.size(); i++) {
+        _proposals[i]->writeState(out);
+    }
+    writeProposalWeightState(out);
+}
+
+
+void Model::readState(std::istream& in)
+{
+    Checkpoint::read(in, _acceptCount);
+    Checkpoint::read(in, _rejectCount);
+    Checkpoint::read(in, _acceptLast);
+    Checkpoint::read(in, _autotuneGenerationsLeft);
+    Checkpoint::read(in, _temperatureMH);
+
+    readSampledState(in);
+
+    for (int i = 0; i < (int)_proposals.size(); i++) {
+        _proposals[i]->readState(in);
+    }
+    readProposalWeightState(in);
+}
+
+
+void Model::writeSampledState(std::ostream& out) const
+{
+    Checkpoint::write(out, _eventRate);
+    Checkpoint::write(out, _logLikelihood);
+
+    // Events are written in the order of the event set (by map time)
+    Checkpoint::write(out, (int)_eventCollection.size());
+    EventSet::const_iterator it;
+    for (it = _eventCollection.begin(); it != _eventCollection.end(); ++it) {
+        BranchEvent* event = *it;
+        Checkpoint::write(out, event->getParameterId());
+        Checkpoint::write(out, event->getEventNode()->getPreOrderIndex());
+        Checkpoint::write(out, event->getMapTime());
+        Checkpoint::write(out, event->getAbsoluteTime());
+    }
+
+    Checkpoint::write(out, _rootEvent->getParameterId());
+    _eventParameters.writeState(out);
+
+    writeModelState(out);
+}
+
+
+void Model::readSampledState(std::istream& in)
+{
+    Checkpoint::read(in, _eventRate);
+    Checkpoint::read(in, _logLikelihood);
+
+    deleteAllEvents();
+
+    // The new events take IDs from the current store, which is then
+    // replaced by the saved one; the events get back their saved IDs
+    int numberOfEvents = 0;
+    Checkpoint::read(in, numberOfEvents);
+
+    const std::vector<Node*>& nodes = _tree->preOrderNodes();
+    std::vector<BranchEvent*> events;
+
+    for (int i = 0; i < numberOfEvents && in; i++) {
+        EventParameterStore::EventId id;
+        int nodeIndex;
+        double mapTime;
+        double absoluteTime;
+
+        Checkpoint::read(in, id);
+        Checkpoint::read(in, nodeIndex);
+        Checkpoint::read(in, mapTime);
+        Checkpoint::read(in, absoluteTime);
+
+        if (nodeIndex < 0 || nodeIndex >= (int)nodes.size()) {
+            exitWithError("The checkpoint was written for another tree");
+        }
+
+        BranchEvent* event = newBranchEventWithDefaultParameters(mapTime);
+        event->setParameterId(id);
+        event->setEventNode(nodes[nodeIndex]);
+        event->setOldEventNode(nodes[nodeIndex]);
+        event->setAbsoluteTime(absoluteTime);
+        events.push_back(event);
+    }
+
+    EventParameterStore::EventId rootId;
+    Checkpoint::read(in, rootId);
+    _rootEvent->setParameterId(rootId);
+
+    _eventParameters.readState(in);
+
+    for (int i = 0; i < (int)events.size(); i++) {
+        addEventToTree(events[i]);
+    }
+
+    readModelState(in);
+
+    flagBranchesGovernedByEvent(_rootEvent);
+    setMeanBranchParameters();
+
+    _lastEventModified = _rootEvent;
+}
+
+
+void Model::setRandomEventConfiguration(int numberOfEvents)
+{
+    while (!_eventCollection.empty()) {
+        BranchEvent* event = *_eventCollection.begin();
+        removeEventFromTree(event);
+        delete event;
+    }
+
+    for (int i = 0; i < numberOfEvents; i++) {
+        addRandomEventToTree();
+    }
+
+    setCurrentLogLikelihood(computeLogLikelihood());
+}
+
+
+// Deletes the events and resets every branch history to the root event
+// (without updating branch parameters); used only before all events are
+// replaced. Histories must not keep pointers to the deleted events, as
+// new events may be allocated at the same addresses.
+void Model::deleteAllEvents()
+{
+    EventSet::iterator it;
+    for (it = _eventCollection.begin(); it != _eventCollection.end(); ++it) {
+        getBranchHistory((*it)->getEventNode())->popEventOffBranchHistory(*it);
+        delete *it;
+    }
+
+    _eventCollection.clear();
+
+    const std::vector<Node*>& nodes = _tree->preOrderNodes();
+    for (int i = 0; i < (int)nodes.size(); i++) {
+        BranchHistory* history = getBranchHistory(nodes[i]);
+        history->setNodeEvent(_rootEvent);
+        history->setAncestralNodeEvent(_rootEvent);
+        _nodesWithChangedHistory.push_back(nodes[i]);
+    }
+}
@@ -4,30 +4,44 @@
 
 #include "Prior.h"
 #include "BranchEvent.h"
+#include "BranchHistory.h"
+#include "EventParameterStore.h"
+#include "ProposalProfiler.h"
+#include "Node.h"
 
 #include <vector>
 #include <set>
+#include <string>
+#include <utility>
 #include <iosfwd>
+#include <chrono>
 
 class Random;
 class Settings;
 class Tree;
-class Node;
 class Proposal;
+class ChainWorkerPool;
 
 
-typedef std::set<BranchEvent*, BranchEvent::PtrCompare> EventSet;
+// Ordered by map time; events may share a map time (e.g., when moved to
+// the end of a branch), so equal keys are allowed
+typedef std::multiset<BranchEvent*, BranchEvent::PtrCompare> EventSet;
 
 class Model
 {
 
 public:
 
-    Model(Random& random, Settings& settings);
+    // The tree is shared (read-only) with the models of other chains
+    Model(Random& random, Settings& settings, Tree& tree,
+        int numberOfEventParameters);
     virtual ~Model();
 
     Tree* getTreePtr();
 
+    // This chain's branch history for the given node
+    BranchHistory* getBranchHistory(Node* node);
+
     double getEventRate();
     void setEventRate(double x);
 
@@ -39,6 +53,48 @@ public:
     double getMHAcceptanceRate();
     void resetMHAcceptanceParameters();
 
+    // Accepted and rejected proposals since the last reset
+    int getMHAcceptCount() const;
+    int getMHRejectCount() const;
+    void setMHAcceptanceCounts(int acceptCount, int rejectCount);
+
+    // Parameters shared by the whole tree: the event rate, the root
+    // event's parameters and model-specific ones (e.g., the preservation
+    // rate), with positive parameters that are not fixed on the log scale.
+    // A differential-evolution move (see MetropolisCoupledMCMC) adds a
+    // jump to all of them and accepts or rejects the result; it returns
+    // whether the jump was accepted.
+    std::vector<double> globalParameters();
+    bool jumpGlobalParameters(const std::vector<double>& jump);
+    void setGlobalParameters(const std::vector<double>& values);
+
+    // Whether each global parameter is held fixed, because the update
+    // rates of all proposals that change it are 0
+    std::vector<bool> fixedGlobalParameters();
+
+    // The parameters of a non-root event, with positive parameters that
+    // are not fixed on the log scale; setting them updates the branch
+    // parameters and the likelihood (as does setting the global parameters)
+    std::vector<double> eventParameters(BranchEvent* event);
+    void setEventParameters
+        (BranchEvent* event, const std::vector<double>& values);
+
+    // Gives an event the parameters of another (on their natural scale,
+    // since the two may put different parameters on the log scale)
+    void copyEventParameters(BranchEvent* event, BranchEvent* source);
+
+    // Which global (event) parameters a search should leave as they are:
+    // the fixed ones and positive ones at 0, which are both off the log
+    // scale (and out of the Jacobian of logPosterior)
+    std::vector<bool> heldGlobalParameters();
+    std::vector<bool> heldEventParameters(BranchEvent* event);
+
+    // Log of the posterior density of the current state (up to a
+    // constant): the likelihood, the prior and the Poisson probability of
+    // the number of events, whose locations count relative to their
+    // uniform prior
+    double logPosterior();
+
     void setCurrentLogLikelihood(double x);
     double getCurrentLogLikelihood();
 
@@ -68,12 +124,21 @@ public:
 
     BranchEvent* chooseEventAtRandom(bool includeRoot = false);
 
-    // These functions take a branch event and recursively update
-    // the branch histories for all nodes going toward the tips
-    void forwardSetBranchHistories(BranchEvent* x);
-    void forwardSetHistoriesRecursive(Node* p);
+    // These functions take a branch event (or a node whose branch history
+    // has changed) and recursively update the branch histories for all nodes
+    // going toward the tips. They return the nodes whose history changed
+    // since mean branch parameters were last set.
+    const std::vector<Node*>& forwardSetBranchHistories(BranchEvent* x);
+    const std::vector<Node*>& forwardSetBranchHistories(Node* node);
+    void forwardSetHistoriesForDescendants(Node* p);
+
+    // Flags the branch of the event and all branches whose rates derive
+    // from it, for use when the event's time or parameters change
+    void flagBranchesGovernedByEvent(BranchEvent* x);
 
     BranchEvent* addRandomEventToTree();
+    // Adds an event with random parameters at map time x
+    BranchEvent* addRandomEventToTree(double x);
     BranchEvent* addFixedParameterEventToRandomLocation();
     BranchEvent* addRandomEventToTreeOnRandomBranch();
     BranchEvent* addEventToTree(BranchEvent* newEvent);
@@ -81,17 +146,68 @@ public:
     BranchEvent* removeEventFromTree(BranchEvent* be);
     BranchEvent* removeRandomEventFromTree();
 
+    // An event's map time orders the event set, so an event is taken
+    // out of the set while it is moved and put back at its new position
+    void beginEventMove(BranchEvent* be);
+    void endEventMove(BranchEvent* be);
+
+    // Recomputes mean branch parameters for the nodes whose
+    // branch history changed since the last call
     virtual void setMeanBranchParameters() = 0;
 
     double getTemperatureMH();
     void setTemperatureMH(double x);
 
+    // Power of the likelihood in the target of the chain, from 0 (the
+    // prior) to 1 (the posterior); the temperature applies to the result
+    // (see SequentialMonteCarlo)
+    double getLikelihoodPower();
+    void setLikelihoodPower(double x);
+
     double logQRatioJump();
 
     double acceptanceRatio();
 
+    const std::vector<Proposal*>& proposals() const;
+
+    // Time and counts of the proposals (see "outputProposalProfile")
+    ProposalProfiler& profiler();
+
+    // Setting name and tuned value of every proposal scale
+    // (see Proposal::adaptScale)
+    std::vector<std::pair<std::string, double> > proposalScales() const;
+
+    // Setting name and current value of every proposal weight
+    // (see rebalanceProposalWeights)
+    std::vector<std::pair<std::string, double> > proposalWeights() const;
+
     bool isEventConfigurationValid(BranchEvent* be);
     bool testEventConfigurationComprehensive();
+
+    // Saves and restores the complete state of the chain's model
+    // (see Checkpoint); the model must have been constructed with the
+    // same settings and tree as the model that wrote the state
+    void writeState(std::ostream& out) const;
+    void readState(std::istream& in);
+
+    // Saves and restores only the sampled state (the event rate, the
+    // events and their parameters, and the model-specific parameters),
+    // without the counters and the adaptation state of the proposals,
+    // to start a chain from the state of another
+    void writeSampledState(std::ostream& out) const;
+    void readSampledState(std::istream& in);
+
+    // Replaces all events but the root event by numberOfEvents events
+    // at random locations, with parameters drawn from the prior
+    void setRandomEventConfiguration(int numberOfEvents);
+
+    // Copies of the model (owned by the chain) and the threads on which
+    // a proposal may evaluate likelihoods in parallel (see MCMC and
+    // MoveEventProposal); without them, the pool is NULL
+    void setHelperModels
+        (const std::vector<Model*>& models, ChainWorkerPool* pool);
+    const std::vector<Model*>& helperModels() const;
+    ChainWorkerPool* helperPool() const;
     
 protected:
 
@@ -106,6 +222,20 @@ protected:
 
     double safeExponentiation(double x);
 
+    // Called by every full evaluation of the likelihood
+    void countLikelihoodEvaluation();
+
+    void adaptProposalScale(bool accepted);
+
+    void startMeasuringProposal();
+    void finishMeasuringProposal();
+    void rebalanceProposalWeights();
+    void writeProposalWeightState(std::ostream& out) const;
+    void readProposalWeightState(std::istream& in);
+
+    const std::vector<Node*>& nodesWithChangedHistory();
+    void clearNodesWithChangedHistory();
+
     // Pure virtual methods to be implemented by derived classes
 
     virtual void setRootEventWithReadParameters
@@ -122,6 +252,47 @@ protected:
 
     virtual BranchEvent* newBranchEventFromLastDeletedEvent() = 0;
 
+    // Creates an event at map time x whose parameters are set afterwards
+    // (when restoring a checkpoint)
+    virtual BranchEvent* newBranchEventWithDefaultParameters(double x) = 0;
+
+    // The model-specific global parameters (after the event rate), on
+    // their natural scale; isLogScale tells which are positive and jump
+    // on the log scale. Setting them also
+    // updates the branch parameters; parameters that cannot change
+    // (e.g., the shift of a time-constant root event) are left as they are.
+    virtual void getModelGlobalParameters
+        (std::vector<double>& values, std::vector<bool>& isLogScale) = 0;
+    virtual void setModelGlobalParameters(const double* values) = 0;
+    virtual void getModelFixedGlobalParameters(std::vector<bool>& isFixed) = 0;
+
+    // The same for the parameters of a non-root event, which are set
+    // without updating the branch parameters
+    virtual void getModelEventParameters(BranchEvent* event,
+        std::vector<double>& values, std::vector<bool>& isLogScale) = 0;
+    virtual void setModelEventParameters
+        (BranchEvent* event, const double* values) = 0;
+    virtual void getModelFixedEventParameters(std::vector<bool>& isFixed) = 0;
+
+    // Model-specific state that is not in the events
+    virtual void writeModelState(std::ostream& out) const = 0;
+    virtual void readModelState(std::istream& in) = 0;
+
+    // All global (event) parameters, on their natural scale, which of
+    // them globalParameters() (eventParameters()) puts on the log scale
+    // and which are held
+    void getGlobalParameters(std::vector<double>& values,
+        std::vector<bool>& isLogScale, std::vector<bool>& isHeld);
+    void getEventParameters(BranchEvent* event, std::vector<double>& values,
+        std::vector<bool>& isLogScale, std::vector<bool>& isHeld);
+    static void holdParameters(const std::vector<double>& values,
+        std::vector<bool>& isLogScale, std::vector<bool>& isHeld);
+
+    void deleteAllEvents();
+
+    // Erases the event itself (not an event with the same map time)
+    void eraseFromEventCollection(BranchEvent* be);
+
     Random& _random;
     Settings& _settings;
 
@@ -129,6 +300,13 @@ protected:
 
     Tree* _tree;
 
+    // Branch history of each node, indexed by pre-order index
+    std::vector<BranchHistory> _branchHistories;
+
+    // Parameters of all events (including the root event and events
+    // removed from the tree but not yet deleted)
+    EventParameterStore _eventParameters;
+
     std::vector<Proposal*> _proposals;
 
     std::vector<double> _updateWeights;
@@ -151,11 +329,48 @@ protected:
     int _acceptLast;    // true if last generation was accept; false otherwise
     // 0 = last was rejected; 1 = accepted; -1 = not set.
 
+    // With "autotune", the scale of every proposal is adapted during
+    // the first autotuneGenerations generations of the chain, then frozen
+    int _autotuneGenerationsLeft;
+    double _autotuneTargetAcceptanceRate;
+
+    // With "adaptProposalWeights", the cost (wall-clock seconds) of every
+    // proposal and how far it moves the chain (squared jumps of logLik,
+    // N_shifts and eventRate) are measured during the first
+    // proposalWeightAdaptationGenerations generations of the chain. The
+    // weights are then rebalanced within the given factors of their
+    // settings and frozen.
+    int _weightAdaptationGenerationsLeft;
+    double _minProposalWeightFactor;
+    double _maxProposalWeightFactor;
+
+    std::chrono::steady_clock::time_point _proposalStartTime;
+    std::vector<double> _stateBeforeProposal;
+
+    // Per proposal: number of times proposed, seconds spent,
+    // and sum of squared jumps of each quantity
+    std::vector<int> _proposalCounts;
+    std::vector<double> _proposalSeconds;
+    std::vector<std::vector<double> > _proposalSquaredJumps;
+
+    // Running mean and sum of squared deviations of each quantity,
+    // used to put the jumps of different quantities on the same scale
+    int _stateSamples;
+    std::vector<double> _stateMeans;
+    std::vector<double> _stateSquaredDeviations;
+
+    ProposalProfiler _profiler;
+    int _likelihoodEvaluations;
+
     EventSet _eventCollection;
     BranchEvent* _rootEvent;
 
     double _lastDeletedEventMapTime;    // map time of last deleted event
 
+    // Nodes whose ancestral event, node event or events on branch changed
+    // since mean branch parameters were last set (may contain duplicates)
+    std::vector<Node*> _nodesWithChangedHistory;
+
     // Last event modified, whether it is moved, or has value updated
     BranchEvent* _lastEventModified;
 
@@ -166,6 +381,11 @@ protected:
 
     // Temperature parameter for Metropolis coupling:
     double _temperatureMH;
+
+    double _likelihoodPower;
+
+    std::vector<Model*> _helperModels;
+    ChainWorkerPool* _helperPool;
 };
 
 
@@ -175,6 +395,12 @@ inline Tree* Model::getTreePtr()
 }
 
 
+inline BranchHistory* Model::getBranchHistory(Node* node)
+{
+    return &_branchHistories[node->getPreOrderIndex()];
+}
+
+
 inline int Model::getLastParameterUpdated()
 {
     return _lastParameterUpdated;
@@ -187,6 +413,43 @@ inline EventSet& Model::events()
 }
 
 
+inline int Model::getMHAcceptCount() const
+{
+    return _acceptCount;
+}
+
+
+inline int Model::getMHRejectCount() const
+{
+    return _rejectCount;
+}
+
+
+inline void Model::setMHAcceptanceCounts(int acceptCount, int rejectCount)
+{
+    _acceptCount = acceptCount;
+    _rejectCount = rejectCount;
+}
+
+
+inline const std::vector<Proposal*>& Model::proposals() const
+{
+    return _proposals;
+}
+
+
+inline ProposalProfiler& Model::profiler()
+{
+    return _profiler;
+}
+
+
+inline void Model::countLikelihoodEvaluation()
+{
+    _likelihoodEvaluations++;
+}
+
+
 inline double Model::getEventRate()
 {
     return _eventRate;
@@ -265,10 +528,42 @@ inline double Model::getTemperatureMH()
 }
 
 
+inline double Model::getLikelihoodPower()
+{
+    return _likelihoodPower;
+}
+
+
+inline void Model::setLikelihoodPower(double x)
+{
+    _likelihoodPower = x;
+}
+
+
 inline double Model::logQRatioJump()
 {
     return _logQRatioJump;
 }
 
 
+inline void Model::setHelperModels
+    (const std::vector<Model*>& models, ChainWorkerPool* pool)
+{
+    _helperModels = models;
+    _helperPool = pool;
+}
+
+
+inline const std::vector<Model*>& Model::helperModels() const
+{
+    return _helperModels;
+}
+
+
+inline ChainWorkerPool* Model::helperPool() const
+{
+    return _helperPool;
+}
+
+
 #endif
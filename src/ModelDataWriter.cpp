@@ -26,3 +26,11 @@ void ModelDataWriter::writeData(int generation, Model& model)
     _mcmcDataWriter.writeData(generation, model);
     _acceptanceDataWriter.writeData(model);
 }
+
+
+void ModelDataWriter::appendToExistingOutput(bool headerWritten)
+{
+    _stdOutDataWriter.appendToExistingOutput(headerWritten);
+    _mcmcDataWriter.appendToExistingOutput();
+    _acceptanceDataWriter.appendToExistingOutput();
+}
@@ -19,6 +19,10 @@ public:
 
     virtual void writeData(int generation, Model& model);
 
+    // Switches all outputs to append mode, so that several processes can
+    // take turns writing the cold chain's data to the same files
+    virtual void appendToExistingOutput(bool headerWritten);
+
 protected:
 
     Settings &_settings;
@@ -2,6 +2,8 @@
 #define MODEL_FACTORY
 
 
+#include <string>
+
 class Model;
 class EventDataWriter;
 class ModelDataWriter;
@@ -9,6 +11,7 @@ class ModelDataWriter;
 class Random;
 class Settings;
 class Prior;
+class Tree;
 
 
 class ModelFactory
@@ -17,9 +20,12 @@ public:
 
     virtual ~ModelFactory() {}
 
-    virtual Model* createModel(Random& random, Settings& settings) const = 0;
+    virtual Model* createModel
+        (Random& random, Settings& settings, Tree& tree) const = 0;
     virtual ModelDataWriter* createModelDataWriter
         (Settings& settings) const = 0;
+    virtual EventDataWriter* createEventDataWriter
+        (const std::string& outputFileName) const = 0;
 };
 
 
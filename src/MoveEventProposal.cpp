@@ -5,19 +5,36 @@
 #include "Node.h"
 #include "BranchHistory.h"
 #include "Tree.h"
+#include "BranchEvent.h"
+#include "ChainWorkerPool.h"
+#include "Log.h"
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
 
 
 MoveEventProposal::MoveEventProposal
     (Random& random, Settings& settings, Model& model) :
         _random(random), _settings(settings), _model(model)
 {
-    _weight = _settings.get<double>("updateRateEventPosition");
+    readWeight(_settings, "updateRateEventPosition");
 
     _localToGlobalMoveRatio = _settings.get<double>("localGlobalMoveRatio");
+    double maxRootToTipLength = _model.getTreePtr()->maxRootToTipLength();
     _scale = _settings.get<double>("updateEventLocationScale") *
-        _model.getTreePtr()->maxRootToTipLength();
+        maxRootToTipLength;
+    setTunableScale(&_scale, "updateEventLocationScale", maxRootToTipLength);
+
+    _lastMoveWasLocal = false;
+
+    _numberOfTries = _settings.get<int>("eventLocationTries");
+    if (_numberOfTries < 1) {
+        exitWithError("eventLocationTries must be at least 1");
+    }
+
+    _logWeightRatio = 0.0;
 
     _validateEventConfiguration =
         _settings.get<bool>("validateEventConfiguration");
@@ -27,6 +44,7 @@ MoveEventProposal::MoveEventProposal
 void MoveEventProposal::propose()
 {
     _currentEventCount = _model.getNumberOfEvents();
+    _lastMoveWasLocal = false;
     if (_currentEventCount == 0) {
         return;
     }
@@ -34,35 +52,276 @@ void MoveEventProposal::propose()
     _event = _model.chooseEventAtRandom();
     _currentLogLikelihood = _model.getCurrentLogLikelihood();
 
-    // This is the event preceding the chosen event;
-    // histories should be set forward from here
-    BranchEvent* previousEvent = _event->getEventNode()->getBranchHistory()->
-        getLastEvent(_event);
+    if (_numberOfTries > 1) {
+        proposeMultipleTries();
+        return;
+    }
+
+    // Branches whose rates derive from the event in its current position
+    _model.flagBranchesGovernedByEvent(_event);
 
-    _event->getEventNode()->getBranchHistory()->
-        popEventOffBranchHistory(_event);
+    // This is the branch the event is leaving;
+    // histories should be set forward from here
+    Node* previousNode = _event->getEventNode();
+    _model.getBranchHistory(previousNode)->popEventOffBranchHistory(_event);
 
     double localMoveProb = _localToGlobalMoveRatio /
         (1 + _localToGlobalMoveRatio);
 
     // Choose to move locally or globally
-    if (_random.trueWithProbability(localMoveProb)) {
+    _lastMoveWasLocal = _random.trueWithProbability(localMoveProb);
+    _model.beginEventMove(_event);
+    if (_lastMoveWasLocal) {
         double step = _random.uniform(0, _scale) - 0.5 * _scale;
         _event->moveEventLocal(step);
     } else {
         _event->moveEventGlobal();
     }
+    _model.endEventMove(_event);
 
-    _event->getEventNode()->getBranchHistory()->addEventToBranchHistory(_event);
+    _model.getBranchHistory(_event->getEventNode())->
+        addEventToBranchHistory(_event);
 
-    _model.forwardSetBranchHistories(previousEvent);
-    _model.forwardSetBranchHistories(_event);
+    _model.forwardSetBranchHistories(previousNode);
+    _model.forwardSetBranchHistories(_event->getEventNode());
+    _model.flagBranchesGovernedByEvent(_event);
     _model.setMeanBranchParameters();
 
     _proposedLogLikelihood = _model.computeLogLikelihood();
 }
 
 
+void MoveEventProposal::proposeMultipleTries()
+{
+    _originalPosition = eventPosition();
+
+    // The helper models start from the current state
+    bool parallel = _model.helperPool() != NULL;
+    if (parallel) {
+        synchronizeHelperModels();
+    }
+
+    double localMoveProb = _localToGlobalMoveRatio /
+        (1 + _localToGlobalMoveRatio);
+    _lastMoveWasLocal = _random.trueWithProbability(localMoveProb);
+    Move move = _lastMoveWasLocal ? LocalMove : GlobalMove;
+
+    std::vector<Position> candidates;
+    std::vector<bool> candidatesValid;
+    std::vector<double> candidateLogLikelihoods;
+    for (int i = 0; i < _numberOfTries; i++) {
+        candidates.push_back(relocateEvent(_model, _event,
+            _originalPosition, move));
+        candidatesValid.push_back(isPositionValid());
+        candidateLogLikelihoods.push_back
+            (scoreDrawnPosition(candidatesValid.back(), parallel));
+    }
+    if (parallel) {
+        scorePositionsInParallel
+            (candidates, candidatesValid, candidateLogLikelihoods);
+    }
+
+    // Choose a candidate with probability proportional to its weight
+    double t = _model.getTemperatureMH() * _model.getLikelihoodPower();
+    double maxLogLikelihood = *std::max_element
+        (candidateLogLikelihoods.begin(), candidateLogLikelihoods.end());
+
+    std::vector<double> cumulativeWeights;
+    double totalWeight = 0.0;
+    for (int i = 0; i < _numberOfTries; i++) {
+        totalWeight +=
+            std::exp(t * (candidateLogLikelihoods[i] - maxLogLikelihood));
+        cumulativeWeights.push_back(totalWeight);
+    }
+
+    int chosen = _numberOfTries - 1;
+    if (std::isfinite(maxLogLikelihood)) {
+        double u = _random.uniform(0.0, totalWeight);
+        chosen = (int)(std::upper_bound(cumulativeWeights.begin(),
+            cumulativeWeights.end(), u) - cumulativeWeights.begin());
+        chosen = std::min(chosen, _numberOfTries - 1);
+    }
+
+    // Reference positions are drawn from the chosen candidate;
+    // the original position is the last of them
+    std::vector<Position> references;
+    std::vector<bool> referencesValid;
+    std::vector<double> referenceLogLikelihoods;
+    for (int i = 0; i < _numberOfTries - 1; i++) {
+        references.push_back(relocateEvent(_model, _event,
+            candidates[chosen], move));
+        referencesValid.push_back(isPositionValid());
+        referenceLogLikelihoods.push_back
+            (scoreDrawnPosition(referencesValid.back(), parallel));
+    }
+    if (parallel) {
+        scorePositionsInParallel
+            (references, referencesValid, referenceLogLikelihoods);
+    }
+    referenceLogLikelihoods.push_back(_currentLogLikelihood);
+
+    _logWeightRatio = logSumOfWeights(candidateLogLikelihoods) -
+        logSumOfWeights(referenceLogLikelihoods);
+
+    relocateEvent(_model, _event, candidates[chosen], NoMove);
+    _proposedLogLikelihood = candidateLogLikelihoods[chosen];
+}
+
+
+// With validateEventConfiguration, a position that makes the event
+// configuration invalid has zero weight
+bool MoveEventProposal::isPositionValid()
+{
+    return !_validateEventConfiguration ||
+        _model.isEventConfigurationValid(_event);
+}
+
+
+// The log-likelihood of the position the event was just moved to, or
+// minus infinity (a weight of zero) if it is invalid; with helper models,
+// valid positions are scored afterwards (0 until then)
+double MoveEventProposal::scoreDrawnPosition(bool valid, bool parallel)
+{
+    if (!valid) {
+        return -std::numeric_limits<double>::infinity();
+    } else if (parallel) {
+        return 0.0;
+    } else {
+        return _model.computeLogLikelihood();
+    }
+}
+
+
+// The helper models score the valid positions in parallel, each taking
+// every n-th position, and then move their event back
+void MoveEventProposal::scorePositionsInParallel
+    (const std::vector<Position>& positions, const std::vector<bool>& valid,
+     std::vector<double>& logLikelihoods)
+{
+    int n = (int)positions.size();
+    const std::vector<Model*>& helpers = _model.helperModels();
+    int nHelpers = std::min((int)helpers.size(), n);
+
+    _model.helperPool()->run(nHelpers, [&](int h) {
+        Model& helper = *helpers[h];
+        BranchEvent* event = _helperEvents[h];
+
+        bool moved = false;
+        for (int i = h; i < n; i += nHelpers) {
+            if (valid[i]) {
+                relocateEvent(helper, event, positions[i], NoMove);
+                logLikelihoods[i] = helper.computeLogLikelihood();
+                moved = true;
+            }
+        }
+
+        if (moved) {
+            relocateEvent(helper, event, _originalPosition, NoMove);
+        }
+    });
+}
+
+
+// The helper models keep the state they were last given (their events
+// return to it after scoring), so they are only updated when the chain
+// has moved since
+void MoveEventProposal::synchronizeHelperModels()
+{
+    std::ostringstream out;
+    _model.writeSampledState(out);
+    std::string state = out.str();
+
+    const std::vector<Model*>& helpers = _model.helperModels();
+    if (state != _helperState) {
+        _helperState = state;
+        _model.helperPool()->run((int)helpers.size(), [&](int h) {
+            std::istringstream in(_helperState);
+            helpers[h]->readSampledState(in);
+        });
+    }
+
+    // The event keeps its parameter ID in every copy of the state
+    _helperEvents.assign(helpers.size(), NULL);
+    for (int h = 0; h < (int)helpers.size(); h++) {
+        EventSet& events = helpers[h]->events();
+        EventSet::iterator it;
+        for (it = events.begin(); it != events.end(); ++it) {
+            if ((*it)->getParameterId() == _event->getParameterId()) {
+                _helperEvents[h] = *it;
+                break;
+            }
+        }
+    }
+}
+
+
+MoveEventProposal::Position MoveEventProposal::relocateEvent
+    (Model& model, BranchEvent* event, const Position& from, Move move)
+{
+    model.flagBranchesGovernedByEvent(event);
+
+    Node* previousNode = event->getEventNode();
+    model.getBranchHistory(previousNode)->popEventOffBranchHistory(event);
+
+    model.beginEventMove(event);
+    event->setEventNode(from.node);
+    event->setMapTime(from.mapTime);
+    event->setAbsoluteTime(from.absoluteTime);
+    if (move == LocalMove) {
+        double step = _random.uniform(0, _scale) - 0.5 * _scale;
+        event->moveEventLocal(step);
+    } else if (move == GlobalMove) {
+        event->moveEventGlobal();
+    }
+    model.endEventMove(event);
+
+    model.getBranchHistory(event->getEventNode())->
+        addEventToBranchHistory(event);
+
+    model.forwardSetBranchHistories(previousNode);
+    model.forwardSetBranchHistories(event->getEventNode());
+    model.flagBranchesGovernedByEvent(event);
+    model.setMeanBranchParameters();
+
+    Position position;
+    position.node = event->getEventNode();
+    position.mapTime = event->getMapTime();
+    position.absoluteTime = event->getAbsoluteTime();
+    return position;
+}
+
+
+MoveEventProposal::Position MoveEventProposal::eventPosition() const
+{
+    Position position;
+    position.node = _event->getEventNode();
+    position.mapTime = _event->getMapTime();
+    position.absoluteTime = _event->getAbsoluteTime();
+    return position;
+}
+
+
+// Log of the sum of the positions' weights, exp(t * logLikelihood),
+// where t includes the power of the likelihood
+double MoveEventProposal::logSumOfWeights
+    (const std::vector<double>& logLikelihoods) const
+{
+    double t = _model.getTemperatureMH() * _model.getLikelihoodPower();
+    double maxLogWeight = t * *std::max_element
+        (logLikelihoods.begin(), logLikelihoods.end());
+    if (!std::isfinite(maxLogWeight)) {
+        return maxLogWeight;
+    }
+
+    double sum = 0.0;
+    for (int i = 0; i < (int)logLikelihoods.size(); i++) {
+        sum += std::exp(t * logLikelihoods[i] - maxLogWeight);
+    }
+
+    return maxLogWeight + std::log(sum);
+}
+
+
 void MoveEventProposal::accept()
 {
     if (_currentEventCount == 0) {
@@ -79,24 +338,30 @@ void MoveEventProposal::reject()
         return;
     }
 
-    // Get last event from position of event to be removed
-    BranchEvent* lastEvent = _event->getEventNode()->getBranchHistory()->
-        getLastEvent(_event);
+    if (_numberOfTries > 1) {
+        relocateEvent(_model, _event, _originalPosition, NoMove);
+        return;
+    }
+
+    _model.flagBranchesGovernedByEvent(_event);
 
     // Pop event off its new location
-    _event->getEventNode()->getBranchHistory()->
-        popEventOffBranchHistory(_event);
+    Node* proposedNode = _event->getEventNode();
+    _model.getBranchHistory(proposedNode)->popEventOffBranchHistory(_event);
 
     // Reset nodeptr, reset mapTime
+    _model.beginEventMove(_event);
     _event->revertOldMapPosition();
+    _model.endEventMove(_event);
 
-    // Now reset forward from _lastEventChanged (new position)
-    // and from newLastEvent, which holds 'last' event before old position
-    _event->getEventNode()->getBranchHistory()->
+    // Now reset forward from the branch the event is leaving (new position)
+    // and from the branch it returns to (old position)
+    _model.getBranchHistory(_event->getEventNode())->
         addEventToBranchHistory(_event);
 
-    _model.forwardSetBranchHistories(lastEvent);
-    _model.forwardSetBranchHistories(_event);
+    _model.forwardSetBranchHistories(proposedNode);
+    _model.forwardSetBranchHistories(_event->getEventNode());
+    _model.flagBranchesGovernedByEvent(_event);
     _model.setMeanBranchParameters();
 }
 
@@ -112,10 +377,15 @@ double MoveEventProposal::acceptanceRatio()
         return 0.0;
     }
 
-    double logLikelihoodRatio = computeLogLikelihoodRatio();
+    double logRatio = 0.0;
+    if (_numberOfTries > 1) {
+        logRatio = _logWeightRatio;
+    } else {
+        double logLikelihoodRatio = computeLogLikelihoodRatio();
 
-    double t = _model.getTemperatureMH();
-    double logRatio = t * logLikelihoodRatio;
+        double t = _model.getTemperatureMH() * _model.getLikelihoodPower();
+        logRatio = t * logLikelihoodRatio;
+    }
 
     if (std::isfinite(logRatio)) {
         return std::min(1.0, std::exp(logRatio));
@@ -129,3 +399,10 @@ double MoveEventProposal::computeLogLikelihoodRatio()
 {
     return _proposedLogLikelihood - _currentLogLikelihood;
 }
+
+
+// Global moves do not depend on the scale
+bool MoveEventProposal::lastProposalUsedScale() const
+{
+    return _lastMoveWasLocal;
+}
@@ -4,10 +4,14 @@
 
 #include "Proposal.h"
 
+#include <vector>
+#include <string>
+
 class Random;
 class Settings;
 class Model;
 class BranchEvent;
+class Node;
 
 
 class MoveEventProposal : public Proposal
@@ -24,14 +28,55 @@ public:
 
 private:
 
+    // Where an event is on the tree
+    struct Position
+    {
+        Node* node;
+        double mapTime;
+        double absoluteTime;
+    };
+
+    enum Move
+    {
+        NoMove,
+        LocalMove,
+        GlobalMove
+    };
+
+    // Multiple-try Metropolis (Liu et al. 2000): draws _numberOfTries
+    // candidate positions, chooses one in proportion to its (tempered)
+    // likelihood, and draws reference positions back from it. The
+    // positions are drawn on the chain's model; if it has helper models
+    // (see Model::helperModels), these score them in parallel.
+    void proposeMultipleTries();
+
+    bool isPositionValid();
+    double scoreDrawnPosition(bool valid, bool parallel);
+    void scorePositionsInParallel(const std::vector<Position>& positions,
+        const std::vector<bool>& valid, std::vector<double>& logLikelihoods);
+    void synchronizeHelperModels();
+
+    // Moves the event of the given model to the given position, or to a
+    // position drawn from it by the given move, updating the branch
+    // histories; returns the new position
+    Position relocateEvent(Model& model, BranchEvent* event,
+        const Position& from, Move move);
+    Position eventPosition() const;
+
+    double logSumOfWeights(const std::vector<double>& logLikelihoods) const;
+
     virtual double computeLogLikelihoodRatio();
 
+    virtual bool lastProposalUsedScale() const;
+
     Random& _random;
     Settings& _settings;
     Model& _model;
 
     double _localToGlobalMoveRatio;
+    int _numberOfTries;
     double _scale;
+    bool _lastMoveWasLocal;
 
     bool _validateEventConfiguration;
 
@@ -40,6 +85,17 @@ private:
     int _currentEventCount;
     double _currentLogLikelihood;
     double _proposedLogLikelihood;
+
+    // With multiple tries, the event's position before the proposal
+    // and the log of the ratio of the candidates' total weight to the
+    // reference positions' total weight
+    Position _originalPosition;
+    double _logWeightRatio;
+
+    // The state last given to the helper models, and the event
+    // of each of them that corresponds to the moved event
+    std::string _helperState;
+    std::vector<BranchEvent*> _helperEvents;
 };
 
 
@@ -3,6 +3,7 @@
 #include "Settings.h"
 #include "Model.h"
 #include "Prior.h"
+#include "SpExModel.h"
 #include "Tree.h"
 #include "SpExBranchEvent.h"
 
@@ -11,8 +12,9 @@ MuInitProposal::MuInitProposal
     (Random& random, Settings& settings, Model& model, Prior& prior) :
         EventParameterProposal(random, settings, model, prior)
 {
-    _weight = _settings.get<double>("updateRateMu0");
+    readWeight(_settings, "updateRateMu0");
     _updateMuInitScale = _settings.get<double>("updateMuInitScale");
+    setTunableScale(&_updateMuInitScale, "updateMuInitScale");
 }
 
 
@@ -43,8 +45,9 @@ void MuInitProposal::revertToOldParameterValue()
 
 void MuInitProposal::updateParameterOnTree()
 {
-    _tree->setNodeSpeciationParameters();
-    _tree->setNodeExtinctionParameters();
+    SpExModel& model = static_cast<SpExModel&>(_model);
+    model.setNodeSpeciationParameters();
+    model.setNodeExtinctionParameters();
 }
 
 
@@ -3,6 +3,7 @@
 #include "Settings.h"
 #include "Model.h"
 #include "Prior.h"
+#include "SpExModel.h"
 #include "Tree.h"
 #include "SpExBranchEvent.h"
 
@@ -11,8 +12,9 @@ MuShiftProposal::MuShiftProposal
     (Random& random, Settings& settings, Model& model, Prior& prior) :
         EventParameterProposal(random, settings, model, prior)
 {
-    _weight = _settings.get<double>("updateRateMuShift");
+    readWeight(_settings, "updateRateMuShift");
     _updateMuShiftScale = _settings.get<double>("updateMuShiftScale");
+    setTunableScale(&_updateMuShiftScale, "updateMuShiftScale");
 }
 
 
@@ -42,8 +44,9 @@ void MuShiftProposal::revertToOldParameterValue()
 
 void MuShiftProposal::updateParameterOnTree()
 {
-    _tree->setNodeSpeciationParameters();
-    _tree->setNodeExtinctionParameters();
+    SpExModel& model = static_cast<SpExModel&>(_model);
+    model.setNodeSpeciationParameters();
+    model.setNodeExtinctionParameters();
 }
 
 
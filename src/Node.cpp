@@ -29,44 +29,36 @@ void Node::init(int x)
     _anc = NULL;
     _name = "";
     _index = x;
+    _preOrderIndex = 0;
+    _subtreeSize = 1;
     _time = 0.0;
     _brlen = 0.0;
     _isTip = false;
     _isExtant = false;
     _isConstant = false;
+    _isLivingTip = false;
     _tipDescCount = 0;
 
     _mapStart = 0.0;
     _mapEnd = 0.0;
 
     _branchTime = 0.0;
-    _cladeName = "";
 
-    _history = new BranchHistory();
-
-    // Compound Poisson stuff
-    _meanSpeciationRate = 0.0;
-    _meanExtinctionRate = 0.0;
+    _canHoldEvent = false;
+}
 
-    _nodeLambda = 0.0;
-    _nodeMu = 0.0;
 
-    // For phenotypes:
-    //Phenotype * pheno = new Phenotype();
-    _trait = 0.0;
-    _meanBeta = 0;
-    _isTraitFixed = 0;
+SpExNodeState::SpExNodeState() :
+    meanSpeciationRate(0.0), meanExtinctionRate(0.0),
+    nodeLambda(0.0), nodeMu(0.0), di(-1.0), ei(-1.0), etip(-1.0),
+    eEnd(-1.0), hasDownstreamRateShift(false), inheritFromLeft(false)
+{
+}
 
-    _ei = -1.0;
-    _di = -1.0;
-    _etip = -1.0;
-    _nodeLikelihood = 0.0;
 
-    _canHoldEvent = false;
-    
-    _eEnd = -1.0;
-    _hasDownstreamRateShift = false;
-    _inheritFromLeft = false;
+TraitNodeState::TraitNodeState() :
+    trait(0.0), meanBeta(0.0), nodeBeta(0.0), isTraitFixed(false)
+{
 }
 
 
@@ -197,114 +189,9 @@ double Node::pathLengthToRoot()
 
  */
 
-// If arg == void
-//      COMPUTE rates
-void Node::computeNodeBranchSpeciationParams()
-{
-
-    BranchHistory* bh = getBranchHistory();
-
-    if (getAnc() != NULL) {
-        SpExBranchEvent* ancestralEvent =
-            static_cast<SpExBranchEvent*>(bh->getAncestralNodeEvent());
-
-        double rate = 0.0;
-        int n_events = bh->getNumberOfBranchEvents();
-
-        if (n_events == 0) {
-
-            double t1 = getAnc()->getTime();
-            double t2 = getTime();
-
-            // Times must be relative to event occurrence time
-            t1 -= ancestralEvent->getAbsoluteTime();
-            t2 -= ancestralEvent->getAbsoluteTime();
-
-            double zpar = ancestralEvent->getLamShift();
-            double lam0 = ancestralEvent->getLamInit();
-
-            rate = integrateExponentialRateFunction(lam0, zpar, t1, t2);
-            rate /= getBrlen();
-
-        } else {
-
-            double tcheck = 0.0;
-            double t1 = getAnc()->getTime();
-            double t2 = bh->getEventByIndexPosition(0)->getAbsoluteTime();
-
-            tcheck += (t2 - t1);
-
-            // Times must be relative to initial time of event
-            t1 -= ancestralEvent->getAbsoluteTime();
-            t2 -= ancestralEvent->getAbsoluteTime();
-
-            double zpar = ancestralEvent->getLamShift();
-            double lam0 = ancestralEvent->getLamInit();
-
-            rate = integrateExponentialRateFunction(lam0, zpar, t1, t2);
-
-            for (int k = 1; k < n_events; k++) {
-                SpExBranchEvent* eventAtK = static_cast<SpExBranchEvent*>
-                    (bh->getEventByIndexPosition(k));
-                SpExBranchEvent* eventAtKMinus1 = static_cast<SpExBranchEvent*>
-                    (bh->getEventByIndexPosition(k - 1));
-
-                t1 = 0.0;
-                t2 = eventAtK->getAbsoluteTime() -
-                     eventAtKMinus1->getAbsoluteTime();
-                zpar = eventAtKMinus1->getLamShift();
-                lam0 = eventAtKMinus1->getLamInit();
-
-                rate += integrateExponentialRateFunction(lam0, zpar, t1, t2);
-
-                tcheck += (t2 - t1);
-            }
-
-            t1 = 0.0;
-            t2 = getTime() -
-                bh->getEventByIndexPosition((n_events - 1))->getAbsoluteTime();
-
-            SpExBranchEvent* event = static_cast<SpExBranchEvent*>
-                (bh->getNodeEvent());
-
-            zpar = event->getLamShift();
-            lam0 = event->getLamInit();
-
-            rate += integrateExponentialRateFunction(lam0, zpar, t1, t2);
-
-            tcheck += (t2 - t1);
-
-            // The overall mean rate across the branch:
-            rate /= (getBrlen());
-        }
-
-        setMeanSpeciationRate(rate); // extinction rate for branch set
-
-    } else {
-        // Node is root
-        setMeanSpeciationRate(0.0);
-    }
-
-    // Compute speciation rate at the focal node
-    SpExBranchEvent* event = static_cast<SpExBranchEvent*>(bh->getNodeEvent());
-    double reltime = getTime() - event->getAbsoluteTime();
-    double r_init = event->getLamInit();
-    double r_shift = event->getLamShift();
-    double curLam = getExponentialRate(r_init, r_shift, reltime);
-
-#ifdef DEBUG_TIME_VARIABLE
-    // Try setting node speciation rates equal to mean rate on
-    // descendant branches, to see if the high-rate trap disappears
-#else
-    setNodeLambda(curLam); // speciation rate for node set
-#endif
-}
-
-
-
-void Node::computeAndSetNodeSpeciationParams()
+void Node::computeAndSetNodeSpeciationParams
+    (BranchHistory* bh, SpExNodeState& state)
 {
-    BranchHistory* bh = getBranchHistory();
     // Compute speciation rate at the focal node
     SpExBranchEvent* event = static_cast<SpExBranchEvent*>(bh->getNodeEvent());
     double reltime = getTime() - event->getAbsoluteTime();
@@ -312,14 +199,13 @@ void Node::computeAndSetNodeSpeciationParams()
     double r_shift = event->getLamShift();
     double curLam = getExponentialRate(r_init, r_shift, reltime);
 
-    setNodeLambda(curLam); // speciation rate for node set
+    state.nodeLambda = curLam; // speciation rate for node set
 
 }
 
-void Node::computeAndSetNodeExtinctionParams()
+void Node::computeAndSetNodeExtinctionParams
+    (BranchHistory* bh, SpExNodeState& state)
 {
-
-    BranchHistory* bh = getBranchHistory();
     // Compute extinction rate at the focal node:
     SpExBranchEvent* event = static_cast<SpExBranchEvent*>(bh->getNodeEvent());
     double reltime = getTime() - event->getAbsoluteTime();
@@ -327,21 +213,21 @@ void Node::computeAndSetNodeExtinctionParams()
     double r_shift = event->getMuShift();
     double curMu = getExponentialRate(r_init, r_shift, reltime);
 
-    setNodeMu(curMu); // extinction rate for node
+    state.nodeMu = curMu; // extinction rate for node
 
 }
 
 
-void Node::computeNodeBranchExtinctionParams()
+// The events on the branch are visited only once for both rates
+void Node::computeNodeBranchSpeciationExtinctionParams
+    (BranchHistory* bh, SpExNodeState& state)
 {
-
-    BranchHistory* bh = getBranchHistory();
-
     if (getAnc() != NULL) {
         SpExBranchEvent* ancestralEvent =
             static_cast<SpExBranchEvent*>(bh->getAncestralNodeEvent());
 
-        double rate = 0.0;
+        double lamRate = 0.0;
+        double muRate = 0.0;
         int n_events = bh->getNumberOfBranchEvents();
 
         if (n_events == 0) {
@@ -349,82 +235,92 @@ void Node::computeNodeBranchExtinctionParams()
             double t1 = getAnc()->getTime();
             double t2 = getTime();
 
-            // Times must be relative to event occurrence time:
+            // Times must be relative to event occurrence time
             t1 -= ancestralEvent->getAbsoluteTime();
             t2 -= ancestralEvent->getAbsoluteTime();
 
-            double zpar = ancestralEvent->getMuShift();
-            double r0 = ancestralEvent->getMuInit();
+            lamRate = integrateExponentialRateFunction
+                (ancestralEvent->getLamInit(), ancestralEvent->getLamShift(),
+                 t1, t2);
+            muRate = integrateExponentialRateFunction
+                (ancestralEvent->getMuInit(), ancestralEvent->getMuShift(),
+                 t1, t2);
 
-            rate = integrateExponentialRateFunction(r0, zpar, t1, t2);
-            rate /= getBrlen();
+            lamRate /= getBrlen();
+            muRate /= getBrlen();
 
         } else {
 
-            double tcheck = 0.0;
-            double t1 = getAnc()->getTime();
-            double t2 = bh->getEventByIndexPosition(0)->getAbsoluteTime();
+            SpExBranchEvent* eventAtKMinus1 = static_cast<SpExBranchEvent*>
+                (bh->getEventByIndexPosition(0));
 
-            tcheck += (t2 - t1);
+            double t1 = getAnc()->getTime();
+            double t2 = eventAtKMinus1->getAbsoluteTime();
 
             // Times must be relative to initial time of event
             t1 -= ancestralEvent->getAbsoluteTime();
             t2 -= ancestralEvent->getAbsoluteTime();
-            double zpar = ancestralEvent->getMuShift();
-            double r0 = ancestralEvent->getMuInit();
 
-            rate = integrateExponentialRateFunction(r0, zpar, t1, t2);
+            lamRate = integrateExponentialRateFunction
+                (ancestralEvent->getLamInit(), ancestralEvent->getLamShift(),
+                 t1, t2);
+            muRate = integrateExponentialRateFunction
+                (ancestralEvent->getMuInit(), ancestralEvent->getMuShift(),
+                 t1, t2);
 
             for (int k = 1; k < n_events; k++) {
                 SpExBranchEvent* eventAtK = static_cast<SpExBranchEvent*>
                     (bh->getEventByIndexPosition(k));
-                SpExBranchEvent* eventAtKMinus1 = static_cast<SpExBranchEvent*>
-                    (bh->getEventByIndexPosition(k - 1));
 
                 t1 = 0.0;
                 t2 = eventAtK->getAbsoluteTime() -
                      eventAtKMinus1->getAbsoluteTime();
-                zpar = eventAtKMinus1->getMuShift();
-                r0 = eventAtKMinus1->getMuInit();
 
-                rate += integrateExponentialRateFunction(r0, zpar, t1, t2);
+                lamRate += integrateExponentialRateFunction
+                    (eventAtKMinus1->getLamInit(),
+                     eventAtKMinus1->getLamShift(), t1, t2);
+                muRate += integrateExponentialRateFunction
+                    (eventAtKMinus1->getMuInit(),
+                     eventAtKMinus1->getMuShift(), t1, t2);
 
-                tcheck += (t2 - t1);
+                eventAtKMinus1 = eventAtK;
             }
 
             t1 = 0.0;
-            t2 = getTime() -
-                bh->getEventByIndexPosition((n_events - 1))->getAbsoluteTime();
+            t2 = getTime() - eventAtKMinus1->getAbsoluteTime();
 
             SpExBranchEvent* event = static_cast<SpExBranchEvent*>
                 (bh->getNodeEvent());
 
-            zpar = event->getMuShift();
-            r0 = event->getMuInit();
+            lamRate += integrateExponentialRateFunction
+                (event->getLamInit(), event->getLamShift(), t1, t2);
+            muRate += integrateExponentialRateFunction
+                (event->getMuInit(), event->getMuShift(), t1, t2);
 
-            rate += integrateExponentialRateFunction(r0, zpar, t1, t2);
-
-            tcheck += (t2 - t1);
-
-            // The overall mean rate across the branch:
-            rate /= (getBrlen());
+            // The overall mean rates across the branch:
+            lamRate /= getBrlen();
+            muRate /= getBrlen();
         }
 
-        setMeanExtinctionRate(rate); // extinction rate for branch set
+        state.meanSpeciationRate = lamRate;
+        state.meanExtinctionRate = muRate;
 
     } else {
         // Node is root
-        setMeanExtinctionRate(0.0);
+        state.meanSpeciationRate = 0.0;
+        state.meanExtinctionRate = 0.0;
     }
 
-    // Compute extinction rate at the focal node:
+    // Compute speciation and extinction rates at the focal node
     SpExBranchEvent* event = static_cast<SpExBranchEvent*>(bh->getNodeEvent());
     double reltime = getTime() - event->getAbsoluteTime();
-    double r_init = event->getMuInit();
-    double r_shift = event->getMuShift();
-    double curMu = getExponentialRate(r_init, r_shift, reltime);
 
-    setNodeMu(curMu); // extinction rate for node set
+#ifndef DEBUG_TIME_VARIABLE
+    state.nodeLambda = getExponentialRate
+        (event->getLamInit(), event->getLamShift(), reltime);
+#endif
+    state.nodeMu = getExponentialRate
+        (event->getMuInit(), event->getMuShift(), reltime);
 }
 
 
@@ -434,9 +330,8 @@ void Node::computeNodeBranchExtinctionParams()
 
 
  */
-double Node::getPointExtinction(double branchtime)
+double Node::getPointExtinction(BranchHistory* bh, double branchtime)
 {
-    BranchHistory* bh = getBranchHistory();
     double abstime = getTime() + getBrlen() - branchtime;
     double reltime = 0.0;
     double curMu = 0.0;
@@ -479,8 +374,8 @@ double Node::getPointExtinction(double branchtime)
 }
 
 // These should be relative times.
-double Node::computeSpeciationRateIntervalRelativeTime(double tstart,
-        double tstop)
+double Node::computeSpeciationRateIntervalRelativeTime(BranchHistory* bh,
+        double tstart, double tstop)
 {
     // For FOSSIL process, do not check if tstop > getBrlen()
     //if ((tstart >= tstop) | (tstart < 0) | (tstop > getBrlen()) ) {
@@ -491,7 +386,6 @@ double Node::computeSpeciationRateIntervalRelativeTime(double tstart,
              << std::endl;
         throw;
     }
-    BranchHistory* bh = getBranchHistory();
 
     double rate = 0.0;
 
@@ -579,8 +473,8 @@ double Node::computeSpeciationRateIntervalRelativeTime(double tstart,
     return rate;
 }
 
-double Node::computeSpeciationRateIntervalRelativeTime(double t_init, double tstart,
-                                                       double tstop)
+double Node::computeSpeciationRateIntervalRelativeTime(BranchHistory* bh,
+        double t_init, double tstart, double tstop)
 {
     // For FOSSIL process, do not check if tstop > getBrlen()
     //if ((tstart >= tstop) | (tstart < 0) | (tstop > getBrlen()) ) {
@@ -590,7 +484,6 @@ double Node::computeSpeciationRateIntervalRelativeTime(double t_init, double tst
         << std::endl;
         throw;
     }
-    BranchHistory* bh = getBranchHistory();
     
     double rate = 0.0;
     
@@ -624,7 +517,8 @@ double Node::computeSpeciationRateIntervalRelativeTime(double t_init, double tst
 
 
 
-double Node::computeExtinctionRateIntervalRelativeTime(double t_init, double tstart, double tstop)
+double Node::computeExtinctionRateIntervalRelativeTime(BranchHistory* bh,
+        double t_init, double tstart, double tstop)
 {
     
     if ((tstart >= tstop) | (tstart < 0) ) {
@@ -633,9 +527,6 @@ double Node::computeExtinctionRateIntervalRelativeTime(double t_init, double tst
         throw;
     }
     
-    
-    BranchHistory* bh = getBranchHistory();
-    
     double rate = 0.0;
     
     t_init += getAnc()->getTime();
@@ -669,8 +560,8 @@ double Node::computeExtinctionRateIntervalRelativeTime(double t_init, double tst
 
 
 
-double Node::computeExtinctionRateIntervalRelativeTime(double tstart,
-        double tstop)
+double Node::computeExtinctionRateIntervalRelativeTime(BranchHistory* bh,
+        double tstart, double tstop)
 {
 
     // For FOSSIL process, do not check if tstop > getBrlen()
@@ -682,9 +573,6 @@ double Node::computeExtinctionRateIntervalRelativeTime(double tstart,
         throw;
     }
 
-
-    BranchHistory* bh = getBranchHistory();
-
     double rate = 0.0;
 
     tstart += getAnc()->getTime();
@@ -18,6 +18,48 @@ class Phenotype;
 class BranchHistory;
 
 
+// Per-node state used only by the speciation-extinction model.
+// Nodes are shared by all chains; each SpExModel keeps one of these
+// per node in a contiguous block, so a chain running the trait model
+// does not pay for them (and vice versa).
+struct SpExNodeState
+{
+    SpExNodeState();
+
+    double meanSpeciationRate;
+    double meanExtinctionRate;
+
+    // Node rates for time-varying models
+    double nodeLambda;
+    double nodeMu;
+
+    double di;   // initial value of speciation probability (at node)
+    double ei;   // initial value of extinction probability (at node)
+    double etip; // initial value (sampling frac.) at tip descended from node
+
+    // Value of extinction probability at end of branch
+    double eEnd;
+
+    // Whether the descendants of a node have a rate shift
+    // somewhere in their history
+    bool hasDownstreamRateShift;
+
+    bool inheritFromLeft;
+};
+
+
+// Per-node state used only by the trait model
+struct TraitNodeState
+{
+    TraitNodeState();
+
+    double trait;        // trait value
+    double meanBeta;     // mean phenotypic rate
+    double nodeBeta;     // exact value at node
+    bool   isTraitFixed; // is trait value a free parameter?
+};
+
+
 class Node
 {
 
@@ -30,9 +72,13 @@ private:
     Node*  _anc;
     std::string _name;
 
-    std::string _cladeName;
-
     int    _index;
+
+    // Position in the tree's pre-order traversal and number of nodes in the
+    // subtree rooted here (including this node): the subtree occupies
+    // [_preOrderIndex, _preOrderIndex + _subtreeSize) in pre-order
+    int    _preOrderIndex;
+    int    _subtreeSize;
     double _time;
     double _brlen;
     double _branchTime;
@@ -47,44 +93,8 @@ private:
     double _mapStart;
     double _mapEnd;
 
-    BranchHistory* _history;
-
-    // For phenotypes:
-    double _trait; // trait value
-    double _meanBeta; // mean phenotypic rate
-    double _nodeBeta; // exact value at node.
-    bool   _isTraitFixed; // is trait value a free parameter?
-
-    //specific stuff for compound poisson rate model
-    double _meanSpeciationRate;
-    double _meanExtinctionRate;
-
-    // Node rates for time-varying models:
-    double _nodeLambda;
-    double _nodeMu;
-
-    double _di;   // initial value of speciation probability (at node)
-    double _ei;   // initial value of extinction probability (at node)
-    double _etip; // initial value (sampling frac.) at tip descended from node
-    
-    // value of log-likelihood at end of branch
-    // (after combining w speciation event):
-    //  Zero if node is terminal.
-    double _nodeLikelihood;
-
     // Flag for whether node can or cannot define branch that can hold event:
     bool _canHoldEvent;
-    
-    // HOlds value of Extinction probability at end of branch
-    double _eEnd;
-    
-    // determines whether the descendants of a node have
-    // a rates shift somewhere in their history
-    
-    bool _hasDownstreamRateShift;
-    
-    bool _inheritFromLeft;
-    
 
 public:
 
@@ -110,6 +120,15 @@ public:
     void setIndex(int x);
     int  getIndex();
 
+    void setPreOrderIndex(int x);
+    int  getPreOrderIndex();
+
+    void setSubtreeSize(int x);
+    int  getSubtreeSize();
+
+    // True if x is this node or one of its descendants
+    bool subtreeContains(Node* x);
+
     void   setTime(double x);
     double getTime();
 
@@ -150,54 +169,19 @@ public:
     void   setMapEnd(double x);
     double getMapEnd();
 
-    //Need to includet this
-    BranchHistory* getBranchHistory();
-
-    void   setMeanSpeciationRate(double x);
-    double getMeanSpeciationRate();
-
-    void   setMeanExtinctionRate(double x);
-    double getMeanExtinctionRate();
-
-    void computeNodeBranchSpeciationParams();
-    void computeNodeBranchExtinctionParams();
-    
-    void computeAndSetNodeSpeciationParams();
-    void computeAndSetNodeExtinctionParams();
-
-    void   setNodeLambda(double x);
-    double getNodeLambda();
-
-    void   setNodeMu(double x);
-    double getNodeMu();
-
-    void   setNodeBeta(double x);
-    double getNodeBeta();
+    // Speciation-extinction calculations. A node is shared by all chains,
+    // so the chain's branch history for this node and the state block
+    // to update are passed in.
 
-    /*********/
+    // Sets the mean speciation and extinction rates on the branch
+    // and the rates at the node
+    void computeNodeBranchSpeciationExtinctionParams
+        (BranchHistory* bh, SpExNodeState& state);
 
-    // Phenotypic stuff:
-    void setTraitValue(double x);
-    double getTraitValue();
-
-    void setMeanBeta(double x);
-    double getMeanBeta();
-
-    void setIsTraitFixed(bool x);
-    bool getIsTraitFixed();
-
-    // Speciation-extinction calculations
-    void   setEinit(double x);
-    double getEinit();
-
-    void   setDinit(double x);
-    double getDinit();
-
-    void   setEtip(double x);
-    double getEtip();
-
-    void setNodeLikelihood(double x);
-    double getNodeLikelihood();
+    void computeAndSetNodeSpeciationParams
+        (BranchHistory* bh, SpExNodeState& state);
+    void computeAndSetNodeExtinctionParams
+        (BranchHistory* bh, SpExNodeState& state);
 
     bool getCanHoldEvent();
     void setCanHoldEvent(bool x);
@@ -205,19 +189,15 @@ public:
     void   setBranchTime(double x);
     double getBranchTime();
 
-    void setCladeName(std::string x);
-    std::string getCladeName();
-
     double computeSpeciationRateIntervalRelativeTime
-        (double tstart, double tstop);
-    double computeSpeciationRateIntervalAbsoluteTime
-        (double tstart, double tstop);
+        (BranchHistory* bh, double tstart, double tstop);
+    double computeExtinctionRateIntervalRelativeTime
+        (BranchHistory* bh, double tstart, double tstop);
+    double computeSpeciationRateIntervalRelativeTime
+        (BranchHistory* bh, double t_init, double tstart, double tstop);
     double computeExtinctionRateIntervalRelativeTime
-        (double tstart, double tstop);
-    double computeSpeciationRateIntervalRelativeTime(double t_init, double tstart, double tstop);
-    double computeSpeciationRateIntervalAbsoluteTime(double t_init, double tstart, double tstop);
-    double computeExtinctionRateIntervalRelativeTime(double t_init, double tstart, double tstop);
-    double getPointExtinction(double branchtime);
+        (BranchHistory* bh, double t_init, double tstart, double tstop);
+    double getPointExtinction(BranchHistory* bh, double branchtime);
     
     double integrateExponentialRateFunction(double par_init, double shift, double t1, double t2);
     double getExponentialRate(double par_init, double shift, double tm);
@@ -226,15 +206,6 @@ public:
     std::string getRandomRightDesc();
     std::string getRandomLeftDesc();
     
-    double getExtinctionEnd(void);
-    void setExtinctionEnd(double x);
-    
-    bool getHasDownstreamRateShift(void);
-    void setHasDownstreamRateShift(bool x);
-    
-    bool getInheritFromLeft(void);
-    void setInheritFromLeft(bool x);
-    
 };
 
 
@@ -286,6 +257,18 @@ inline void Node::setIndex(int x)
 }
 
 
+inline void Node::setPreOrderIndex(int x)
+{
+    _preOrderIndex = x;
+}
+
+
+inline void Node::setSubtreeSize(int x)
+{
+    _subtreeSize = x;
+}
+
+
 inline void Node::setTime(double x)
 {
     _time = x;
@@ -334,6 +317,25 @@ inline int Node::getIndex()
 }
 
 
+inline int Node::getPreOrderIndex()
+{
+    return _preOrderIndex;
+}
+
+
+inline int Node::getSubtreeSize()
+{
+    return _subtreeSize;
+}
+
+
+inline bool Node::subtreeContains(Node* x)
+{
+    return (x->_preOrderIndex >= _preOrderIndex) &&
+        (x->_preOrderIndex < _preOrderIndex + _subtreeSize);
+}
+
+
 inline double Node::getTime()
 {
     return _time;
@@ -424,156 +426,6 @@ inline double Node::getMapEnd()
 }
 
 
-inline BranchHistory* Node::getBranchHistory()
-{
-    return _history;
-}
-
-
-inline void Node::setMeanSpeciationRate(double x)
-{
-    _meanSpeciationRate = x;
-}
-
-
-inline double Node::getMeanSpeciationRate()
-{
-    return _meanSpeciationRate;
-}
-
-
-inline void Node::setMeanExtinctionRate(double x)
-{
-    _meanExtinctionRate = x;
-}
-
-
-inline double Node::getMeanExtinctionRate()
-{
-    return _meanExtinctionRate;
-}
-
-
-inline void Node::setNodeLambda(double x)
-{
-    _nodeLambda = x;
-}
-
-
-inline double Node::getNodeLambda()
-{
-    return _nodeLambda;
-}
-
-
-inline void Node::setNodeMu(double x)
-{
-    _nodeMu = x;
-}
-
-
-inline double Node::getNodeMu()
-{
-    return _nodeMu;
-}
-
-
-inline void Node::setNodeBeta(double x)
-{
-    _nodeBeta = x;
-}
-
-
-inline double Node::getNodeBeta()
-{
-    return _nodeBeta;
-}
-
-
-inline void Node::setTraitValue(double x)
-{
-    _trait = x;
-}
-
-
-inline double Node::getTraitValue()
-{
-    return _trait;
-}
-
-
-inline void Node::setMeanBeta(double x)
-{
-    _meanBeta = x;
-}
-
-
-inline double Node::getMeanBeta()
-{
-    return _meanBeta;
-}
-
-
-inline void Node::setIsTraitFixed(bool x)
-{
-    _isTraitFixed = x;
-}
-
-
-inline bool Node::getIsTraitFixed()
-{
-    return _isTraitFixed;
-}
-
-
-inline void Node::setEinit(double x)
-{
-    _ei = x;
-}
-
-
-inline double Node::getEinit()
-{
-    return _ei;
-}
-
-
-inline void Node::setDinit(double x)
-{
-    _di = x;
-}
-
-
-inline double Node::getDinit()
-{
-    return _di;
-}
-
-
-inline void Node::setEtip(double x)
-{
-    _etip = x;
-}
-
-
-inline double Node::getEtip()
-{
-    return _etip;
-}
-
-
-inline void Node::setNodeLikelihood(double x)
-{
-    _nodeLikelihood = x;
-}
-
-
-inline double Node::getNodeLikelihood()
-{
-    return _nodeLikelihood;
-}
-
-
 inline bool Node::getCanHoldEvent()
 {
     return _canHoldEvent;
@@ -598,48 +450,5 @@ inline double Node::getBranchTime()
 }
 
 
-inline void Node::setCladeName(std::string x)
-{
-    _cladeName = x;
-}
-
-
-inline std::string Node::getCladeName()
-{
-    return _cladeName;
-}
-
-inline void Node::setExtinctionEnd(double x)
-{
-    _eEnd = x;
-}
-
-inline double Node::getExtinctionEnd(void)
-{
-    return _eEnd;
-}
-
-
-inline void Node::setHasDownstreamRateShift(bool x)
-{
-    _hasDownstreamRateShift = x;
-}
-
-inline bool Node::getHasDownstreamRateShift(void)
-{
-    return _hasDownstreamRateShift;
-}
-
-inline bool Node::getInheritFromLeft(void)
-{
-    return _inheritFromLeft;
-}
-
-inline void Node::setInheritFromLeft(bool x)
-{
-    _inheritFromLeft = x;
-}
-
-
 
 #endif
@@ -10,7 +10,9 @@ NodeStateDataWriter::NodeStateDataWriter(Settings& settings) :
     _outputFileName(settings.get("nodeStateOutfile")),
     _outputFreq(settings.get<int>("nodeStateWriteFreq"))
 {
-    if (_outputFreq > 0) {
+    if (_outputFreq > 0 && settings.get<bool>("resume")) {
+        appendToExistingOutput();
+    } else if (_outputFreq > 0) {
         initializeStream();
     }
 }
@@ -36,9 +38,16 @@ void NodeStateDataWriter::writeData(int generation, TraitModel& model)
         return;
     }
 
-    Tree& tree = *model.getTreePtr();
-
     _outputStream << generation;
-    tree.writeBranchPhenotypes(tree.getRoot(), _outputStream);
-    _outputStream << ";\n";
+    model.writeBranchPhenotypes(model.getTreePtr()->getRoot(), _outputStream);
+    _outputStream << ";" << std::endl;
+}
+
+
+void NodeStateDataWriter::appendToExistingOutput()
+{
+    if (_outputFreq > 0) {
+        _outputStream.close();
+        _outputStream.open(_outputFileName.c_str(), std::ios::app);
+    }
 }
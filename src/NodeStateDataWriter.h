@@ -18,6 +18,10 @@ public:
 
     void writeData(int generation, TraitModel& model);
 
+    // Reopens the output file in append mode, so that several processes
+    // can take turns writing to it
+    void appendToExistingOutput();
+
 private:
 
     void initializeStream();
@@ -6,6 +6,7 @@
 #include "Tree.h"
 #include "Node.h"
 #include "Stat.h"
+#include "Checkpoint.h"
 
 #include <cstdlib>
 #include <algorithm>
@@ -16,13 +17,14 @@ NodeStateProposal::NodeStateProposal
         _random(random), _settings(settings),
         _model(static_cast<TraitModel&>(model)), _tree(model.getTreePtr())
 {
-    _weight = _settings.get<double>("updateRateNodeState");
+    readWeight(_settings, "updateRateNodeState");
 
     // Node state scale is relative to the standard deviation
     // of the trait values (located in the tree terminal nodes)
-    double sd_traits = Stat::standard_deviation(_tree->traitValues());
+    double sd_traits = Stat::standard_deviation(_model.traitValues());
     _updateNodeStateScale =
         _settings.get<double>("updateNodeStateScale") * sd_traits;
+    setTunableScale(&_updateNodeStateScale, "updateNodeStateScale", sd_traits);
 
     _priorMin = _settings.get<double>("traitPriorMin");
     _priorMax = _settings.get<double>("traitPriorMax");
@@ -41,8 +43,8 @@ void NodeStateProposal::updateMinMaxTraitPriorSettings()
     const std::vector<Node*>& postOrderNodes = _tree->postOrderNodes();
     for (int i = 0; i < nnodes; i++) {
         Node* xnode = postOrderNodes[i];
-        if (xnode->getTraitValue() != 0) {
-            tvec.push_back(xnode->getTraitValue());
+        if (_model.nodeState(xnode).trait != 0) {
+            tvec.push_back(_model.nodeState(xnode).trait);
         }
     }
 
@@ -62,16 +64,16 @@ void NodeStateProposal::propose()
         _minMaxTraitPriorUpdated = true;
     }
 
-    _node = _tree->chooseInternalNodeAtRandom();
+    _node = _tree->chooseInternalNodeAtRandom(_random);
 
     double currentTriadLogLikelihood =
         _model.computeTriadLikelihoodTraits(_node);
     _currentLogLikelihood = _model.getCurrentLogLikelihood();
-    _currentNodeState = _node->getTraitValue();
+    _currentNodeState = _model.nodeState(_node).trait;
 
     _proposedNodeState = _currentNodeState + _random.uniform
         (-_updateNodeStateScale, _updateNodeStateScale);
-    _node->setTraitValue(_proposedNodeState);
+    _model.nodeState(_node).trait = _proposedNodeState;
 
     double proposedTriadLogLikelihood =
         _model.computeTriadLikelihoodTraits(_node);
@@ -88,7 +90,7 @@ void NodeStateProposal::accept()
 
 void NodeStateProposal::reject()
 {
-    _node->setTraitValue(_currentNodeState);
+    _model.nodeState(_node).trait = _currentNodeState;
 }
 
 
@@ -100,7 +102,7 @@ double NodeStateProposal::acceptanceRatio()
 
     double logLikelihoodRatio = computeLogLikelihoodRatio();
 
-    double t = _model.getTemperatureMH();
+    double t = _model.getTemperatureMH() * _model.getLikelihoodPower();
     double logRatio = t * logLikelihoodRatio;
 
     if (std::isfinite(logRatio)) {
@@ -115,3 +117,22 @@ double NodeStateProposal::computeLogLikelihoodRatio()
 {
     return _proposedLogLikelihood - _currentLogLikelihood;
 }
+
+
+// The trait prior range is set from the node states at the first proposal
+void NodeStateProposal::writeState(std::ostream& out) const
+{
+    Proposal::writeState(out);
+    Checkpoint::write(out, _minMaxTraitPriorUpdated);
+    Checkpoint::write(out, _priorMin);
+    Checkpoint::write(out, _priorMax);
+}
+
+
+void NodeStateProposal::readState(std::istream& in)
+{
+    Proposal::readState(in);
+    Checkpoint::read(in, _minMaxTraitPriorUpdated);
+    Checkpoint::read(in, _priorMin);
+    Checkpoint::read(in, _priorMax);
+}
@@ -24,6 +24,9 @@ public:
 
     virtual double acceptanceRatio();
 
+    virtual void writeState(std::ostream& out) const;
+    virtual void readState(std::istream& in);
+
 private:
 
     void updateMinMaxTraitPriorSettings();
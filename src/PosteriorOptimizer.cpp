@@ -0,0 +1,423 @@
+#include "PosteriorOptimizer.h"
+
+#include "Random.h"
+#include "Settings.h"
+#include "ModelFactory.h"
+#include "Model.h"
+#include "BranchEvent.h"
+#include "EventDataWriter.h"
+#include "Tree.h"
+#include "Node.h"
+#include "BranchHistory.h"
+#include "ChainWorkerPool.h"
+#include "ProcessGroup.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+
+
+namespace
+{
+
+// First step of the coordinate search, on the log scale for positive
+// parameters; the step is halved whenever no coordinate improves
+const double InitialStep = 0.5;
+
+// Smallest step of the search of a new event's parameters on every
+// branch; the best new event is then searched with all other parameters
+const double NewEventTolerance = 0.05;
+
+}
+
+
+PosteriorOptimizer::PosteriorOptimizer
+    (Random& random, Settings& settings, ModelFactory* modelFactory) :
+        _settings(settings), _modelFactory(modelFactory),
+        _random(random.uniformInteger(0, INT_MAX - 1)), _tree(NULL),
+        _workerPool(NULL)
+{
+    _nStarts = _settings.get<int>("optimizeStarts");
+    _nGenerations = _settings.get<int>("optimizeGenerations");
+    _finalTemperature = _settings.get<double>("optimizeFinalTemperature");
+    _tolerance = _settings.get<double>("optimizeTolerance");
+    _printFreq = _settings.get<int>("printFreq");
+
+    if (ProcessGroup::size() > 1) {
+        exitWithError("runMode = optimize is not supported "
+            "when running in several processes");
+    }
+
+    if (_nStarts < 1) {
+        exitWithError("optimizeStarts must be positive");
+    }
+
+    if (_nGenerations < 0) {
+        exitWithError("optimizeGenerations must be 0 or positive");
+    }
+
+    if (_finalTemperature < 1.0) {
+        exitWithError("optimizeFinalTemperature must be at least 1");
+    }
+
+    if (_tolerance <= 0.0) {
+        exitWithError("optimizeTolerance must be > 0");
+    }
+
+    if (_settings.get<bool>("resume")) {
+        log(Warning) << "resume is ignored with runMode = optimize.\n";
+    }
+
+    _tree = new Tree(_settings);
+    _workerPool = new ChainWorkerPool
+        (ChainWorkerPool::numberOfWorkersFor(_settings, _nStarts));
+
+    // Only the first start reports its initial state
+    for (int s = 0; s < _nStarts; s++) {
+        _randoms.push_back(new Random(_random.uniformInteger(0, INT_MAX - 1)));
+
+        Log::instance().setMessagesMuted(s > 0);
+        _models.push_back
+            (_modelFactory->createModel(*_randoms[s], _settings, *_tree));
+        Log::instance().setMessagesMuted(false);
+
+        if (s > 0) {
+            disperseStart(s);
+        }
+
+        _initialNumbersOfEvents.push_back(_models[s]->getNumberOfEvents());
+        _bestLogPosteriors.push_back(_models[s]->logPosterior());
+        _bestStates.push_back(savedState(s));
+    }
+}
+
+
+PosteriorOptimizer::~PosteriorOptimizer()
+{
+    for (int s = 0; s < _nStarts; s++) {
+        delete _models[s];
+        delete _randoms[s];
+    }
+
+    delete _workerPool;
+    delete _tree;
+}
+
+
+// As in the multi-start burn-in of MetropolisCoupledMCMC: between 0 and
+// twice the expected number of events, placed at random. A configuration
+// with an infinite log-likelihood is replaced by the initial one.
+void PosteriorOptimizer::disperseStart(int start)
+{
+    Model& model = *_models[start];
+
+    int maxEvents = (int)std::ceil(2.0 * model.getEventRate());
+    int numberOfEvents = _random.uniformInteger(0, maxEvents);
+
+    std::string initialState = savedState(start);
+    model.setRandomEventConfiguration(numberOfEvents);
+    if (!std::isfinite(model.getCurrentLogLikelihood())) {
+        restoreState(start, initialState);
+    }
+}
+
+
+void PosteriorOptimizer::run()
+{
+    log(Message) << "\nAnnealing " << _nStarts
+        << (_nStarts == 1 ? " chain" : " chains") << " on "
+        << _workerPool->numberOfWorkers()
+        << (_workerPool->numberOfWorkers() == 1 ? " thread" : " threads")
+        << " for " << _nGenerations << " generations, then searching "
+        << "parameters and removing shifts...\n";
+
+    // Each start has its own model and random generator,
+    // so the result does not depend on the number of threads
+    _workerPool->run(_nStarts, [this](int s) {
+        optimize(s);
+    });
+
+    int best = 0;
+    log(Message) << "    Start  Initial shifts  Final shifts  Log-posterior\n";
+    for (int s = 0; s < _nStarts; s++) {
+        std::ostringstream row;
+        row << std::setw(9) << (s + 1)
+            << std::setw(16) << _initialNumbersOfEvents[s]
+            << std::setw(14) << _models[s]->getNumberOfEvents()
+            << std::setw(15) << std::fixed << std::setprecision(2)
+            << _bestLogPosteriors[s];
+        log(Message) << row.str() << "\n";
+
+        if (_bestLogPosteriors[s] > _bestLogPosteriors[best]) {
+            best = s;
+        }
+    }
+
+    log(Message) << "Best log posterior: " << _bestLogPosteriors[best]
+        << " (start " << best + 1 << ", log-likelihood "
+        << _models[best]->getCurrentLogLikelihood() << ", "
+        << _models[best]->getNumberOfEvents() << " shifts)\n";
+
+    writeBestConfiguration(best);
+}
+
+
+// After annealing, events are removed and added greedily, one at a time,
+// while that improves the posterior
+void PosteriorOptimizer::optimize(int start)
+{
+    anneal(start);
+    searchParameters(start);
+
+    while (true) {
+        while (removeEvents(start)) {
+            searchParameters(start);
+        }
+
+        if (!addEvent(start)) {
+            break;
+        }
+        searchParameters(start);
+    }
+}
+
+
+// Each generation is that of an MCMC chain at the annealing temperature,
+// so that the number of events changes with the proposal densities of
+// the MCMC. Only the first start reports its progress.
+void PosteriorOptimizer::anneal(int start)
+{
+    Model& model = *_models[start];
+
+    for (int generation = 0; generation < _nGenerations; generation++) {
+        model.setTemperatureMH(annealingTemperature(generation));
+        model.proposeNewState();
+
+        double acceptanceRatio = model.acceptanceRatio();
+        if (_randoms[start]->trueWithProbability(acceptanceRatio)) {
+            model.acceptProposal();
+        } else {
+            model.rejectProposal();
+        }
+
+        double logPosterior = model.logPosterior();
+        if (logPosterior > _bestLogPosteriors[start]) {
+            _bestLogPosteriors[start] = logPosterior;
+            _bestStates[start] = savedState(start);
+        }
+
+        if (start == 0 && _printFreq > 0 &&
+                (generation + 1) % _printFreq == 0) {
+            log(Message) << "Generation " << generation + 1
+                << ": temperature " << model.getTemperatureMH()
+                << ", log posterior " << logPosterior
+                << ", best " << _bestLogPosteriors[start] << "\n";
+        }
+    }
+
+    restoreState(start, _bestStates[start]);
+    model.setTemperatureMH(1.0);
+}
+
+
+double PosteriorOptimizer::annealingTemperature(int generation) const
+{
+    if (_nGenerations <= 1) {
+        return _finalTemperature;
+    }
+
+    double fraction = (double)generation / (_nGenerations - 1);
+    return std::pow(_finalTemperature, fraction);
+}
+
+
+std::string PosteriorOptimizer::savedState(int start) const
+{
+    std::ostringstream out;
+    _models[start]->writeSampledState(out);
+    return out.str();
+}
+
+
+void PosteriorOptimizer::restoreState(int start, const std::string& state)
+{
+    std::istringstream in(state);
+    _models[start]->readSampledState(in);
+}
+
+
+// Steps along one coordinate at a time until no step of the current size
+// improves the posterior, then halves the step
+void PosteriorOptimizer::searchParameters(int start)
+{
+    double step = InitialStep;
+    while (step >= _tolerance) {
+        bool improved =
+            improveParameters(start, NULL, step, _bestLogPosteriors[start]);
+
+        // Changing parameters does not reorder the events
+        EventSet& events = _models[start]->events();
+        EventSet::iterator it;
+        for (it = events.begin(); it != events.end(); ++it) {
+            if (improveParameters
+                    (start, *it, step, _bestLogPosteriors[start])) {
+                improved = true;
+            }
+        }
+
+        if (!improved) {
+            step /= 2.0;
+        }
+    }
+}
+
+
+// The global parameters are searched when event is NULL; logPosterior is
+// that of the current state, and is updated with it. Held parameters
+// (e.g., those whose update rate is 0) keep the values they have.
+bool PosteriorOptimizer::improveParameters
+    (int start, BranchEvent* event, double step, double& logPosterior)
+{
+    Model& model = *_models[start];
+
+    std::vector<double> values = (event == NULL) ?
+        model.globalParameters() : model.eventParameters(event);
+    std::vector<bool> isHeld = (event == NULL) ?
+        model.heldGlobalParameters() : model.heldEventParameters(event);
+
+    bool improved = false;
+    for (int i = 0; i < (int)values.size(); i++) {
+        if (isHeld[i]) {
+            continue;
+        }
+
+        for (int direction = -1; direction <= 1; direction += 2) {
+            std::vector<double> trialValues(values);
+            trialValues[i] += direction * step;
+            setParameters(start, event, trialValues);
+
+            double trialLogPosterior = model.logPosterior();
+            if (trialLogPosterior > logPosterior) {
+                logPosterior = trialLogPosterior;
+                values = trialValues;
+                improved = true;
+                break;
+            }
+
+            setParameters(start, event, values);
+        }
+    }
+
+    return improved;
+}
+
+
+void PosteriorOptimizer::setParameters
+    (int start, BranchEvent* event, const std::vector<double>& values)
+{
+    if (event == NULL) {
+        _models[start]->setGlobalParameters(values);
+    } else {
+        _models[start]->setEventParameters(event, values);
+    }
+}
+
+
+// Tries to remove every event in turn, keeping removals that improve
+// the posterior; returns whether any event was removed
+bool PosteriorOptimizer::removeEvents(int start)
+{
+    Model& model = *_models[start];
+    _bestStates[start] = savedState(start);
+
+    bool removed = false;
+    int i = 0;
+    while (i < model.getNumberOfEvents()) {
+        EventSet::iterator it = model.events().begin();
+        std::advance(it, i);
+
+        BranchEvent* event = model.removeEventFromTree(*it);
+        delete event;
+        model.setCurrentLogLikelihood(model.computeLogLikelihood());
+
+        double logPosterior = model.logPosterior();
+        if (logPosterior > _bestLogPosteriors[start]) {
+            _bestLogPosteriors[start] = logPosterior;
+            _bestStates[start] = savedState(start);
+            removed = true;
+        } else {
+            restoreState(start, _bestStates[start]);
+            i++;
+        }
+    }
+
+    return removed;
+}
+
+
+// Tries a new event in the middle of every branch that has no event yet,
+// starting from the parameters of the event it takes the branch from, and
+// keeps the best one if it improves the posterior; returns whether an
+// event was added
+bool PosteriorOptimizer::addEvent(int start)
+{
+    Model& model = *_models[start];
+    std::string currentState = savedState(start);
+
+    double bestLogPosterior = _bestLogPosteriors[start];
+    std::string bestState;
+
+    const std::vector<Node*>& nodes = _tree->preOrderNodes();
+    for (int n = 0; n < (int)nodes.size(); n++) {
+        Node* node = nodes[n];
+        if (node == _tree->getRoot() || !node->getCanHoldEvent() ||
+                model.getBranchHistory(node)->getNumberOfBranchEvents() > 0) {
+            continue;
+        }
+
+        double mapTime = (node->getMapStart() + node->getMapEnd()) / 2.0;
+        BranchEvent* event = model.addRandomEventToTree(mapTime);
+        BranchEvent* previousEvent =
+            model.getBranchHistory(node)->getLastEvent(event);
+        model.copyEventParameters(event, previousEvent);
+
+        double logPosterior = model.logPosterior();
+        double step = InitialStep;
+        while (step >= NewEventTolerance) {
+            if (!improveParameters(start, event, step, logPosterior)) {
+                step /= 2.0;
+            }
+        }
+
+        if (logPosterior > bestLogPosterior) {
+            bestLogPosterior = logPosterior;
+            bestState = savedState(start);
+        }
+
+        restoreState(start, currentState);
+    }
+
+    if (bestState.empty()) {
+        return false;
+    }
+
+    restoreState(start, bestState);
+    _bestLogPosteriors[start] = bestLogPosterior;
+    return true;
+}
+
+
+void PosteriorOptimizer::writeBestConfiguration(int start) const
+{
+    const std::string& fileName = _settings.get("eventDataOutfile");
+
+    EventDataWriter* writer = _modelFactory->createEventDataWriter(fileName);
+    writer->writeData(_nGenerations, *_models[start]);
+    delete writer;
+
+    log(Message) << "Best configuration written to <<" << fileName << ">>\n";
+}
@@ -0,0 +1,89 @@
+#ifndef POSTERIOR_OPTIMIZER_H
+#define POSTERIOR_OPTIMIZER_H
+
+
+#include "Random.h"
+#include <vector>
+#include <string>
+
+class Settings;
+class ModelFactory;
+class Model;
+class BranchEvent;
+class Tree;
+class ChainWorkerPool;
+
+
+// Searches for the maximum-a-posteriori configuration of events
+// (runMode = optimize; see Model::logPosterior). Each of optimizeStarts
+// independent chains is annealed for optimizeGenerations generations: its
+// posterior is raised to a power (the chain's temperature) that grows
+// geometrically from 1 to optimizeFinalTemperature, and the best state
+// visited is kept. The first chain starts from the initial state, the
+// others from random configurations of events, as in the multi-start
+// burn-in of MetropolisCoupledMCMC. From each best state, the parameters
+// are improved by coordinate search, events are removed one at a time
+// while that improves the posterior, and the event that improves it most
+// is added in the middle of a branch, until neither improves it. The
+// chains run in parallel on up to numberOfThreads threads. The best result
+// of all chains is written to eventDataOutfile as a single generation,
+// which loadEventData can read to start an MCMC run.
+
+class PosteriorOptimizer
+{
+public:
+
+    PosteriorOptimizer
+        (Random& random, Settings& settings, ModelFactory* modelFactory);
+    ~PosteriorOptimizer();
+
+    void run();
+
+private:
+
+    void disperseStart(int start);
+
+    void optimize(int start);
+    void anneal(int start);
+    double annealingTemperature(int generation) const;
+    std::string savedState(int start) const;
+    void restoreState(int start, const std::string& state);
+
+    void searchParameters(int start);
+    bool improveParameters(int start, BranchEvent* event, double step,
+        double& logPosterior);
+    void setParameters(int start, BranchEvent* event,
+        const std::vector<double>& values);
+    bool removeEvents(int start);
+    bool addEvent(int start);
+
+    void writeBestConfiguration(int start) const;
+
+    Settings& _settings;
+    ModelFactory* _modelFactory;
+
+    // The optimizer has its own random generator, using the seeder
+    // (another random generator) to seed it, as does MCMC; it seeds
+    // the random generator of each start in turn
+    Random _random;
+
+    Tree* _tree;
+    ChainWorkerPool* _workerPool;
+
+    // Each start has its own model and random generator,
+    // and keeps its best state and log posterior
+    std::vector<Random*> _randoms;
+    std::vector<Model*> _models;
+    std::vector<int> _initialNumbersOfEvents;
+    std::vector<double> _bestLogPosteriors;
+    std::vector<std::string> _bestStates;
+
+    int _nStarts;
+    int _nGenerations;
+    double _finalTemperature;
+    double _tolerance;
+    int _printFreq;
+};
+
+
+#endif
@@ -10,8 +10,9 @@ PreservationRateProposal::PreservationRateProposal
     (Random& random, Settings& settings, Model& model, Prior& prior) :
         _random(random), _settings(settings), _model(model), _prior(prior)
 {
-    _weight = settings.get<double>("updateRatePreservationRate");
+    readWeight(settings, "updateRatePreservationRate");
     _updatePreservationRateScale = settings.get<double>("updatePreservationRateScale");
+    setTunableScale(&_updatePreservationRateScale, "updatePreservationRateScale");
     
 }
 
@@ -65,7 +66,9 @@ double PreservationRateProposal::acceptanceRatio()
     double logQratio = computeLogQRatio();
     
     double t = _model.getTemperatureMH();
-    double logRatio = t * (logLikelihoodRatio + logPriorRatio) + logQratio;
+    double power = _model.getLikelihoodPower();
+    double logRatio =
+        t * (power * logLikelihoodRatio + logPriorRatio) + logQratio;
     
     if (std::isfinite(logRatio)) {
         return std::min(1.0, std::exp(logRatio));
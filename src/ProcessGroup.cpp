@@ -0,0 +1,62 @@
+#include "ProcessGroup.h"
+
+#ifdef BAMM_MPI
+#include <mpi.h>
+#endif
+
+
+int ProcessGroup::_rank = 0;
+int ProcessGroup::_size = 1;
+
+
+void ProcessGroup::initialize(int* argc, char*** argv)
+{
+#ifdef BAMM_MPI
+    // Chains within a process still run on several threads, but only the
+    // main thread makes MPI calls
+    int provided;
+    MPI_Init_thread(argc, argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &_size);
+#else
+    (void)argc;
+    (void)argv;
+#endif
+}
+
+
+void ProcessGroup::finalize()
+{
+#ifdef BAMM_MPI
+    MPI_Finalize();
+#endif
+}
+
+
+void ProcessGroup::barrier()
+{
+#ifdef BAMM_MPI
+    MPI_Barrier(MPI_COMM_WORLD);
+#endif
+}
+
+
+void ProcessGroup::broadcast(int& value)
+{
+#ifdef BAMM_MPI
+    MPI_Bcast(&value, 1, MPI_INT, 0, MPI_COMM_WORLD);
+#else
+    (void)value;
+#endif
+}
+
+
+void ProcessGroup::sum(std::vector<double>& values)
+{
+#ifdef BAMM_MPI
+    MPI_Allreduce(MPI_IN_PLACE, values.data(), (int)values.size(),
+        MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+#else
+    (void)values;
+#endif
+}
@@ -0,0 +1,61 @@
+#ifndef PROCESS_GROUP_H
+#define PROCESS_GROUP_H
+
+
+#include <vector>
+
+
+// The processes that take part in a run. When BAMM is built with MPI
+// (cmake -DBAMM_MPI=ON) and started with mpirun, these are the MPI ranks;
+// otherwise there is a single process and all operations are trivial.
+// This is the only place that makes MPI calls.
+
+class ProcessGroup
+{
+public:
+
+    static void initialize(int* argc, char*** argv);
+    static void finalize();
+
+    static int rank();
+    static int size();
+
+    // The root process (rank 0) writes the files that are not specific
+    // to the cold chain (run info, chain swaps) and prints summaries
+    static bool isRoot();
+
+    static void barrier();
+
+    // Sets value on every process to its value on the root process
+    static void broadcast(int& value);
+
+    // Replaces values on every process with the element-wise sum of
+    // values across all processes
+    static void sum(std::vector<double>& values);
+
+private:
+
+    static int _rank;
+    static int _size;
+};
+
+
+inline int ProcessGroup::rank()
+{
+    return _rank;
+}
+
+
+inline int ProcessGroup::size()
+{
+    return _size;
+}
+
+
+inline bool ProcessGroup::isRoot()
+{
+    return _rank == 0;
+}
+
+
+#endif
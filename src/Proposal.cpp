@@ -1,4 +1,21 @@
 #include "Proposal.h"
+#include "Settings.h"
+#include "Checkpoint.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+
+// Number of proposals between two adjustments of the scale
+static const int ScaleAdaptationBatchSize = 50;
+
+
+Proposal::Proposal() : _weight(0.0), _tunableScale(NULL),
+    _scaleSettingUnit(1.0), _batchProposals(0), _batchAcceptances(0),
+    _batches(0)
+{
+}
 
 
 Proposal::~Proposal()
@@ -10,3 +27,109 @@ double Proposal::weight() const
 {
     return _weight;
 }
+
+
+void Proposal::setWeight(double weight)
+{
+    _weight = weight;
+}
+
+
+const std::string& Proposal::weightSettingName() const
+{
+    return _weightSettingName;
+}
+
+
+void Proposal::readWeight(Settings& settings, const std::string& settingName)
+{
+    _weight = settings.get<double>(settingName);
+    _weightSettingName = settingName;
+}
+
+
+void Proposal::setTunableScale(double* scale, const std::string& settingName,
+    double settingUnit)
+{
+    _tunableScale = scale;
+    _scaleSettingName = settingName;
+    _scaleSettingUnit = settingUnit;
+}
+
+
+bool Proposal::lastProposalUsedScale() const
+{
+    return true;
+}
+
+
+void Proposal::adaptScale(bool accepted, double targetAcceptanceRate)
+{
+    if (_tunableScale == NULL || !lastProposalUsedScale()) {
+        return;
+    }
+
+    _batchProposals++;
+    if (accepted) {
+        _batchAcceptances++;
+    }
+
+    if (_batchProposals < ScaleAdaptationBatchSize) {
+        return;
+    }
+
+    _batches++;
+    double delta = std::min(0.5, 1.0 / std::sqrt((double)_batches));
+    double acceptanceRate = (double)_batchAcceptances / _batchProposals;
+
+    if (acceptanceRate > targetAcceptanceRate) {
+        *_tunableScale *= std::exp(delta);
+    } else {
+        *_tunableScale /= std::exp(delta);
+    }
+
+    _batchProposals = 0;
+    _batchAcceptances = 0;
+}
+
+
+bool Proposal::hasTunableScale() const
+{
+    return _tunableScale != NULL;
+}
+
+
+const std::string& Proposal::scaleSettingName() const
+{
+    return _scaleSettingName;
+}
+
+
+double Proposal::scaleSettingValue() const
+{
+    return *_tunableScale / _scaleSettingUnit;
+}
+
+
+void Proposal::writeState(std::ostream& out) const
+{
+    if (_tunableScale != NULL) {
+        Checkpoint::write(out, *_tunableScale);
+    }
+
+    Checkpoint::write(out, _batchProposals);
+    Checkpoint::write(out, _batchAcceptances);
+    Checkpoint::write(out, _batches);
+}
+
+
+void Proposal::readState(std::istream& in)
+{
+    if (_tunableScale != NULL) {
+        Checkpoint::read(in, *_tunableScale);
+    }
+
+    Checkpoint::read(in, _batchProposals);
+    Checkpoint::read(in, _batchAcceptances);
+    Checkpoint::read(in, _batches);
+}
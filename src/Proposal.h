@@ -2,10 +2,16 @@
 #define PROPOSAL_H
 
 
+#include <iosfwd>
+#include <string>
+
+class Settings;
+
 class Proposal
 {
 public:
 
+    Proposal();
     virtual ~Proposal();
 
     virtual void propose() = 0;
@@ -14,11 +20,56 @@ public:
 
     virtual double acceptanceRatio() = 0;
 
+    // Relative frequency of the proposal, initially from its setting
     double weight() const;
+    void setWeight(double weight);
+    const std::string& weightSettingName() const;
+
+    // Adaptive tuning of the proposal scale (see the "autotune" setting).
+    // After every batch of proposals, the scale is multiplied by
+    // exp(delta) if the batch acceptance rate was above the target and
+    // divided by it otherwise, where delta = min(0.5, 1 / sqrt(batches))
+    // (Roberts and Rosenthal 2009). Proposals without a scale ignore it.
+    virtual void adaptScale(bool accepted, double targetAcceptanceRate);
+
+    bool hasTunableScale() const;
+
+    // Name of the setting for the scale and its current value,
+    // in the units of that setting
+    const std::string& scaleSettingName() const;
+    double scaleSettingValue() const;
+
+    // State kept by the proposal from one generation to the next,
+    // saved in checkpoints (the scale tuning state by default)
+    virtual void writeState(std::ostream& out) const;
+    virtual void readState(std::istream& in);
 
 protected:
 
+    void readWeight(Settings& settings, const std::string& settingName);
+
+    // Called by proposals with a scale; settingUnit is the value of the
+    // scale when the setting is 1 (it may be relative to the data)
+    void setTunableScale(double* scale, const std::string& settingName,
+        double settingUnit = 1.0);
+
+    // Whether the last proposal depended on the scale
+    // (e.g., not a global move); only those are used for tuning
+    virtual bool lastProposalUsedScale() const;
+
     double _weight;
+
+private:
+
+    std::string _weightSettingName;
+
+    double* _tunableScale;
+    std::string _scaleSettingName;
+    double _scaleSettingUnit;
+
+    int _batchProposals;
+    int _batchAcceptances;
+    int _batches;
 };
 
 
@@ -0,0 +1,159 @@
+#include "ProposalProfileDataWriter.h"
+#include "Settings.h"
+#include "Model.h"
+#include "Proposal.h"
+#include "Log.h"
+#include "ProcessGroup.h"
+
+#include <iomanip>
+#include <sstream>
+
+
+// Proposal names are their weight settings without this prefix
+static const std::string WeightSettingPrefix = "updateRate";
+
+
+ProposalProfileDataWriter::ProposalProfileDataWriter(Settings& settings) :
+    _shouldWriteFile(settings.get<bool>("outputProposalProfile") &&
+        ProcessGroup::isRoot()),
+    _outputFileName(settings.get("proposalProfileFileName"))
+{
+    if (_shouldWriteFile) {
+        if (settings.get<bool>("resume")) {
+            appendToExistingOutput();
+        } else {
+            initializeStream();
+            writeHeader();
+        }
+    }
+}
+
+
+void ProposalProfileDataWriter::initializeStream()
+{
+    _outputStream.open(_outputFileName.c_str());
+}
+
+
+void ProposalProfileDataWriter::appendToExistingOutput()
+{
+    _outputStream.open(_outputFileName.c_str(), std::ios::app);
+}
+
+
+void ProposalProfileDataWriter::writeHeader()
+{
+    _outputStream << header() << std::endl;
+}
+
+
+std::string ProposalProfileDataWriter::header() const
+{
+    return "generation,chain,temperature,proposal,proposals,acceptances,"
+           "likelihoodEvaluations,proposeTime,acceptanceRatioTime,"
+           "acceptTime,rejectTime";
+}
+
+
+ProposalProfileDataWriter::~ProposalProfileDataWriter()
+{
+    if (_shouldWriteFile) {
+        _outputStream.close();
+    }
+}
+
+
+void ProposalProfileDataWriter::writeData(int generation, int chain,
+    double temperature, Model& model)
+{
+    if (!_shouldWriteFile) {
+        return;
+    }
+
+    const std::vector<Proposal*>& proposals = model.proposals();
+    if (_proposalNames.empty()) {
+        for (int i = 0; i < (int)proposals.size(); i++) {
+            std::string name = proposals[i]->weightSettingName();
+            if (name.compare(0, WeightSettingPrefix.size(),
+                    WeightSettingPrefix) == 0) {
+                name = name.substr(WeightSettingPrefix.size());
+            }
+            _proposalNames.push_back(name);
+        }
+        _totals.resize(proposals.size());
+    }
+
+    ProposalProfiler& profiler = model.profiler();
+    const std::vector<ProposalProfiler::Counts>& window = profiler.window();
+
+    for (int i = 0; i < (int)window.size(); i++) {
+        const ProposalProfiler::Counts& counts = window[i];
+        if (counts.proposals == 0) {
+            continue;
+        }
+
+        _outputStream << generation                   << ","
+                      << chain + 1                    << ","
+                      << temperature                  << ","
+                      << _proposalNames[i]            << ","
+                      << counts.proposals             << ","
+                      << counts.acceptances           << ","
+                      << counts.likelihoodEvaluations;
+        for (int p = 0; p < ProposalProfiler::NumberOfPhases; p++) {
+            _outputStream << "," << counts.seconds[p];
+        }
+        _outputStream << std::endl;
+
+        _totals[i].add(counts);
+    }
+
+    profiler.clearWindow();
+}
+
+
+void ProposalProfileDataWriter::logSummary() const
+{
+    if (!_shouldWriteFile || _totals.empty()) {
+        return;
+    }
+
+    double totalSeconds = 0.0;
+    for (int i = 0; i < (int)_totals.size(); i++) {
+        totalSeconds += _totals[i].totalSeconds();
+    }
+
+    std::ostringstream header;
+    header << std::left << std::setw(22) << "Proposal"
+           << std::right << std::setw(12) << "Proposals"
+           << std::setw(10) << "Acc. rate"
+           << std::setw(12) << "Lik./prop."
+           << std::setw(12) << "Time (s)"
+           << std::setw(9) << "% time"
+           << std::setw(12) << "us/prop.";
+
+    log() << "\nProposal profile (all chains):\n";
+    log() << "    " << header.str() << "\n";
+
+    for (int i = 0; i < (int)_totals.size(); i++) {
+        const ProposalProfiler::Counts& counts = _totals[i];
+        if (counts.proposals == 0) {
+            continue;
+        }
+
+        double seconds = counts.totalSeconds();
+
+        std::ostringstream row;
+        row << std::fixed << std::setprecision(3)
+            << std::left << std::setw(22) << _proposalNames[i]
+            << std::right << std::setw(12) << counts.proposals
+            << std::setw(10)
+            << (double)counts.acceptances / counts.proposals
+            << std::setw(12)
+            << (double)counts.likelihoodEvaluations / counts.proposals
+            << std::setw(12) << seconds
+            << std::setprecision(1) << std::setw(9)
+            << (totalSeconds > 0.0 ? 100.0 * seconds / totalSeconds : 0.0)
+            << std::setw(12) << 1e6 * seconds / counts.proposals;
+        log() << "    " << row.str() << "\n";
+    }
+}
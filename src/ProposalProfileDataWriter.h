@@ -0,0 +1,48 @@
+#ifndef PROPOSAL_PROFILE_DATA_WRITER_H
+#define PROPOSAL_PROFILE_DATA_WRITER_H
+
+
+#include "ProposalProfiler.h"
+#include <vector>
+#include <string>
+#include <fstream>
+
+class Settings;
+class Model;
+
+
+// Writes the proposal profiles of the chains (see ProposalProfiler), one
+// line per chain and proposal for each window, and logs a summary of all
+// windows and chains at the end of the run
+class ProposalProfileDataWriter
+{
+public:
+
+    ProposalProfileDataWriter(Settings& settings);
+    ~ProposalProfileDataWriter();
+
+    // Writes and clears the current window of the chain's profiler
+    void writeData(int generation, int chain, double temperature,
+        Model& model);
+
+    void logSummary() const;
+
+private:
+
+    void initializeStream();
+    void appendToExistingOutput();
+    void writeHeader();
+    std::string header() const;
+
+    bool _shouldWriteFile;
+
+    std::string _outputFileName;
+    std::ofstream _outputStream;
+
+    // Counts of all windows and chains, indexed by proposal
+    std::vector<std::string> _proposalNames;
+    std::vector<ProposalProfiler::Counts> _totals;
+};
+
+
+#endif
@@ -0,0 +1,80 @@
+#include "ProposalProfiler.h"
+
+
+ProposalProfiler::Counts::Counts() :
+    proposals(0), acceptances(0), likelihoodEvaluations(0)
+{
+    for (int i = 0; i < NumberOfPhases; i++) {
+        seconds[i] = 0.0;
+    }
+}
+
+
+void ProposalProfiler::Counts::add(const Counts& counts)
+{
+    proposals += counts.proposals;
+    acceptances += counts.acceptances;
+    likelihoodEvaluations += counts.likelihoodEvaluations;
+
+    for (int i = 0; i < NumberOfPhases; i++) {
+        seconds[i] += counts.seconds[i];
+    }
+}
+
+
+double ProposalProfiler::Counts::totalSeconds() const
+{
+    double total = 0.0;
+    for (int i = 0; i < NumberOfPhases; i++) {
+        total += seconds[i];
+    }
+    return total;
+}
+
+
+ProposalProfiler::ProposalProfiler(bool enabled) : _enabled(enabled)
+{
+}
+
+
+void ProposalProfiler::startPhase()
+{
+    _phaseStartTime = std::chrono::steady_clock::now();
+}
+
+
+void ProposalProfiler::endPhase(int proposal, Phase phase)
+{
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - _phaseStartTime;
+
+    Counts& counts = countsOf(proposal);
+    counts.seconds[phase] += elapsed.count();
+
+    if (phase == Propose) {
+        counts.proposals++;
+    } else if (phase == Accept) {
+        counts.acceptances++;
+    }
+}
+
+
+void ProposalProfiler::addLikelihoodEvaluations(int proposal, int evaluations)
+{
+    countsOf(proposal).likelihoodEvaluations += evaluations;
+}
+
+
+void ProposalProfiler::clearWindow()
+{
+    _window.assign(_window.size(), Counts());
+}
+
+
+ProposalProfiler::Counts& ProposalProfiler::countsOf(int proposal)
+{
+    if (proposal >= (int)_window.size()) {
+        _window.resize(proposal + 1);
+    }
+    return _window[proposal];
+}
@@ -0,0 +1,70 @@
+#ifndef PROPOSAL_PROFILER_H
+#define PROPOSAL_PROFILER_H
+
+
+#include <vector>
+#include <chrono>
+
+
+// Counts, for each proposal of a chain, how often it was made and
+// accepted, how many full likelihood evaluations it needed, and the
+// wall-clock time spent in each phase of a generation. The counts are
+// collected in windows that are read and cleared by the caller
+// (see ProposalProfileDataWriter). Disabled unless outputProposalProfile
+// is set, in which case it does nothing.
+
+class ProposalProfiler
+{
+public:
+
+    enum Phase { Propose, AcceptanceRatio, Accept, Reject, NumberOfPhases };
+
+    struct Counts
+    {
+        Counts();
+        void add(const Counts& counts);
+        double totalSeconds() const;
+
+        int proposals;
+        int acceptances;
+        long likelihoodEvaluations;
+        double seconds[NumberOfPhases];
+    };
+
+    ProposalProfiler(bool enabled);
+
+    bool isEnabled() const;
+
+    void startPhase();
+    void endPhase(int proposal, Phase phase);
+
+    void addLikelihoodEvaluations(int proposal, int evaluations);
+
+    // Counts since the window was last cleared, indexed by proposal
+    const std::vector<Counts>& window() const;
+    void clearWindow();
+
+private:
+
+    Counts& countsOf(int proposal);
+
+    bool _enabled;
+    std::chrono::steady_clock::time_point _phaseStartTime;
+    std::vector<Counts> _window;
+};
+
+
+inline bool ProposalProfiler::isEnabled() const
+{
+    return _enabled;
+}
+
+
+inline const std::vector<ProposalProfiler::Counts>&
+    ProposalProfiler::window() const
+{
+    return _window;
+}
+
+
+#endif
@@ -1,4 +1,5 @@
 #include "Random.h"
+#include "Checkpoint.h"
 
 
 // For the default constructor, initialize the MbRandom object first
@@ -24,6 +25,15 @@ void Random::warmUp()
 }
 
 
+// Restarts the stream from the seed, as a new Random(seed) would
+void Random::setSeed(unsigned long int seed)
+{
+    _rng.setState((long int)seed, false, 0.0);
+    _seed = seed;
+    warmUp();
+}
+
+
 unsigned long int Random::getSeed() const
 {
     return _seed;
@@ -65,3 +75,32 @@ bool Random::trueWithProbability(double p)
 {
     return uniform() < p;
 }
+
+
+void Random::writeState(std::ostream& out) const
+{
+    long int seed;
+    bool hasNormal;
+    double normal;
+    _rng.getState(&seed, &hasNormal, &normal);
+
+    Checkpoint::write(out, _seed);
+    Checkpoint::write(out, seed);
+    Checkpoint::write(out, hasNormal);
+    Checkpoint::write(out, normal);
+}
+
+
+void Random::readState(std::istream& in)
+{
+    long int seed;
+    bool hasNormal;
+    double normal;
+
+    Checkpoint::read(in, _seed);
+    Checkpoint::read(in, seed);
+    Checkpoint::read(in, hasNormal);
+    Checkpoint::read(in, normal);
+
+    _rng.setState(seed, hasNormal, normal);
+}
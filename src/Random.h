@@ -3,6 +3,7 @@
 
 
 #include "MbRandom.h"
+#include <iosfwd>
 
 
 class Random
@@ -25,6 +26,11 @@ public:
 
     bool trueWithProbability(double p);
 
+    // Saves and restores the position in the random number stream
+    // (see Checkpoint)
+    void writeState(std::ostream& out) const;
+    void readState(std::istream& in);
+
 private:
 
     void warmUp();
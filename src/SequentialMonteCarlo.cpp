@@ -0,0 +1,374 @@
+#include "SequentialMonteCarlo.h"
+
+#include "Random.h"
+#include "Settings.h"
+#include "ModelFactory.h"
+#include "MCMC.h"
+#include "Model.h"
+#include "ModelDataWriter.h"
+#include "Tree.h"
+#include "ChainWorkerPool.h"
+#include "ProcessGroup.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <string>
+
+
+namespace
+{
+
+// Number of bisection steps to find the next power of the likelihood
+const int BisectionSteps = 50;
+
+}
+
+
+SequentialMonteCarlo::SequentialMonteCarlo
+    (Random& random, Settings& settings, ModelFactory* modelFactory) :
+        _random(random), _settings(settings), _modelFactory(modelFactory),
+        _tree(NULL), _workerPool(NULL)
+{
+    _nParticles = _settings.get<int>("smcParticles");
+    _priorGenerations = _settings.get<int>("smcPriorGenerations");
+    _moveGenerations = _settings.get<int>("smcMoveGenerations");
+    _eventNumberChanges = _settings.get<double>("smcEventNumberChanges");
+    _maxMoveGenerations = _settings.get<int>("smcMaxMoveGenerations");
+    _targetConditionalESS = _settings.get<double>("smcTargetConditionalESS");
+    _resampleThreshold = _settings.get<double>("smcResampleThreshold");
+
+    if (ProcessGroup::size() > 1) {
+        exitWithError("runMode = smc is not supported "
+            "when running in several processes");
+    }
+
+    if (_nParticles < 2) {
+        exitWithError("smcParticles must be at least 2");
+    }
+
+    if (_priorGenerations < 0 || _moveGenerations < 1) {
+        exitWithError("smcPriorGenerations must be 0 or positive "
+            "and smcMoveGenerations must be positive");
+    }
+
+    if (_eventNumberChanges < 0.0 || _maxMoveGenerations < _moveGenerations) {
+        exitWithError("smcEventNumberChanges must be 0 or positive "
+            "and smcMaxMoveGenerations at least smcMoveGenerations");
+    }
+
+    // Without moves that add or remove events, the number of events
+    // cannot change
+    if (_settings.get<double>("updateRateEventNumber") == 0.0 &&
+            _settings.get<double>("updateRateEventNumberForBranch") == 0.0) {
+        _eventNumberChanges = 0.0;
+    }
+
+    if (_targetConditionalESS <= 0.0 || _targetConditionalESS >= 1.0) {
+        exitWithError("smcTargetConditionalESS must be between 0 and 1");
+    }
+
+    if (_resampleThreshold < 0.0 || _resampleThreshold > 1.0) {
+        exitWithError("smcResampleThreshold must be between 0 and 1");
+    }
+
+    if (_settings.get<bool>("resume")) {
+        log(Warning) << "resume is ignored with runMode = smc.\n";
+    }
+
+    _tree = new Tree(_settings);
+    _workerPool = new ChainWorkerPool
+        (ChainWorkerPool::numberOfWorkersFor(_settings, _nParticles));
+
+    // Only the first particle reports its initial state
+    for (int i = 0; i < _nParticles; i++) {
+        Log::instance().setMessagesMuted(i > 0);
+        _particles.push_back
+            (new MCMC(_random, _settings, *_modelFactory, *_tree));
+    }
+    Log::instance().setMessagesMuted(false);
+
+    _weights.assign(_nParticles, 1.0 / _nParticles);
+
+    _likelihoodPower = 0.0;
+    _logMarginalLikelihood = 0.0;
+}
+
+
+SequentialMonteCarlo::~SequentialMonteCarlo()
+{
+    for (int i = 0; i < (int)_particles.size(); i++) {
+        delete _particles[i];
+    }
+
+    delete _workerPool;
+    delete _tree;
+}
+
+
+void SequentialMonteCarlo::run()
+{
+    log(Message) << "\nRunning " << _nParticles << " particles on "
+        << _workerPool->numberOfWorkers() << " thread(s)\n";
+
+    _workerPool->run(_nParticles, [this](int i) {
+        runParticle(i, _priorGenerations);
+    });
+
+    int step = 0;
+    while (_likelihoodPower < 1.0) {
+        double power = nextLikelihoodPower();
+        reweight(power - _likelihoodPower);
+        _likelihoodPower = power;
+        step++;
+
+        double ess = effectiveSampleSize();
+        bool resampled = ess < _resampleThreshold * _nParticles;
+        if (resampled) {
+            resample();
+        }
+
+        int generations = moveParticles();
+
+        log(Message) << "Step " << step << ": likelihood power "
+            << _likelihoodPower << ", ESS " << ess
+            << (resampled ? " (resampled)" : "") << ", "
+            << generations << " generations"
+            << ", log marginal likelihood " << _logMarginalLikelihood
+            << "\n";
+    }
+
+    resample();
+
+    double meanNumberOfEvents = 0.0;
+    for (int i = 0; i < _nParticles; i++) {
+        meanNumberOfEvents += _particles[i]->model().getNumberOfEvents();
+    }
+    meanNumberOfEvents /= _nParticles;
+
+    log(Message) << "Log marginal likelihood: " << _logMarginalLikelihood
+        << " (" << step << " steps)\n";
+    log(Message) << "Mean number of shifts: " << meanNumberOfEvents << "\n";
+
+    writeParticles();
+}
+
+
+// Runs blocks of smcMoveGenerations generations until the particles have
+// changed their number of events smcEventNumberChanges times on average,
+// so that resampled copies of a particle have moved apart (which takes
+// longer as the likelihood sharpens), or until smcMaxMoveGenerations
+// generations have run. The particles are independent, each with its own
+// random generator, and the stopping rule depends only on their states,
+// so the result does not depend on the number of threads. Returns the
+// number of generations run.
+int SequentialMonteCarlo::moveParticles()
+{
+    std::vector<int> changes(_nParticles, 0);
+
+    int generations = 0;
+    while (generations < _maxMoveGenerations) {
+        int blockGenerations =
+            std::min(_moveGenerations, _maxMoveGenerations - generations);
+        _workerPool->run(_nParticles, [&](int i) {
+            changes[i] += runParticle(i, blockGenerations);
+        });
+        generations += blockGenerations;
+
+        double meanChanges = 0.0;
+        for (int i = 0; i < _nParticles; i++) {
+            meanChanges += changes[i];
+        }
+        meanChanges /= _nParticles;
+
+        if (meanChanges >= _eventNumberChanges) {
+            break;
+        }
+    }
+
+    return generations;
+}
+
+
+// Returns the number of times the particle's number of events changed
+int SequentialMonteCarlo::runParticle(int i, int generations)
+{
+    Model& model = _particles[i]->model();
+    model.setLikelihoodPower(_likelihoodPower);
+
+    int changes = 0;
+    int numberOfEvents = model.getNumberOfEvents();
+    for (int g = 0; g < generations; g++) {
+        _particles[i]->step();
+        if (model.getNumberOfEvents() != numberOfEvents) {
+            numberOfEvents = model.getNumberOfEvents();
+            changes++;
+        }
+    }
+
+    return changes;
+}
+
+
+// The conditional effective sample size decreases as the power increases
+double SequentialMonteCarlo::nextLikelihoodPower() const
+{
+    double maxIncrement = 1.0 - _likelihoodPower;
+    if (conditionalEffectiveSampleSize(maxIncrement) >=
+            _targetConditionalESS) {
+        return 1.0;
+    }
+
+    double low = 0.0;
+    double high = maxIncrement;
+    for (int i = 0; i < BisectionSteps; i++) {
+        double middle = (low + high) / 2.0;
+        if (conditionalEffectiveSampleSize(middle) >= _targetConditionalESS) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    return _likelihoodPower + (low > 0.0 ? low : high);
+}
+
+
+// Conditional effective sample size (as a fraction of the number of
+// particles) of the incremental weights for the given increase of the
+// power: (sum W w)^2 / sum W w^2, with w the likelihood raised to
+// the increase and W the current normalized weights
+double SequentialMonteCarlo::conditionalEffectiveSampleSize
+    (double increment) const
+{
+    double maxLogWeight = -std::numeric_limits<double>::infinity();
+    for (int i = 0; i < _nParticles; i++) {
+        if (_weights[i] > 0.0) {
+            maxLogWeight = std::max(maxLogWeight, increment *
+                _particles[i]->model().getCurrentLogLikelihood());
+        }
+    }
+
+    double sum = 0.0;
+    double sumOfSquares = 0.0;
+    for (int i = 0; i < _nParticles; i++) {
+        if (_weights[i] > 0.0) {
+            double w = std::exp(increment *
+                _particles[i]->model().getCurrentLogLikelihood() -
+                maxLogWeight);
+            sum += _weights[i] * w;
+            sumOfSquares += _weights[i] * w * w;
+        }
+    }
+
+    return sumOfSquares > 0.0 ? sum * sum / sumOfSquares : 0.0;
+}
+
+
+double SequentialMonteCarlo::effectiveSampleSize() const
+{
+    double sumOfSquares = 0.0;
+    for (int i = 0; i < _nParticles; i++) {
+        sumOfSquares += _weights[i] * _weights[i];
+    }
+
+    return 1.0 / sumOfSquares;
+}
+
+
+// Multiplies the weights by the likelihoods raised to the increase of the
+// power; the marginal likelihood is multiplied by the weighted mean of
+// these factors
+void SequentialMonteCarlo::reweight(double increment)
+{
+    std::vector<double> logFactors(_nParticles);
+    double maxLogFactor = -std::numeric_limits<double>::infinity();
+    for (int i = 0; i < _nParticles; i++) {
+        logFactors[i] =
+            increment * _particles[i]->model().getCurrentLogLikelihood();
+        if (_weights[i] > 0.0) {
+            maxLogFactor = std::max(maxLogFactor, logFactors[i]);
+        }
+    }
+
+    if (!std::isfinite(maxLogFactor)) {
+        exitWithError("All particles have a likelihood of 0");
+    }
+
+    double sum = 0.0;
+    for (int i = 0; i < _nParticles; i++) {
+        if (_weights[i] > 0.0) {
+            _weights[i] *= std::exp(logFactors[i] - maxLogFactor);
+            sum += _weights[i];
+        }
+    }
+
+    for (int i = 0; i < _nParticles; i++) {
+        _weights[i] /= sum;
+    }
+
+    _logMarginalLikelihood += maxLogFactor + std::log(sum);
+}
+
+
+// Systematic resampling: particle i is copied once for every point
+// (u + j) / N, u uniform in [0, 1), that falls in its share of the
+// cumulative weights
+void SequentialMonteCarlo::resample()
+{
+    std::vector<int> sources(_nParticles);
+
+    double u = _random.uniform();
+    double cumulativeWeight = _weights[0];
+    int source = 0;
+    for (int j = 0; j < _nParticles; j++) {
+        double point = (u + j) / _nParticles;
+        while (point > cumulativeWeight && source < _nParticles - 1) {
+            source++;
+            cumulativeWeight += _weights[source];
+        }
+        sources[j] = source;
+    }
+
+    // States are saved before any particle is overwritten
+    std::vector<std::string> states(_nParticles);
+    for (int j = 0; j < _nParticles; j++) {
+        if (states[sources[j]].empty()) {
+            std::ostringstream out;
+            _particles[sources[j]]->model().writeSampledState(out);
+            states[sources[j]] = out.str();
+        }
+    }
+
+    for (int j = 0; j < _nParticles; j++) {
+        if (sources[j] != j) {
+            std::istringstream in(states[sources[j]]);
+            _particles[j]->model().readSampledState(in);
+        }
+    }
+
+    _weights.assign(_nParticles, 1.0 / _nParticles);
+}
+
+
+// Every particle is written as a generation of its own
+void SequentialMonteCarlo::writeParticles()
+{
+    Settings outputSettings(_settings);
+    outputSettings.set("mcmcWriteFreq", "1");
+    outputSettings.set("eventDataWriteFreq", "1");
+    outputSettings.set("printFreq", "0");
+
+    ModelDataWriter* dataWriter =
+        _modelFactory->createModelDataWriter(outputSettings);
+    for (int i = 0; i < _nParticles; i++) {
+        dataWriter->writeData(i + 1, _particles[i]->model());
+    }
+    delete dataWriter;
+
+    log(Message) << "Particles written to <<"
+        << _settings.get("mcmcOutfile") << ">> and <<"
+        << _settings.get("eventDataOutfile") << ">>\n";
+}
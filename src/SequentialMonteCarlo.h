@@ -0,0 +1,90 @@
+#ifndef SEQUENTIAL_MONTE_CARLO_H
+#define SEQUENTIAL_MONTE_CARLO_H
+
+
+#include <vector>
+
+class Random;
+class Settings;
+class ModelFactory;
+class MCMC;
+class Tree;
+class ChainWorkerPool;
+
+
+// Samples the posterior with a population of smcParticles particles, each
+// the state of an MCMC chain (runMode = smc). The particles start from
+// the prior: each runs smcPriorGenerations generations with the power of
+// the likelihood set to 0 (see Model::setLikelihoodPower). The power is
+// then raised step by step to 1. Each next power is chosen by bisection
+// so that the conditional effective sample size of the incremental
+// weights (the likelihoods raised to the increase of the power) is
+// smcTargetConditionalESS times the number of particles (Zhou, Johansen
+// and Aston 2016). The particles are resampled (systematically) when
+// their effective sample size falls below smcResampleThreshold times
+// their number. Then the particles run MCMC at the new power, on up to
+// numberOfThreads threads, until their number of events has changed
+// smcEventNumberChanges times on average (see moveParticles). The log of
+// the marginal likelihood is estimated from the incremental weights along
+// the way. At the end, the particles are resampled to equal weights and
+// written to mcmcOutfile and eventDataOutfile, one generation per
+// particle.
+
+class SequentialMonteCarlo
+{
+public:
+
+    SequentialMonteCarlo
+        (Random& random, Settings& settings, ModelFactory* modelFactory);
+    ~SequentialMonteCarlo();
+
+    void run();
+
+    double logMarginalLikelihood() const;
+
+private:
+
+
+    int moveParticles();
+    int runParticle(int i, int generations);
+
+    double nextLikelihoodPower() const;
+    double conditionalEffectiveSampleSize(double increment) const;
+    double effectiveSampleSize() const;
+    void reweight(double increment);
+    void resample();
+
+    void writeParticles();
+
+    Random& _random;
+    Settings& _settings;
+    ModelFactory* _modelFactory;
+
+    Tree* _tree;
+    ChainWorkerPool* _workerPool;
+
+    std::vector<MCMC*> _particles;
+
+    // Normalized weight of each particle
+    std::vector<double> _weights;
+
+    int _nParticles;
+    int _priorGenerations;
+    int _moveGenerations;
+    double _eventNumberChanges;
+    int _maxMoveGenerations;
+    double _targetConditionalESS;
+    double _resampleThreshold;
+
+    double _likelihoodPower;
+    double _logMarginalLikelihood;
+};
+
+
+inline double SequentialMonteCarlo::logMarginalLikelihood() const
+{
+    return _logMarginalLikelihood;
+}
+
+
+#endif
@@ -102,6 +102,7 @@ void Settings::initializeGlobalSettings()
     addParameter("treefile", "tree.txt");
     addParameter("sampleFromPriorOnly", "0", NotRequired);
     addParameter("runMCMC", "0");
+    addParameter("runMode", "mcmc", NotRequired);
     addParameter("loadEventData", "0", NotRequired);
     addParameter("eventDataInfile", "event_data_in.txt", NotRequired);
     addParameter("initializeModel", "0");
@@ -115,12 +116,42 @@ void Settings::initializeGlobalSettings()
     addParameter("updateEventLocationScale", "0.0");
     addParameter("updateEventRateScale", "0.0");
     addParameter("localGlobalMoveRatio", "0.0");
+    addParameter("eventLocationTries", "1", NotRequired);
+    addParameter("eventLocationThreads", "0", NotRequired);
+    addParameter("learnedEventLocationWeight", "0.0", NotRequired);
 
     // Metropolis-coupled MCMC
     addParameter("numberOfChains", "1", NotRequired);
+    addParameter("numberOfThreads", "0", NotRequired);
+    addParameter("speculativeThreads", "0", NotRequired);
+    addParameter("multiStartChains", "0", NotRequired);
+    addParameter("multiStartGenerations", "10000", NotRequired);
     addParameter("deltaT", "0.1", NotRequired);
     addParameter("swapPeriod", "1000", NotRequired);
+    addParameter("chainSwapScheme", "random", NotRequired);
+    addParameter("asynchronousSwaps", "0", NotRequired);
+    addParameter("temperatureAdaptationGenerations", "0", NotRequired);
+    addParameter("populationMCMC", "0", NotRequired);
+    addParameter("differentialEvolutionSweeps", "1", NotRequired);
+    addParameter("differentialEvolutionNoise", "0.01", NotRequired);
     addParameter("chainSwapFileName", "chain_swap.txt", NotRequired);
+    addParameter("numberOfReplicates", "1", NotRequired);
+    addParameter("replicateDiagnosticsFreq", "100000", NotRequired);
+
+    // Maximum-a-posteriori search (runMode = optimize)
+    addParameter("optimizeStarts", "8", NotRequired);
+    addParameter("optimizeGenerations", "100000", NotRequired);
+    addParameter("optimizeFinalTemperature", "1000", NotRequired);
+    addParameter("optimizeTolerance", "0.0001", NotRequired);
+
+    // Sequential Monte Carlo (runMode = smc)
+    addParameter("smcParticles", "32", NotRequired);
+    addParameter("smcPriorGenerations", "1000", NotRequired);
+    addParameter("smcMoveGenerations", "100", NotRequired);
+    addParameter("smcEventNumberChanges", "100", NotRequired);
+    addParameter("smcMaxMoveGenerations", "200000", NotRequired);
+    addParameter("smcTargetConditionalESS", "0.9", NotRequired);
+    addParameter("smcResampleThreshold", "0.5", NotRequired);
 
     // Priors
     addParameter("poissonRatePrior", "0.0", NotRequired);
@@ -143,6 +174,16 @@ void Settings::initializeGlobalSettings()
 
     addParameter("acceptanceResetFreq", "1000", NotRequired);
 
+    // Stopping at a target effective sample size
+    addParameter("targetEffectiveSampleSize", "0", NotRequired);
+    addParameter("essBurnInFraction", "0.1", NotRequired);
+    addParameter("essCheckFreq", "10000", NotRequired);
+
+    // Checkpoints
+    addParameter("checkpointFreq", "0", NotRequired);
+    addParameter("checkpointFileName", "checkpoint.bin", NotRequired);
+    addParameter("resume", "0", NotRequired);
+
     // Parameter update rates
     addParameter("updateRateEventNumber", "0.0");
     addParameter("updateRateEventNumberForBranch", "0.0", NotRequired);
@@ -152,8 +193,19 @@ void Settings::initializeGlobalSettings()
 
     // Other (TODO: Need to add documentation for these)
     addParameter("autotune", "0", NotRequired);
+    addParameter("autotuneGenerations", "100000", NotRequired);
+    addParameter("autotuneTargetAcceptanceRate", "0.44", NotRequired);
+    addParameter("adaptProposalWeights", "0", NotRequired);
+    addParameter("proposalWeightAdaptationGenerations", "100000",
+        NotRequired);
+    addParameter("minProposalWeightFactor", "0.2", NotRequired);
+    addParameter("maxProposalWeightFactor", "5", NotRequired);
     addParameter("outputAcceptanceInfo", "0", NotRequired);
     addParameter("acceptanceInfoFileName", "acceptance_info.txt", NotRequired);
+    addParameter("outputProposalProfile", "0", NotRequired);
+    addParameter("proposalProfileFileName", "proposal_profile.txt",
+        NotRequired);
+    addParameter("proposalProfileFreq", "10000", NotRequired);
 
     // TODO: New params May 30 2014, need documented
     addParameter("maxNumberEvents", "5000", NotRequired);
@@ -200,6 +252,7 @@ void Settings::initializeSpeciationExtinctionSettings()
     addParameter("updateMuInitScale", "0.0");
     addParameter("updateLambdaShiftScale", "0.0");
     addParameter("updateMuShiftScale", "0.0", NotRequired);
+    addParameter("updateLambdaMuBlockScale", "1.0", NotRequired);
     addParameter("minCladeSizeForShift", "1", NotRequired);
 
     // Starting parameters
@@ -229,6 +282,7 @@ void Settings::initializeSpeciationExtinctionSettings()
     addParameter("updateRateLambdaShift", "0.0");
     addParameter("updateRateMu0", "0.0");
     addParameter("updateRateMuShift", "0.0", NotRequired);
+    addParameter("updateRateLambdaMuBlock", "0.0", NotRequired);
     addParameter("updateRateLambdaTimeMode", "0.0");
 
     // Maximum value of extinction probability on branch that will be tolerated:
@@ -379,7 +433,9 @@ void Settings::attachPrefixToOutputFiles()
           "chainSwapFileName",
           "lambdaOutfile",
           "muOutfile",
-          "betaOutfile" };
+          "betaOutfile",
+          "checkpointFileName",
+          "proposalProfileFileName" };
 
     // Attach the prefix to each parameter
     ParameterMap::iterator paramIt;
@@ -439,7 +495,8 @@ void Settings::checkAllSettingsAreUserDefined() const
 
 void Settings::checkAllOutputFilesAreWriteable() const
 {
-    if (!get<bool>("overwrite")) {
+    // A resumed run appends to the output files of the interrupted run
+    if (!get<bool>("overwrite") && !get<bool>("resume")) {
         if (anyOutputFileExists()) {
             exitWithErrorOutputFileExists();
         }
@@ -451,22 +508,22 @@ bool Settings::anyOutputFileExists() const
 {
     // Global output files
     if (fileExists(get("runInfoFilename")) ||
-        fileExists(get("mcmcOutfile"))     ||
-        fileExists(get("eventDataOutfile"))) {
+        outputFileExists("mcmcOutfile")    ||
+        outputFileExists("eventDataOutfile")) {
         return true;
     }
 
     if (get<bool>("writeMeanBranchLengthTrees")) {
         // Speciation/extinction output files
         if (get("modeltype") == "speciationextinction") {
-            if (fileExists(get("lambdaOutfile")) ||
-                fileExists(get("muOutfile"))) {
+            if (outputFileExists("lambdaOutfile") ||
+                outputFileExists("muOutfile")) {
                 return true;
             }
 
         // Trait output files
         } else if (get("modeltype") == "trait") {
-            if (fileExists(get("betaOutfile"))) {
+            if (outputFileExists("betaOutfile")) {
                 return true;
             }
         }
@@ -476,6 +533,42 @@ bool Settings::anyOutputFileExists() const
 }
 
 
+// Replicates write their own copies of every output file
+// except the run info file
+bool Settings::outputFileExists(const std::string& name) const
+{
+    int nReplicates = get<int>("numberOfReplicates");
+    if (nReplicates <= 1) {
+        return fileExists(get(name));
+    }
+
+    for (int k = 0; k < nReplicates; k++) {
+        if (fileExists(replicateFileName(get(name), k))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+std::string Settings::replicateFileName
+    (const std::string& fileName, int replicate)
+{
+    std::ostringstream suffix;
+    suffix << "_rep" << replicate + 1;
+
+    // Only a dot in the last path component starts an extension
+    std::string::size_type dot = fileName.find_last_of('.');
+    std::string::size_type slash = fileName.find_last_of("/\\");
+    if (dot == std::string::npos ||
+            (slash != std::string::npos && dot < slash)) {
+        return fileName + suffix.str();
+    }
+
+    return fileName.substr(0, dot) + suffix.str() + fileName.substr(dot);
+}
+
 
 bool Settings::fileExists(const std::string& filename) const
 {
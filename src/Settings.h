@@ -28,9 +28,17 @@ public:
     template<typename T> T get(const std::string& name) const;
 
     void set(const std::string& name, const std::string& value);
+
+    // Whether the parameter exists for the current model type
+    bool has(const std::string& name) const;
   
     void printCurrentSettings(std::ostream& out = std::cout) const;
 
+    // Name of an output file of replicate k (from 0) when running several
+    // replicates: "_rep<k + 1>" is inserted before the extension
+    static std::string replicateFileName
+        (const std::string& fileName, int replicate);
+
 private:
 
     void readControlFile(const std::string& controlFilename);
@@ -55,6 +63,7 @@ private:
     std::string extractFileName(const std::string& path) const;
 
     bool anyOutputFileExists() const;
+    bool outputFileExists(const std::string& name) const;
     bool fileExists(const std::string& filename) const;
 
     void exitWithErrorNoControlFile() const;
@@ -67,7 +76,7 @@ private:
     void exitWithErrorDuplicateParameter(const std::string& param) const;
     void exitWithErrorOutputFileExists() const;
 
-    static const size_t NumberOfParamsToPrefix = 10;
+    static const size_t NumberOfParamsToPrefix = 12;
  
     // Parameters that settings knows about
     ParameterMap _parameters;
@@ -92,6 +101,12 @@ inline std::string Settings::get(const std::string& name) const
 }
 
 
+inline bool Settings::has(const std::string& name) const
+{
+    return _parameters.find(name) != _parameters.end();
+}
+
+
 template<typename T>
 inline T Settings::get(const std::string& name) const
 {
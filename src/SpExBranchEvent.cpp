@@ -7,8 +7,13 @@ class Random;
 
 SpExBranchEvent::SpExBranchEvent(double speciation, double lamshift,
         double extinction, double mushift, bool isTimeVariable,
-        Node* x, Tree* tp, Random& random, double map) :
-    BranchEvent(x, tp, random, map), _lamInit(speciation), _lamShift(lamshift),
-        _muInit(extinction), _muShift(mushift), _isTimeVariable(isTimeVariable)
+        Node* x, Tree* tp, Random& random, double map,
+        EventParameterStore& parameters) :
+    BranchEvent(x, tp, random, map, parameters)
 {
+    setLamInit(speciation);
+    setLamShift(lamshift);
+    setMuInit(extinction);
+    setMuShift(mushift);
+    setTimeVariable(isTimeVariable);
 }
@@ -11,21 +11,21 @@ class Random;
 class SpExBranchEvent : public BranchEvent
 {
 
-private:
-
-    double _lamInit;   // Initial speciation rate at event
-    double _lamShift;  // magnitude & direction of speciation shift
-    double _muInit;    // Initial Mu rate at event
-    double _muShift;   // magnitude & direction of mu shift
-
-    bool _isTimeVariable;
-
 public:
 
+    // Parameter indices in the EventParameterStore
+    enum Parameter {
+        LamInit,     // Initial speciation rate at event
+        LamShift,    // magnitude & direction of speciation shift
+        MuInit,      // Initial Mu rate at event
+        MuShift,     // magnitude & direction of mu shift
+        NumberOfParameters
+    };
+
     // constructors, depending on whether you want trait rate or lambda/mu
     SpExBranchEvent(double speciation, double lamshift, double extinction,
         double mushift, bool isTimeVariable, Node* x, Tree* tp, Random& random,
-        double map);
+        double map, EventParameterStore& parameters);
     virtual ~SpExBranchEvent() {};
 
     void   setLamInit(double x);
@@ -47,61 +47,61 @@ public:
 
 inline void SpExBranchEvent::setLamInit(double x)
 {
-    _lamInit = x;
+    _parameters.set(_parameterId, LamInit, x);
 }
 
 
 inline double SpExBranchEvent::getLamInit()
 {
-    return _lamInit;
+    return _parameters.get(_parameterId, LamInit);
 }
 
 
 inline void SpExBranchEvent::setMuInit(double x)
 {
-    _muInit = x;
+    _parameters.set(_parameterId, MuInit, x);
 }
 
 
 inline double SpExBranchEvent::getMuInit()
 {
-    return _muInit;
+    return _parameters.get(_parameterId, MuInit);
 }
 
 
 inline void SpExBranchEvent::setLamShift(double x)
 {
-    _lamShift = x;
+    _parameters.set(_parameterId, LamShift, x);
 }
 
 
 inline double SpExBranchEvent::getLamShift()
 {
-    return _lamShift;
+    return _parameters.get(_parameterId, LamShift);
 }
 
 
 inline void SpExBranchEvent::setMuShift(double x)
 {
-    _muShift = x;
+    _parameters.set(_parameterId, MuShift, x);
 }
 
 
 inline double SpExBranchEvent::getMuShift()
 {
-    return _muShift;
+    return _parameters.get(_parameterId, MuShift);
 }
 
 
 inline void SpExBranchEvent::setTimeVariable(bool isTimeVariable)
 {
-    _isTimeVariable = isTimeVariable;
+    _parameters.setTimeVariable(_parameterId, isTimeVariable);
 }
 
 
 inline bool SpExBranchEvent::isTimeVariable()
 {
-    return _isTimeVariable;
+    return _parameters.isTimeVariable(_parameterId);
 }
 
 
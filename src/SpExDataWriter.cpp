@@ -16,3 +16,10 @@ void SpExDataWriter::writeData(int generation, Model& model)
     ModelDataWriter::writeData(generation, model);
     _eventDataWriter.writeData(generation, model);
 }
+
+
+void SpExDataWriter::appendToExistingOutput(bool headerWritten)
+{
+    ModelDataWriter::appendToExistingOutput(headerWritten);
+    _eventDataWriter.appendToExistingOutput(headerWritten);
+}
@@ -16,6 +16,7 @@ public:
     SpExDataWriter(Settings &settings);
 
     virtual void writeData(int generation, Model& model);
+    virtual void appendToExistingOutput(bool headerWritten);
 
 protected:
 
@@ -14,6 +14,12 @@ SpExEventDataWriter::SpExEventDataWriter(Settings& settings) :
 }
 
 
+SpExEventDataWriter::SpExEventDataWriter(const std::string& outputFileName) :
+    EventDataWriter(outputFileName)
+{
+}
+
+
 SpExEventDataWriter::~SpExEventDataWriter()
 {
 }
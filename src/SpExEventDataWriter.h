@@ -14,6 +14,7 @@ class SpExEventDataWriter : public EventDataWriter
 public:
 
     SpExEventDataWriter(Settings& settings);
+    SpExEventDataWriter(const std::string& outputFileName);
     virtual ~SpExEventDataWriter();
 
 private:
@@ -11,12 +11,14 @@
 #include "LambdaShiftProposal.h"
 #include "MuInitProposal.h"
 #include "MuShiftProposal.h"
+#include "LambdaMuBlockProposal.h"
 #include "LambdaTimeModeProposal.h"
 #include "PreservationRateProposal.h"
 
 #include "Log.h"
 #include "Prior.h"
 #include "Tools.h"
+#include "Checkpoint.h"
 
 #include <cstdlib>
 #include <cmath>
@@ -29,8 +31,9 @@
 
 #define NEVER_RECOMPUTE_E0
 
-SpExModel::SpExModel(Random& random, Settings& settings) :
-    Model(random, settings)
+SpExModel::SpExModel(Random& random, Settings& settings, Tree& tree) :
+    Model(random, settings, tree, SpExBranchEvent::NumberOfParameters),
+    _nodeStates(tree.initialSpExNodeStates())
 {
     // Initial values
     _lambdaInit0 = _settings.get<double>("lambdaInit0");
@@ -62,7 +65,7 @@ SpExModel::SpExModel(Random& random, Settings& settings) :
         for (int i = 0; i < numNodes; i++) {
             Node* node = postOrderNodes[i];
             bool left = _random.uniform() <= 0.5;
-            node->setInheritFromLeft(left);
+            nodeState(node).inheritFromLeft = left;
             //std::cout << left << std::endl;
         }
     
@@ -122,20 +125,20 @@ SpExModel::SpExModel(Random& random, Settings& settings) :
     //// Change from BranchEvent to SpExBranchEvent:
     BranchEvent* x =  new SpExBranchEvent(_lambdaInit0, _lambdaShift0,
         _muInit0, _muShift0, _initialLambdaIsTimeVariable,
-        _tree->getRoot(), _tree, _random, 0);
+        _tree->getRoot(), _tree, _random, 0, _eventParameters);
     
     
     _rootEvent = x;
     _lastEventModified = x;
 
     // Set NodeEvent of root node equal to the_rootEvent:
-    _tree->getRoot()->getBranchHistory()->setNodeEvent(_rootEvent);
+    getBranchHistory(_tree->getRoot())->setNodeEvent(_rootEvent);
 
     // Initialize all branch histories to equal the root event
     forwardSetBranchHistories(_rootEvent);
 
-    _tree->setNodeSpeciationParameters();
-    _tree->setNodeExtinctionParameters();
+    setNodeSpeciationParameters();
+    setNodeExtinctionParameters();
     
     _extinctionProbMax = _settings.get<double>("extinctionProbMax");
 
@@ -192,6 +195,8 @@ SpExModel::SpExModel(Random& random, Settings& settings) :
         (new LambdaShiftProposal(random, settings, *this, _prior));
     _proposals.push_back(new MuInitProposal(random, settings, *this, _prior));
     _proposals.push_back(new MuShiftProposal(random, settings, *this, _prior));
+    _proposals.push_back
+        (new LambdaMuBlockProposal(random, settings, *this, _prior));
     _proposals.push_back(new LambdaTimeModeProposal(random, settings, *this));
 
     if (_hasPaleoData){
@@ -284,7 +289,8 @@ BranchEvent* SpExModel::newBranchEventWithReadParameters
 
     // TODO: Fix reading of parameters (for now, send true for time-variable)
     return new SpExBranchEvent(lambdaInit, lambdaShift,
-        muInit, muShift, true, x, _tree, _random, time);
+        muInit, muShift, true, x, _tree, _random, time,
+        _eventParameters);
 }
 
 
@@ -314,10 +320,35 @@ double SpExModel::muShiftParameter(const std::vector<std::string>& parameters)
 }
 
 
+void SpExModel::setNodeSpeciationParameters()
+{
+    const std::vector<Node*>& nodes = _tree->preOrderNodes();
+    for (int i = 0; i < (int)nodes.size(); i++) {
+        nodes[i]->computeAndSetNodeSpeciationParams
+            (getBranchHistory(nodes[i]), nodeState(nodes[i]));
+    }
+}
+
+
+void SpExModel::setNodeExtinctionParameters()
+{
+    const std::vector<Node*>& nodes = _tree->preOrderNodes();
+    for (int i = 0; i < (int)nodes.size(); i++) {
+        nodes[i]->computeAndSetNodeExtinctionParams
+            (getBranchHistory(nodes[i]), nodeState(nodes[i]));
+    }
+}
+
+
 void SpExModel::setMeanBranchParameters()
 {
-    _tree->setMeanBranchSpeciation();
-    _tree->setMeanBranchExtinction();
+    const std::vector<Node*>& nodes = nodesWithChangedHistory();
+    for (int i = 0; i < (int)nodes.size(); i++) {
+        nodes[i]->computeNodeBranchSpeciationExtinctionParams
+            (getBranchHistory(nodes[i]), nodeState(nodes[i]));
+    }
+
+    clearNodesWithChangedHistory();
 }
 
 
@@ -345,7 +376,7 @@ BranchEvent* SpExModel::newBranchEventWithParametersFromSettings(double x)
     
     return new SpExBranchEvent(newLam, newLambdaShift, newMu,
                                newMuShift, newIsTimeVariable, _tree->mapEventToTree(x),
-                               _tree, _random, x);
+                               _tree, _random, x, _eventParameters);
 
 }
 
@@ -374,7 +405,7 @@ BranchEvent* SpExModel::newBranchEventWithRandomParameters(double x)
 
     return new SpExBranchEvent(newLam, newLambdaShift, newMu,
         newMuShift, newIsTimeVariable, _tree->mapEventToTree(x),
-        _tree, _random, x);
+        _tree, _random, x, _eventParameters);
 }
 
 
@@ -416,7 +447,114 @@ BranchEvent* SpExModel::newBranchEventFromLastDeletedEvent()
         _lastDeletedEventLambdaShift, _lastDeletedEventMuInit,
         _lastDeletedEventMuShift, _lastDeletedEventTimeVariable,
         _tree->mapEventToTree(_lastDeletedEventMapTime), _tree, _random,
-        _lastDeletedEventMapTime);
+        _lastDeletedEventMapTime, _eventParameters);
+}
+
+
+BranchEvent* SpExModel::newBranchEventWithDefaultParameters(double x)
+{
+    return new SpExBranchEvent(0.0, 0.0, 0.0, 0.0, false,
+        _tree->mapEventToTree(x), _tree, _random, x, _eventParameters);
+}
+
+
+// Root lambdaInit, lambdaShift and muInit, and the preservation rate
+// with paleontological data
+void SpExModel::getModelGlobalParameters
+    (std::vector<double>& values, std::vector<bool>& isLogScale)
+{
+    SpExBranchEvent* rootEvent = static_cast<SpExBranchEvent*>(_rootEvent);
+
+    values.push_back(rootEvent->getLamInit());
+    isLogScale.push_back(true);
+    values.push_back(rootEvent->getLamShift());
+    isLogScale.push_back(false);
+    values.push_back(rootEvent->getMuInit());
+    isLogScale.push_back(true);
+
+    if (_hasPaleoData) {
+        values.push_back(_preservationRate);
+        isLogScale.push_back(true);
+    }
+}
+
+
+void SpExModel::setModelGlobalParameters(const double* values)
+{
+    SpExBranchEvent* rootEvent = static_cast<SpExBranchEvent*>(_rootEvent);
+
+    rootEvent->setLamInit(values[0]);
+    if (rootEvent->isTimeVariable()) {
+        rootEvent->setLamShift(values[1]);
+    }
+    rootEvent->setMuInit(values[2]);
+
+    if (_hasPaleoData) {
+        _preservationRate = values[3];
+    }
+
+    setNodeSpeciationParameters();
+    setNodeExtinctionParameters();
+}
+
+
+// The block update (see LambdaMuBlockProposal) only changes parameters
+// whose own update rate is not 0
+void SpExModel::getModelFixedGlobalParameters(std::vector<bool>& isFixed)
+{
+    getModelFixedEventParameters(isFixed);
+
+    if (_hasPaleoData) {
+        isFixed.push_back
+            (_settings.get<double>("updateRatePreservationRate") <= 0.0);
+    }
+}
+
+
+void SpExModel::getModelEventParameters(BranchEvent* event,
+    std::vector<double>& values, std::vector<bool>& isLogScale)
+{
+    SpExBranchEvent* specificEvent = static_cast<SpExBranchEvent*>(event);
+
+    values.push_back(specificEvent->getLamInit());
+    isLogScale.push_back(true);
+    values.push_back(specificEvent->getLamShift());
+    isLogScale.push_back(false);
+    values.push_back(specificEvent->getMuInit());
+    isLogScale.push_back(true);
+}
+
+
+void SpExModel::setModelEventParameters
+    (BranchEvent* event, const double* values)
+{
+    SpExBranchEvent* specificEvent = static_cast<SpExBranchEvent*>(event);
+
+    specificEvent->setLamInit(values[0]);
+    if (specificEvent->isTimeVariable()) {
+        specificEvent->setLamShift(values[1]);
+    }
+    specificEvent->setMuInit(values[2]);
+}
+
+
+void SpExModel::getModelFixedEventParameters(std::vector<bool>& isFixed)
+{
+    isFixed.push_back(_settings.get<double>("updateRateLambda0") == 0.0);
+    isFixed.push_back(_settings.get<double>("updateRateLambdaShift") == 0.0);
+    isFixed.push_back(_settings.get<double>("updateRateMu0") == 0.0);
+}
+
+
+void SpExModel::writeModelState(std::ostream& out) const
+{
+    Checkpoint::write(out, _preservationRate);
+}
+
+
+void SpExModel::readModelState(std::istream& in)
+{
+    Checkpoint::read(in, _preservationRate);
 }
 
 
@@ -425,6 +563,7 @@ BranchEvent* SpExModel::newBranchEventFromLastDeletedEvent()
  
 double SpExModel::computeLogLikelihood()
 {
+    countLikelihoodEvaluation();
     if (_sampleFromPriorOnly)
         return 0.0;
  
@@ -440,7 +579,7 @@ double SpExModel::computeLogLikelihood()
     // Set all nodes to initial values for NO downstream rate shift.
     for (int i = 0; i < numNodes; i++){
         Node* node = postOrderNodes[i];
-        node->setHasDownstreamRateShift(false);
+        nodeState(node).hasDownstreamRateShift = false;
     }    
     
     for (int i = 0; i < numNodes; i++) {
@@ -453,11 +592,11 @@ double SpExModel::computeLogLikelihood()
             
 #ifdef NEVER_RECOMPUTE_E0
             
-            double E_left = node->getLfDesc()->getExtinctionEnd();
-            double E_right = node->getRtDesc()->getExtinctionEnd();
+            double E_left = nodeState(node->getLfDesc()).eEnd;
+            double E_right = nodeState(node->getRtDesc()).eEnd;
             
-            bool left_shift = node->getLfDesc()->getHasDownstreamRateShift();
-            bool right_shift = node->getRtDesc()->getHasDownstreamRateShift();
+            bool left_shift = nodeState(node->getLfDesc()).hasDownstreamRateShift;
+            bool right_shift = nodeState(node->getRtDesc()).hasDownstreamRateShift;
             
             
             // random: favor extinction probs of right or left branch
@@ -472,11 +611,11 @@ double SpExModel::computeLogLikelihood()
             
             if (_combineExtinctionAtNodes == "random"){
                 
-                if (node->getInheritFromLeft() == true){
-                    node->setEinit(E_left);
+                if (nodeState(node).inheritFromLeft == true){
+                    nodeState(node).ei = E_left;
                  
                 }else{
-                    node->setEinit(E_right);
+                    nodeState(node).ei = E_right;
                  }
                 
                 
@@ -485,30 +624,30 @@ double SpExModel::computeLogLikelihood()
                 double delta = std::fabs(E_left - E_right);
                 
                 if (delta < 0.001){
-                    node->setEinit(E_left);
+                    nodeState(node).ei = E_left;
                 }else{
                     E_left *= E_right;
-                    node->setEinit(E_left);
+                    nodeState(node).ei = E_left;
                 }
                 
             }else if (_combineExtinctionAtNodes == "favor_shift"){
                 if (left_shift == true & right_shift == true){
-                    node->setEinit( E_left * E_right );
+                    nodeState(node).ei = E_left * E_right;
                 }else if (left_shift == true & right_shift == false){
-                    node->setEinit(E_left);
+                    nodeState(node).ei = E_left;
                 }else if (left_shift == false & right_shift == true){
-                    node->setEinit(E_right);
+                    nodeState(node).ei = E_right;
                 }else if (left_shift == false & right_shift == false){
-                    node->setEinit(E_left);
+                    nodeState(node).ei = E_left;
                 }else{
                     std::cout << "problem in computeLogLikelihood()" << std::endl;
                     std::cout << "Error in _combineExtinctionAtNodes option" << std::endl;
                     exit(0);
                 }
             }else if (_combineExtinctionAtNodes == "left"){
-                node->setEinit(E_left);
+                nodeState(node).ei = E_left;
             }else if (_combineExtinctionAtNodes == "right"){
-                node->setEinit(E_right);
+                nodeState(node).ei = E_right;
             }else{
                 std::cout << "unsupported option for combining extinction probabilities" << std::endl;
                 exit(0);
@@ -524,9 +663,9 @@ double SpExModel::computeLogLikelihood()
             // Does not include root node, so it is conditioned
             // on basal speciation event occurring:
             if (node != _tree->getRoot()) {
-                logLikelihood  += log(node->getNodeLambda());
+                logLikelihood  += log(nodeState(node).nodeLambda);
 
-                node->setDinit(1.0);
+                nodeState(node).di = 1.0;
             }
         }
     }
@@ -544,21 +683,21 @@ double SpExModel::computeLogLikelihood()
 double SpExModel::computeSpExProbBranch(Node* node)
 {
  
-    int n_events = node->getBranchHistory()->getNumberOfBranchEvents();
+    int n_events = getBranchHistory(node)->getNumberOfBranchEvents();
     
     if (n_events > 0){
-        node->setHasDownstreamRateShift(true);
+        nodeState(node).hasDownstreamRateShift = true;
     }
     
-    if (node->getHasDownstreamRateShift() == true){
-        node->getAnc()->setHasDownstreamRateShift(true);
+    if (nodeState(node).hasDownstreamRateShift == true){
+        nodeState(node->getAnc()).hasDownstreamRateShift = true;
     }
   
     
     double logLikelihood = 0.0;
 
-    double D0 = node->getDinit();    // Initial speciation probability
-    double E0 = node->getEinit();    // Initial extinction probability
+    double D0 = nodeState(node).di;    // Initial speciation probability
+    double E0 = nodeState(node).ei;    // Initial extinction probability
     
     bool recompute_E0 = false;
 
@@ -598,10 +737,10 @@ double SpExModel::computeSpExProbBranch(Node* node)
             double deltaT = endTime - startTime;
             
             double curLam = node->computeSpeciationRateIntervalRelativeTime
-            (startTime, endTime);
+            (getBranchHistory(node), startTime, endTime);
             
             double curMu = node->computeExtinctionRateIntervalRelativeTime
-            (startTime, endTime);
+            (getBranchHistory(node), startTime, endTime);
             
             double curPsi = _preservationRate;
             
@@ -639,7 +778,7 @@ double SpExModel::computeSpExProbBranch(Node* node)
     double startTime = node->getBrlen();
     double endTime = node->getBrlen();
  
-    SpExBranchEvent* be = static_cast<SpExBranchEvent*>(node->getBranchHistory()->getLastEvent(node->getTime()));
+    SpExBranchEvent* be = static_cast<SpExBranchEvent*>(getBranchHistory(node)->getLastEvent(node->getTime()));
  
     while (startTime > 0) {
         startTime -= _segLength;
@@ -666,7 +805,7 @@ double SpExModel::computeSpExProbBranch(Node* node)
             
             // Reset start time to absolute time of event if we pass an event on branch
             abs_start_time = node->getAnc()->getTime() + startTime;
-            be = static_cast<SpExBranchEvent*>(node->getBranchHistory()->getLastEvent(be));
+            be = static_cast<SpExBranchEvent*>(getBranchHistory(node)->getLastEvent(be));
             
             // set flag to recompute_E0 if you switch to new process.
             // this will ONLY be used if the NEVER_RECOMPUTE_E0 macro is undefined
@@ -744,7 +883,7 @@ double SpExModel::computeSpExProbBranch(Node* node)
             // Because only get here if changing process, the difference in age of the
             // last process and next process is the relevant start time.
             
-            E0 = node->getEtip();
+            E0 = nodeState(node).etip;
             
             // get current time relative to age of process:
             double start_rel_to_process = abs_start_time - be->getAbsoluteTime();
@@ -774,7 +913,7 @@ double SpExModel::computeSpExProbBranch(Node* node)
     
     // set extinction end value for branch for current node.
     
-    node->setExtinctionEnd(E0);
+    nodeState(node).eEnd = E0;
     
     // but do not set parent -- this will happen in the calling function
     // when right and left descendants are computed.
@@ -784,7 +923,7 @@ double SpExModel::computeSpExProbBranch(Node* node)
     Node * parent = node->getAnc();
     
     // Should be exactly equal coming from right or left descendant branch at this point.
-    parent->setEinit(E0);
+    nodeState(parent).ei = E0;
 
 #endif
   
@@ -974,20 +1113,28 @@ double SpExModel::computeLogPrior()
     logPrior += _prior.muInitRootPrior(rootEvent->getMuInit());
     logPrior += _prior.muShiftRootPrior(rootEvent->getMuShift());
 
-    EventSet::iterator it;
-    for (it = _eventCollection.begin(); it != _eventCollection.end(); ++it) {
-        SpExBranchEvent* event = static_cast<SpExBranchEvent*>(*it);
+    // Non-root events, straight from the parameter arrays
+    const double* lamInit = _eventParameters.values(SpExBranchEvent::LamInit);
+    const double* lamShift =
+        _eventParameters.values(SpExBranchEvent::LamShift);
+    const double* muInit = _eventParameters.values(SpExBranchEvent::MuInit);
+    const double* muShift = _eventParameters.values(SpExBranchEvent::MuShift);
+    const char* isTimeVariable = _eventParameters.timeVariableFlags();
+    const char* isInTree = _eventParameters.inTreeFlags();
+
+    int numberOfIds = _eventParameters.size();
+    for (int i = 0; i < numberOfIds; i++) {
+        if (!isInTree[i]) {
+            continue;
+        }
 
-        logPrior += _prior.lambdaInitPrior(event->getLamInit());
-        if (event->isTimeVariable()) {
-            logPrior += _prior.lambdaShiftPrior(event->getLamShift());
-        //    logPrior += std::log(_prior.lambdaIsTimeVariablePrior());
-        }else{
-        //    logPrior += std::log(1.0 - _prior.lambdaIsTimeVariablePrior());
+        logPrior += _prior.lambdaInitPrior(lamInit[i]);
+        if (isTimeVariable[i]) {
+            logPrior += _prior.lambdaShiftPrior(lamShift[i]);
         }
-        
-        logPrior += _prior.muInitPrior(event->getMuInit());
-        logPrior += _prior.muShiftPrior(event->getMuShift());
+
+        logPrior += _prior.muInitPrior(muInit[i]);
+        logPrior += _prior.muShiftPrior(muShift[i]);
     }
 
     // Here's prior density on the event rate
@@ -1023,7 +1170,7 @@ void SpExModel::printNodeProbs()
     for (int i = 0; i < numNodes; i++) {
         Node* node = postOrderNodes[i];
         std::cout << node << "\t" << node->getName() << "\t";
-        std::cout << node->getEinit() << std::endl;
+        std::cout << nodeState(node).ei << std::endl;
     
     }
 
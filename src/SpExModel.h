@@ -11,6 +11,7 @@
 class Node;
 class Random;
 class Settings;
+class Tree;
 class BranchEvent;
 class Proposal;
 class SpExBranchEvent;
@@ -21,10 +22,17 @@ class SpExModel : public Model
 
 public:
 
-    SpExModel(Random& rng, Settings& settings);
+    SpExModel(Random& rng, Settings& settings, Tree& tree);
 
     virtual double computeLogLikelihood();
     virtual double computeLogPrior();
+
+    // This chain's speciation-extinction state for the given node
+    SpExNodeState& nodeState(Node* node);
+
+    // Set the speciation (or extinction) rate at every node
+    void setNodeSpeciationParameters();
+    void setNodeExtinctionParameters();
  
 	// Methods for auto-tuning
     //   no auto-tuning yet implemented
@@ -60,6 +68,20 @@ private:
     virtual BranchEvent* newBranchEventWithRandomParameters(double x);
     virtual BranchEvent* newBranchEventWithParametersFromSettings(double x);
     virtual BranchEvent* newBranchEventFromLastDeletedEvent();
+    virtual BranchEvent* newBranchEventWithDefaultParameters(double x);
+
+    virtual void getModelGlobalParameters
+        (std::vector<double>& values, std::vector<bool>& isLogScale);
+    virtual void setModelGlobalParameters(const double* values);
+    virtual void getModelFixedGlobalParameters(std::vector<bool>& isFixed);
+    virtual void getModelEventParameters(BranchEvent* event,
+        std::vector<double>& values, std::vector<bool>& isLogScale);
+    virtual void setModelEventParameters
+        (BranchEvent* event, const double* values);
+    virtual void getModelFixedEventParameters(std::vector<bool>& isFixed);
+
+    virtual void writeModelState(std::ostream& out) const;
+    virtual void readModelState(std::istream& in);
 
     virtual void setMeanBranchParameters();
     virtual void setDeletedEventParameters(BranchEvent* be);
@@ -97,6 +119,9 @@ private:
     double _readMuShift;
 
     double _extinctionProbMax;
+
+    // Node state of this chain, indexed by pre-order index
+    std::vector<SpExNodeState> _nodeStates;
     
     //FOSSIL
     // Fossil preservation rate. Assume 1 value for now.
@@ -143,6 +168,12 @@ private:
 };
 
 
+inline SpExNodeState& SpExModel::nodeState(Node* node)
+{
+    return _nodeStates[node->getPreOrderIndex()];
+}
+
+
 inline double SpExModel::getPreservationRate(void)
 {
     return _preservationRate;
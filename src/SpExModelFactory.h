@@ -8,10 +8,12 @@
 
 class Model;
 class ModelDataWriter;
+class EventDataWriter;
 
 class Random;
 class Settings;
 class Prior;
+class Tree;
 
 
 class SpExModelFactory : public ModelFactory
@@ -20,15 +22,18 @@ public:
 
     virtual ~SpExModelFactory() {}
 
-    virtual Model* createModel(Random& random, Settings& settings) const;
+    virtual Model* createModel
+        (Random& random, Settings& settings, Tree& tree) const;
     virtual ModelDataWriter* createModelDataWriter(Settings& settings) const;
+    virtual EventDataWriter* createEventDataWriter
+        (const std::string& outputFileName) const;
 };
 
 
 inline Model* SpExModelFactory::createModel
-    (Random& random, Settings& settings) const
+    (Random& random, Settings& settings, Tree& tree) const
 {
-    return new SpExModel(random, settings);
+    return new SpExModel(random, settings, tree);
 }
 
 
@@ -39,4 +44,11 @@ inline ModelDataWriter* SpExModelFactory::createModelDataWriter
 }
 
 
+inline EventDataWriter* SpExModelFactory::createEventDataWriter
+    (const std::string& outputFileName) const
+{
+    return new SpExEventDataWriter(outputFileName);
+}
+
+
 #endif
@@ -43,3 +43,118 @@ double Stat::lnExponentialPDF(double x, double rate)
 {
     return _random.lnExponentialPdf(rate, x);
 }
+
+
+// Each chain is split in half, so a chain that is still drifting shows
+// up as disagreement between its two halves. R-hat compares the variance
+// pooled over all (half-)chains with the mean within-chain variance; it
+// approaches 1 as the chains converge to the same distribution.
+double Stat::potentialScaleReduction
+    (const std::vector<std::vector<double> >& chains)
+{
+    std::vector<std::vector<double> > halves;
+    splitChains(chains, halves);
+
+    double withinVariance = 0.0;
+    for (int i = 0; i < (int)halves.size(); i++) {
+        withinVariance += variance(halves[i]);
+    }
+    withinVariance /= halves.size();
+
+    double pooled = pooledVariance(halves);
+
+    if (withinVariance == 0.0) {
+        return (pooled == 0.0) ? 1.0 : HUGE_VAL;
+    }
+
+    return std::sqrt(pooled / withinVariance);
+}
+
+
+// Each chain is cut into batches of sqrt(n) samples. The variance of the
+// batch means estimates the variance of the sample mean, which gives the
+// number of independent samples the chains are worth. The pooled variance
+// (rather than the within-chain variance) is used so that chains that
+// disagree are not counted as independent evidence.
+double Stat::effectiveSampleSize
+    (const std::vector<std::vector<double> >& chains)
+{
+    int n = (int)chains[0].size();
+    int batchSize = (int)std::sqrt((double)n);
+    int nBatches = n / batchSize;
+
+    double sumOfSquares = 0.0;
+    for (int i = 0; i < (int)chains.size(); i++) {
+        double chainMean = mean(chains[i]);
+        for (int b = 0; b < nBatches; b++) {
+            double batchMean = 0.0;
+            for (int j = b * batchSize; j < (b + 1) * batchSize; j++) {
+                batchMean += chains[i][j];
+            }
+            batchMean /= batchSize;
+            sumOfSquares += (batchMean - chainMean) * (batchMean - chainMean);
+        }
+    }
+
+    double batchMeanVariance = batchSize * sumOfSquares /
+        (chains.size() * (nBatches - 1));
+
+    double variance = pooledVariance(chains);
+    if (variance == 0.0) {
+        return 0.0;
+    }
+
+    int totalSamples = (int)chains.size() * nBatches * batchSize;
+    if (batchMeanVariance == 0.0) {
+        return totalSamples;
+    }
+
+    return totalSamples * variance / batchMeanVariance;
+}
+
+
+void Stat::splitChains(const std::vector<std::vector<double> >& chains,
+    std::vector<std::vector<double> >& halves)
+{
+    for (int i = 0; i < (int)chains.size(); i++) {
+        int half = (int)chains[i].size() / 2;
+        halves.push_back(std::vector<double>
+            (chains[i].begin(), chains[i].begin() + half));
+        halves.push_back(std::vector<double>
+            (chains[i].end() - half, chains[i].end()));
+    }
+}
+
+
+double Stat::mean(const std::vector<double>& values)
+{
+    double sum = 0.0;
+    for (int i = 0; i < (int)values.size(); i++) {
+        sum += values[i];
+    }
+    return sum / values.size();
+}
+
+
+// Estimate of the variance of the target distribution from chains of equal
+// length: (n - 1) / n W + B / n, with W the mean within-chain variance and
+// B / n the variance of the chain means (0 for a single chain)
+double Stat::pooledVariance(const std::vector<std::vector<double> >& chains)
+{
+    int n = (int)chains[0].size();
+
+    std::vector<double> chainMeans;
+    double withinVariance = 0.0;
+    for (int i = 0; i < (int)chains.size(); i++) {
+        chainMeans.push_back(mean(chains[i]));
+        withinVariance += variance(chains[i]);
+    }
+    withinVariance /= chains.size();
+
+    double betweenVariance = 0.0;
+    if (chainMeans.size() > 1) {
+        betweenVariance = variance(chainMeans);
+    }
+
+    return (n - 1.0) / n * withinVariance + betweenVariance;
+}
@@ -16,8 +16,27 @@ public:
     static double lnNormalPDF(double x, double mean, double sd);
     static double lnExponentialPDF(double x, double rate);
 
+    // Convergence diagnostics for several chains sampling the same
+    // quantity (chains of equal length, at least four samples each)
+
+    // Split potential scale reduction factor (R-hat) of Gelman et al.
+    static double potentialScaleReduction
+        (const std::vector<std::vector<double> >& chains);
+
+    // Effective sample size over all chains, from batch means;
+    // 0 if the quantity never changed, since that says nothing yet
+    // about how well the chains mix
+    static double effectiveSampleSize
+        (const std::vector<std::vector<double> >& chains);
+
 private:
 
+    static void splitChains(const std::vector<std::vector<double> >& chains,
+        std::vector<std::vector<double> >& halves);
+    static double mean(const std::vector<double>& values);
+    static double pooledVariance
+        (const std::vector<std::vector<double> >& chains);
+
     static MbRandom _random;
 };
 
@@ -54,3 +54,11 @@ std::string StdOutDataWriter::header()
            "   eventRate"
            "  acceptRate";
 }
+
+
+void StdOutDataWriter::appendToExistingOutput(bool headerWritten)
+{
+    if (headerWritten) {
+        _headerWritten = true;
+    }
+}
@@ -18,6 +18,9 @@ public:
 
     void writeData(int generation, Model& model);
 
+    // Skips the header if another process has already printed it
+    void appendToExistingOutput(bool headerWritten);
+
 private:
 
     void writeHeader();
@@ -176,7 +176,9 @@ double TimeModeProposal::acceptanceRatio()
     double logJacobian = computeLogJacobian();
 
     double t = _model.getTemperatureMH();
-    double logRatio = t * (logLikelihoodRatio + logPriorRatio) + logJacobian;
+    double power = _model.getLikelihoodPower();
+    double logRatio =
+        t * (power * logLikelihoodRatio + logPriorRatio) + logJacobian;
 
     if (std::isfinite(logRatio)) {
         return std::min(1.0, std::exp(logRatio));
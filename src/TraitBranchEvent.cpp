@@ -6,8 +6,11 @@ class Tree;
 
 
 TraitBranchEvent::TraitBranchEvent(double beta, double shift,
-    bool isTimeVariable, Node* x, Tree* tp, Random& random, double map) :
-        BranchEvent(x, tp, random, map),
-        _betaInit(beta), _betaShift(shift), _isTimeVariable(isTimeVariable)
+    bool isTimeVariable, Node* x, Tree* tp, Random& random, double map,
+    EventParameterStore& parameters) :
+        BranchEvent(x, tp, random, map, parameters)
 {
+    setBetaInit(beta);
+    setBetaShift(shift);
+    setTimeVariable(isTimeVariable);
 }
@@ -11,17 +11,19 @@ class Random;
 class TraitBranchEvent : public BranchEvent
 {
 
-private:
-
-    double _betaInit;  // initial beta value.
-    double _betaShift; // temporal shift parameter of trait evolution rate.
-    bool _isTimeVariable;
-
 public:
 
+    // Parameter indices in the EventParameterStore
+    enum Parameter {
+        BetaInit,    // initial beta value.
+        BetaShift,   // temporal shift parameter of trait evolution rate.
+        NumberOfParameters
+    };
+
     // constructors, depending on whether you want trait rate or lambda/mu
     TraitBranchEvent(double beta, double shift, bool isTimeVariable,
-            Node* x, Tree* tp, Random& random, double map);
+            Node* x, Tree* tp, Random& random, double map,
+            EventParameterStore& parameters);
     virtual ~TraitBranchEvent() {};
 
     void   setBetaInit(double x);
@@ -37,37 +39,37 @@ public:
 
 inline void TraitBranchEvent::setBetaInit(double x)
 {
-    _betaInit = x;
+    _parameters.set(_parameterId, BetaInit, x);
 }
 
 
 inline double TraitBranchEvent::getBetaInit()
 {
-    return _betaInit;
+    return _parameters.get(_parameterId, BetaInit);
 }
 
 
 inline void TraitBranchEvent::setBetaShift(double x)
 {
-    _betaShift = x;
+    _parameters.set(_parameterId, BetaShift, x);
 }
 
 
 inline double TraitBranchEvent::getBetaShift()
 {
-    return _betaShift;
+    return _parameters.get(_parameterId, BetaShift);
 }
 
 
 inline void TraitBranchEvent::setTimeVariable(bool isTimeVariable)
 {
-    _isTimeVariable = isTimeVariable;
+    _parameters.setTimeVariable(_parameterId, isTimeVariable);
 }
 
 
 inline bool TraitBranchEvent::isTimeVariable()
 {
-    return _isTimeVariable;
+    return _parameters.isTimeVariable(_parameterId);
 }
 
 
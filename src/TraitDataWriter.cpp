@@ -20,3 +20,11 @@ void TraitDataWriter::writeData(int generation, Model& model)
     _eventDataWriter.writeData(generation, model);
     _nodeStateDataWriter.writeData(generation, static_cast<TraitModel&>(model));
 }
+
+
+void TraitDataWriter::appendToExistingOutput(bool headerWritten)
+{
+    ModelDataWriter::appendToExistingOutput(headerWritten);
+    _eventDataWriter.appendToExistingOutput(headerWritten);
+    _nodeStateDataWriter.appendToExistingOutput();
+}
@@ -17,6 +17,7 @@ public:
     TraitDataWriter(Settings &settings);
 
     virtual void writeData(int generation, Model& model);
+    virtual void appendToExistingOutput(bool headerWritten);
 
 protected:
 
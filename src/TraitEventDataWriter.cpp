@@ -14,6 +14,12 @@ TraitEventDataWriter::TraitEventDataWriter(Settings& settings) :
 }
 
 
+TraitEventDataWriter::TraitEventDataWriter(const std::string& outputFileName) :
+    EventDataWriter(outputFileName)
+{
+}
+
+
 TraitEventDataWriter::~TraitEventDataWriter()
 {
 }
@@ -14,6 +14,7 @@ class TraitEventDataWriter : public EventDataWriter
 public:
 
     TraitEventDataWriter(Settings& settings);
+    TraitEventDataWriter(const std::string& outputFileName);
     virtual ~TraitEventDataWriter();
 
 private:
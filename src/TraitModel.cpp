@@ -23,6 +23,7 @@
 #include "Prior.h"
 #include "Stat.h"
 #include "Tools.h"
+#include "Checkpoint.h"
 
 #include <iostream>
 #include <iomanip>
@@ -34,9 +35,12 @@
 #include <cmath>
 
 
-TraitModel::TraitModel(Random& random, Settings& settings) :
-    Model(random, settings)
+TraitModel::TraitModel(Random& random, Settings& settings, Tree& tree) :
+    Model(random, settings, tree, TraitBranchEvent::NumberOfParameters),
+    _nodeStates(tree.initialTraitNodeStates())
 {
+    initializeTraitValues();
+
 #ifdef NEGATIVE_SHIFT_PARAM
     // Constrain beta shift to be zero or less than zero.
     if (_settings.getBetaShiftInit() > 0) {
@@ -66,17 +70,18 @@ TraitModel::TraitModel(Random& random, Settings& settings) :
     }
 
     BranchEvent* x = new TraitBranchEvent(betaInit, betaShiftInit,
-        isTimeVariable, _tree->getRoot(), _tree, _random, 0);
+        isTimeVariable, _tree->getRoot(), _tree, _random, 0,
+        _eventParameters);
     _rootEvent = x;
     _lastEventModified = x;
 
     // Set NodeEvent of root node equal to the _rootEvent:
-    _tree->getRoot()->getBranchHistory()->setNodeEvent(_rootEvent);
+    getBranchHistory(_tree->getRoot())->setNodeEvent(_rootEvent);
 
     // Initialize all branch histories to equal the root event:
     forwardSetBranchHistories(_rootEvent);
 
-    _tree->setMeanBranchTraitRates();
+    setMeanBranchTraitRates();
 
     // Initialize by previous event histories (or from initial event number)
     if (_settings.get<bool>("loadEventData")) {
@@ -134,7 +139,7 @@ BranchEvent* TraitModel::newBranchEventWithReadParameters
 
     // TODO: Return true for now for time-variable
     return new TraitBranchEvent(betaInit, betaShift, true,
-            x, _tree, _random, time);
+            x, _tree, _random, time, _eventParameters);
 }
 
 
@@ -155,7 +160,12 @@ double TraitModel::betaShiftParameter
 
 void TraitModel::setMeanBranchParameters()
 {
-    _tree->setMeanBranchTraitRates();
+    const std::vector<Node*>& nodes = nodesWithChangedHistory();
+    for (int i = 0; i < (int)nodes.size(); i++) {
+        computeMeanTraitRatesByNode(nodes[i]);
+    }
+
+    clearNodesWithChangedHistory();
 }
 
 
@@ -181,7 +191,7 @@ BranchEvent* TraitModel::newBranchEventWithRandomParameters(double x)
     }
 
     return new TraitBranchEvent(newbeta, newBetaShift, newIsTimeVariable,
-        _tree->mapEventToTree(x), _tree, _random, x);
+        _tree->mapEventToTree(x), _tree, _random, x, _eventParameters);
 }
 
 
@@ -213,7 +223,8 @@ BranchEvent* TraitModel::newBranchEventWithParametersFromSettings(double x)
     }
     
     return new TraitBranchEvent(newbeta, newBetaShift, newIsTimeVariable,
-                                _tree->mapEventToTree(x), _tree, _random, x);
+                                _tree->mapEventToTree(x), _tree, _random, x,
+                                _eventParameters);
     
 }
 
@@ -245,12 +256,107 @@ BranchEvent* TraitModel::newBranchEventFromLastDeletedEvent()
     return new TraitBranchEvent(_lastDeletedEventBetaInit,
         _lastDeletedEventBetaShift, _lastDeletedEventTimeVariable,
         _tree->mapEventToTree(_lastDeletedEventMapTime), _tree, _random,
-        _lastDeletedEventMapTime);
+        _lastDeletedEventMapTime, _eventParameters);
+}
+
+
+BranchEvent* TraitModel::newBranchEventWithDefaultParameters(double x)
+{
+    return new TraitBranchEvent(0.0, 0.0, false,
+        _tree->mapEventToTree(x), _tree, _random, x, _eventParameters);
+}
+
+
+// Root betaInit and betaShift
+void TraitModel::getModelGlobalParameters
+    (std::vector<double>& values, std::vector<bool>& isLogScale)
+{
+    TraitBranchEvent* rootEvent = static_cast<TraitBranchEvent*>(_rootEvent);
+
+    values.push_back(rootEvent->getBetaInit());
+    isLogScale.push_back(true);
+    values.push_back(rootEvent->getBetaShift());
+    isLogScale.push_back(false);
+}
+
+
+void TraitModel::setModelGlobalParameters(const double* values)
+{
+    TraitBranchEvent* rootEvent = static_cast<TraitBranchEvent*>(_rootEvent);
+
+    rootEvent->setBetaInit(values[0]);
+    if (rootEvent->isTimeVariable()) {
+        rootEvent->setBetaShift(values[1]);
+    }
+
+    setMeanBranchTraitRates();
+}
+
+
+void TraitModel::getModelFixedGlobalParameters(std::vector<bool>& isFixed)
+{
+    getModelFixedEventParameters(isFixed);
+}
+
+
+void TraitModel::getModelEventParameters(BranchEvent* event,
+    std::vector<double>& values, std::vector<bool>& isLogScale)
+{
+    TraitBranchEvent* specificEvent = static_cast<TraitBranchEvent*>(event);
+
+    values.push_back(specificEvent->getBetaInit());
+    isLogScale.push_back(true);
+    values.push_back(specificEvent->getBetaShift());
+    isLogScale.push_back(false);
+}
+
+
+void TraitModel::setModelEventParameters
+    (BranchEvent* event, const double* values)
+{
+    TraitBranchEvent* specificEvent = static_cast<TraitBranchEvent*>(event);
+
+    specificEvent->setBetaInit(values[0]);
+    if (specificEvent->isTimeVariable()) {
+        specificEvent->setBetaShift(values[1]);
+    }
+}
+
+
+void TraitModel::getModelFixedEventParameters(std::vector<bool>& isFixed)
+{
+    isFixed.push_back(_settings.get<double>("updateRateBeta0") == 0.0);
+    isFixed.push_back(_settings.get<double>("updateRateBetaShift") == 0.0);
+}
+
+
+// Trait values of all nodes, in pre-order
+void TraitModel::writeModelState(std::ostream& out) const
+{
+    Checkpoint::write(out, (int)_nodeStates.size());
+    for (int i = 0; i < (int)_nodeStates.size(); i++) {
+        Checkpoint::write(out, _nodeStates[i].trait);
+    }
+}
+
+
+void TraitModel::readModelState(std::istream& in)
+{
+    int numberOfNodes = 0;
+    Checkpoint::read(in, numberOfNodes);
+    if (numberOfNodes != (int)_nodeStates.size()) {
+        exitWithError("The checkpoint was written for another tree");
+    }
+
+    for (int i = 0; i < numberOfNodes; i++) {
+        Checkpoint::read(in, _nodeStates[i].trait);
+    }
 }
 
 
 double TraitModel::computeLogLikelihood()
 {
+    countLikelihoodEvaluation();
 
     double LnL = 0.0;
 
@@ -272,20 +378,20 @@ double TraitModel::computeLogLikelihood()
         if ( (xnode != _tree->getRoot()) && (xnode->getCanHoldEvent() == true) ) {
 
 
-            double var = xnode->getBrlen() * xnode->getMeanBeta();
+            double var = xnode->getBrlen() * nodeState(xnode).meanBeta;
 
             // change in phenotype:
-            double delta = xnode->getTraitValue() - xnode->getAnc()->getTraitValue();
+            double delta = nodeState(xnode).trait - nodeState(xnode->getAnc()).trait;
 
             LnL += Stat::lnNormalPDF(delta, 0.0, std::sqrt(var));
 
-            //std::cout << xnode << "dz: " << delta << "\tT: " << xnode->getBrlen() << "\tRate: " << xnode->getMeanBeta();
+            //std::cout << xnode << "dz: " << delta << "\tT: " << xnode->getBrlen() << "\tRate: " << nodeState(xnode).meanBeta;
             //std::cout << "\tLf: " << _rng->lnNormalPdf(0, var, delta) << std::endl;
 
             /*if (xnode == tmpnode){
                 std::cout << tmpnode->getTraitBranchHistory()->getAncestralNodeEvent()->getBetaInit();
                 std::cout << "\tDelta: " << delta << "\tvar: " << var << "\tLL: " << _rng->lnNormalPdf(0, var, delta);
-                std::cout << "\tBeta: " << xnode->getMeanBeta()  << std::endl;
+                std::cout << "\tBeta: " << nodeState(xnode).meanBeta  << std::endl;
             }*/
         }
 
@@ -318,18 +424,18 @@ double TraitModel::computeTriadLikelihoodTraits(Node* x)
         // computation for left descendant branch:
 
         if (x->getLfDesc()->getCanHoldEvent() == true) {
-            double delta = x->getLfDesc()->getTraitValue() - x->getTraitValue();
+            double delta = nodeState(x->getLfDesc()).trait - nodeState(x).trait;
             double var = x->getLfDesc()->getBrlen() *
-                x->getLfDesc()->getMeanBeta();
+                nodeState(x->getLfDesc()).meanBeta;
             logL += Stat::lnNormalPDF(delta, 0.0, std::sqrt(var));
         }
 
 
         if (x->getRtDesc()->getCanHoldEvent() == true) {
             // computation for right descendant branch
-            double delta = x->getRtDesc()->getTraitValue() - x->getTraitValue();
+            double delta = nodeState(x->getRtDesc()).trait - nodeState(x).trait;
             double var = x->getRtDesc()->getBrlen() *
-                x->getRtDesc()->getMeanBeta();
+                nodeState(x->getRtDesc()).meanBeta;
             logL += Stat::lnNormalPDF(delta, 0.0, std::sqrt(var));
         }
 
@@ -338,8 +444,8 @@ double TraitModel::computeTriadLikelihoodTraits(Node* x)
 
         if (x != _tree->getRoot()) {
 
-            double delta = x->getTraitValue() - x->getAnc()->getTraitValue();
-            double var = x->getBrlen() * x->getMeanBeta();
+            double delta = nodeState(x).trait - nodeState(x->getAnc()).trait;
+            double var = x->getBrlen() * nodeState(x).meanBeta;
             logL += Stat::lnNormalPDF(delta, 0.0, std::sqrt(var));
         }
     }
@@ -370,17 +476,24 @@ double TraitModel::computeLogPrior()
         logPrior += dens_term + _prior.betaShiftRootPrior(re->getBetaShift());
     }
 
-    for (std::set<BranchEvent*>::iterator i = _eventCollection.begin();
-         i != _eventCollection.end(); ++i) {
-
-        TraitBranchEvent* event = static_cast<TraitBranchEvent*>(*i);
-
-        logPrior += _prior.betaInitPrior(event->getBetaInit());
-        if (event->isTimeVariable()) {
-            logPrior += dens_term +
-                _prior.betaShiftPrior(event->getBetaShift());
+    // Non-root events, straight from the parameter arrays
+    const double* betaInit =
+        _eventParameters.values(TraitBranchEvent::BetaInit);
+    const double* betaShift =
+        _eventParameters.values(TraitBranchEvent::BetaShift);
+    const char* isTimeVariable = _eventParameters.timeVariableFlags();
+    const char* isInTree = _eventParameters.inTreeFlags();
+
+    int numberOfIds = _eventParameters.size();
+    for (int i = 0; i < numberOfIds; i++) {
+        if (!isInTree[i]) {
+            continue;
         }
 
+        logPrior += _prior.betaInitPrior(betaInit[i]);
+        if (isTimeVariable[i]) {
+            logPrior += dens_term + _prior.betaShiftPrior(betaShift[i]);
+        }
     }
 
     // and prior on number of events:
@@ -392,6 +505,233 @@ double TraitModel::computeLogPrior()
 }
 
 
+void TraitModel::setMeanBranchTraitRates()
+{
+    const std::vector<Node*>& nodes = _tree->preOrderNodes();
+    for (std::vector<Node*>::const_iterator i = nodes.begin();
+            i != nodes.end(); ++i) {
+        computeMeanTraitRatesByNode((*i));
+    }
+}
+
+
+/*
+    This function is replicated for speciation and extinction as part of
+    class node - it seems more efficient to put it here with class tree.
+
+
+*/
+
+void TraitModel::computeMeanTraitRatesByNode(Node* x)
+{
+    BranchHistory* bh = getBranchHistory(x);
+
+    if (x->getAnc() != NULL) {
+        // Only compute mean branch rate if node is NOT the root
+
+        double rate = 0.0;
+        int n_events = bh->getNumberOfBranchEvents();
+
+        TraitBranchEvent* ancestralEvent =
+            static_cast<TraitBranchEvent*>(bh->getAncestralNodeEvent());
+
+        if (n_events == 0) {
+
+            double t1 = x->getAnc()->getTime();
+            double t2 = x->getTime();
+
+            // Times must be relative to event occurrence time:
+            t1 -= ancestralEvent->getAbsoluteTime();
+            t2 -= ancestralEvent->getAbsoluteTime();
+
+            double zpar = ancestralEvent->getBetaShift();
+            double beta0 = ancestralEvent->getBetaInit();
+
+            rate = x->integrateExponentialRateFunction(beta0, zpar, t1, t2);
+            rate /= x->getBrlen();
+
+        } else {
+
+            double tcheck = 0.0;
+            double t1 = x->getAnc()->getTime();
+            double t2 = bh->getEventByIndexPosition(0)->getAbsoluteTime();
+
+            tcheck += (t2 - t1);
+
+            // Times must be relative to initial time of event
+            t1 -= ancestralEvent->getAbsoluteTime();
+            t2 -= ancestralEvent->getAbsoluteTime();
+            double zpar = ancestralEvent->getBetaShift();
+            double beta0 = ancestralEvent->getBetaInit();
+
+            rate = x->integrateExponentialRateFunction(beta0, zpar, t1, t2);
+
+            for (int k = 1; k < n_events; k++) {
+
+                t1 = 0.0;
+                t2 = bh->getEventByIndexPosition(k)->getAbsoluteTime() -
+                     bh->getEventByIndexPosition((k - 1))->getAbsoluteTime();
+
+                TraitBranchEvent* eventAtKMinus1 =
+                    static_cast<TraitBranchEvent*>
+                        (bh->getEventByIndexPosition(k - 1));
+
+                zpar = eventAtKMinus1->getBetaShift();
+                beta0 = eventAtKMinus1->getBetaInit();
+
+                rate += x->integrateExponentialRateFunction(beta0, zpar, t1, t2);
+
+                tcheck += (t2 - t1);
+
+            }
+
+            t1 = 0.0;
+            t2 = x->getTime() - bh->getEventByIndexPosition((n_events -
+                    1))->getAbsoluteTime();
+
+            TraitBranchEvent* event = static_cast<TraitBranchEvent*>
+                (bh->getNodeEvent());
+
+            zpar = event->getBetaShift();
+            beta0 = event->getBetaInit();
+
+            rate += x->integrateExponentialRateFunction(beta0, zpar, t1, t2);
+
+            tcheck += (t2 - t1);
+
+
+            // The overall mean rate across the branch:
+            rate /= (x->getBrlen());
+
+            //std::cout << "Rate: " << rate << std::endl;
+        }
+        nodeState(x).meanBeta = rate;
+
+    } else {
+        // Node is root
+        nodeState(x).meanBeta = (double)0.0;
+
+    }
+
+    TraitBranchEvent* event =
+        static_cast<TraitBranchEvent*>(bh->getNodeEvent());
+
+    // compute speciation rate at the focal node:
+    double reltime = x->getTime() - event->getAbsoluteTime();
+
+    double init = event->getBetaInit();
+    double zz = event->getBetaShift();
+
+    double curBeta = x->getExponentialRate(init, zz, reltime);
+
+#ifdef DEBUG_TIME_VARIABLE
+
+    // Try setting node speciation rates equal to mean rate on descendant branches, to see if the
+    //  high-rate trap disappears.
+
+#else
+
+    nodeState(x).nodeBeta = curBeta;
+
+#endif
+
+}
+
+
+/*
+ Now setting trait values to be drawn from unifom distribution defined by 2 parental values.
+
+ */
+void TraitModel::initializeTraitValues()
+{
+
+    std::cout << "Setting initial trait values at internal nodes" << std::endl;
+
+    // get min & max values:
+    double mn = 0;
+    double mx = 0;
+    bool set = false;
+
+    const std::vector<Node*>& nodes = _tree->preOrderNodes();
+    for (std::vector<Node*>::const_iterator i = nodes.begin();
+            i != nodes.end(); ++i) {
+        if (nodeState(*i).isTraitFixed) {
+            if (set == false) {
+                mn = nodeState(*i).trait;
+                mx = nodeState(*i).trait;
+                set = true;
+            } else {
+                if (nodeState(*i).trait < mn )
+                    mn = nodeState(*i).trait;
+                if (nodeState(*i).trait > mx)
+                    mx = nodeState(*i).trait;
+            }
+        }
+    }
+    recursiveSetTraitValues(_tree->getRoot(), mn, mx);
+}
+
+
+void TraitModel::recursiveSetTraitValues(Node* x, double mn, double mx)
+{
+    if (x->getLfDesc() != NULL && x->getRtDesc() != NULL) {
+        recursiveSetTraitValues(x->getLfDesc(), mn, mx);
+        recursiveSetTraitValues(x->getRtDesc(), mn, mx);
+
+        // choose random number between two descendants.
+        double s1 = nodeState(x->getLfDesc()).trait;
+        double s2 = nodeState(x->getRtDesc()).trait;
+
+        if (s1 < s2) {
+            //nodeState(x).trait = ranPtr->uniformRv(s1, s2);
+            nodeState(x).trait = (s1 + s2) / (double)2;
+
+        } else if (s1 > s2) {
+            //nodeState(x).trait = ranPtr->uniformRv(s2, s1);
+            nodeState(x).trait = (s1 + s2) / (double)2;
+        } else {
+            nodeState(x).trait = s1;
+        }
+    } else if (nodeState(x).isTraitFixed == false) {
+        nodeState(x).trait = _random.uniform(mn, mx);
+    } else {
+        // Trait is fixed. Nothing to do.
+    }
+}
+
+
+std::vector<double> TraitModel::traitValues()
+{
+    const std::vector<Node*>& nodes = _tree->terminalNodes();
+    std::vector<double> values;
+
+    std::vector<Node*>::const_iterator it;
+    for (it = nodes.begin(); it != nodes.end(); ++it) {
+        values.push_back(nodeState(*it).trait);
+    }
+
+    return values;
+}
+
+
+void TraitModel::writeBranchPhenotypes(Node* p, std::ostream& out)
+{
+    if (p->getLfDesc() == NULL && p-> getRtDesc() == NULL) {
+        if (p->getName() == "") {
+            out << p->getIndex() << ":" << nodeState(p).trait;
+        } else {
+            out << p->getName() << ":" << nodeState(p).trait;
+        }
+    } else {
+        out << "(";
+        writeBranchPhenotypes(p->getLfDesc(), out);
+        out << ",";
+        writeBranchPhenotypes(p->getRtDesc(), out);
+        out << "):" << nodeState(p).trait;
+    }
+}
+
+
 void TraitModel::getSpecificEventDataString
     (std::stringstream& ss, BranchEvent* event)
 {
@@ -3,16 +3,17 @@
 
 
 #include "Model.h"
+#include "Node.h"
 
 #include <iosfwd>
 #include <vector>
 #include <string>
 
-class Node;
 class Random;
 class Settings;
 class BranchEvent;
 class Proposal;
+class Tree;
 
 
 class TraitModel : public Model
@@ -20,13 +21,23 @@ class TraitModel : public Model
 
 public:
 
-    TraitModel(Random& rng, Settings& settings);
+    TraitModel(Random& rng, Settings& settings, Tree& tree);
 
     virtual double computeLogLikelihood();
     virtual double computeTriadLikelihoodTraits(Node* x);
 
     virtual double computeLogPrior();
 
+    TraitNodeState& nodeState(Node* node);
+
+    // Recomputes the mean and node trait rates for every node
+    void setMeanBranchTraitRates();
+
+    std::vector<double> traitValues();
+
+    // Writes the tree in newick format with this chain's trait values
+    void writeBranchPhenotypes(Node* p, std::ostream& out);
+
 private:
 
     virtual void setRootEventWithReadParameters
@@ -40,6 +51,20 @@ private:
     virtual BranchEvent* newBranchEventWithRandomParameters(double x);
     virtual BranchEvent* newBranchEventWithParametersFromSettings(double x);
     virtual BranchEvent* newBranchEventFromLastDeletedEvent();
+    virtual BranchEvent* newBranchEventWithDefaultParameters(double x);
+
+    virtual void getModelGlobalParameters
+        (std::vector<double>& values, std::vector<bool>& isLogScale);
+    virtual void setModelGlobalParameters(const double* values);
+    virtual void getModelFixedGlobalParameters(std::vector<bool>& isFixed);
+    virtual void getModelEventParameters(BranchEvent* event,
+        std::vector<double>& values, std::vector<bool>& isLogScale);
+    virtual void setModelEventParameters
+        (BranchEvent* event, const double* values);
+    virtual void getModelFixedEventParameters(std::vector<bool>& isFixed);
+
+    virtual void writeModelState(std::ostream& out) const;
+    virtual void readModelState(std::istream& in);
 
     virtual void setMeanBranchParameters();
     virtual void setDeletedEventParameters(BranchEvent* be);
@@ -55,17 +80,24 @@ private:
     double _lastDeletedEventBetaShift;
     bool _lastDeletedEventTimeVariable;
 
-    // Here are several variables that track the previous
-    // state. At some point, these should have their own class
+    void computeMeanTraitRatesByNode(Node* x);
+
+    // Draws starting values for internal nodes and tips without data
+    void initializeTraitValues();
+    void recursiveSetTraitValues(Node* x, double mn, double mx);
 
-    // Ultimately, initializations should be handled in TraitModel
-    // and Model classes
-    // NOT in class TREE!!
-    void   initializeTraitParamsForNodes();
+    // Per-node trait state of this chain, indexed by pre-order index
+    std::vector<TraitNodeState> _nodeStates;
 
     double _readBetaInit;
     double _readBetaShift;
 };
 
 
+inline TraitNodeState& TraitModel::nodeState(Node* node)
+{
+    return _nodeStates[node->getPreOrderIndex()];
+}
+
+
 #endif
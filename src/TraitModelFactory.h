@@ -8,10 +8,12 @@
 
 class Model;
 class ModelDataWriter;
+class EventDataWriter;
 
 class Random;
 class Settings;
 class Prior;
+class Tree;
 
 
 class TraitModelFactory : public ModelFactory
@@ -20,15 +22,18 @@ public:
 
     virtual ~TraitModelFactory() {}
 
-    virtual Model* createModel(Random& random, Settings& settings) const;
+    virtual Model* createModel
+        (Random& random, Settings& settings, Tree& tree) const;
     virtual ModelDataWriter* createModelDataWriter(Settings& settings) const;
+    virtual EventDataWriter* createEventDataWriter
+        (const std::string& outputFileName) const;
 };
 
 
 inline Model* TraitModelFactory::createModel
-    (Random& random, Settings& settings) const
+    (Random& random, Settings& settings, Tree& tree) const
 {
-    return new TraitModel(random, settings);
+    return new TraitModel(random, settings, tree);
 }
 
 
@@ -39,4 +44,11 @@ inline ModelDataWriter* TraitModelFactory::createModelDataWriter
 }
 
 
+inline EventDataWriter* TraitModelFactory::createEventDataWriter
+    (const std::string& outputFileName) const
+{
+    return new TraitEventDataWriter(outputFileName);
+}
+
+
 #endif
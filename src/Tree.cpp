@@ -3,8 +3,6 @@
 #include "Tree.h"
 #include "Node.h"
 #include "NewickTreeReader.h"
-#include "BranchHistory.h"
-#include "TraitBranchEvent.h"
 #include "Log.h"
 #include "Stat.h"
 
@@ -17,7 +15,7 @@
 #include <algorithm>
 
 
-Tree::Tree(Random& random, Settings& settings) : _random(random)
+Tree::Tree(Settings& settings)
 {
     readTree(settings.get("treefile"));
 
@@ -52,6 +50,7 @@ Tree::Tree(Random& random, Settings& settings) : _random(random)
     // Initialize tree according to model type
     // TODO: This should be handled in a better way
     if (settings.get("modeltype") == "speciationextinction") {
+        _initialSpExNodeStates.assign(_preOrderNodes.size(), SpExNodeState());
         if (settings.get<bool>("useGlobalSamplingProbability")) {
             initializeSpeciationExtinctionModel
                 (settings.get<double>("globalSamplingFraction"));
@@ -64,10 +63,10 @@ Tree::Tree(Random& random, Settings& settings) : _random(random)
             (settings.get<int>("minCladeSizeForShift"));
         setTreeMap(getRoot());
     } else if (settings.get("modeltype") == "trait") {
+        _initialTraitNodeStates.assign(_preOrderNodes.size(), TraitNodeState());
         setAllNodesCanHoldEvent();
         setTreeMap(getRoot());
         getPhenotypesMissingLatent(settings.get("traitfile"));
-        initializeTraitValues();
     }
 }
 
@@ -94,21 +93,33 @@ void Tree::setInternalNodes()
 }
 
 
+// Descendants are visited before their ancestors in post-order,
+// so each count is the sum of the (already set) counts of its children
 void Tree::setNodeTipCounts()
 {
-    for (int i = 0; i < (int)_preOrderNodes.size(); ++i) {
-        int count = getDescTipCount(_preOrderNodes[i]);
-        _preOrderNodes[i]->setTipDescCount(count);
+    for (int i = 0; i < (int)_postOrderNodes.size(); ++i) {
+        Node* node = _postOrderNodes[i];
+        if (node->getLfDesc() == NULL && node->getRtDesc() == NULL) {
+            node->setTipDescCount(1);
+        } else {
+            node->setTipDescCount(node->getLfDesc()->getTipDescCount() +
+                node->getRtDesc()->getTipDescCount());
+        }
     }
 }
 
 
+// Also numbers the nodes in pre-order and records their subtree sizes,
+// so that every subtree is a contiguous range of _preOrderNodes
 void Tree::setPreOrderNodes(Node* node)
 {
     if (node != NULL) {
+        node->setPreOrderIndex((int)_preOrderNodes.size());
         _preOrderNodes.push_back(node);
         setPreOrderNodes(node->getLfDesc());
         setPreOrderNodes(node->getRtDesc());
+        node->setSubtreeSize
+            ((int)_preOrderNodes.size() - node->getPreOrderIndex());
     }
 }
 
@@ -214,16 +225,7 @@ double Tree::getAbsoluteTimeFromMapTime(double x)
 // Get number of descendant nodes from a given node
 int Tree::getDescNodeCount(Node* p)
 {
-    int count = 0;
-    if (p->getLfDesc() != NULL) {
-        count++;
-        count += getDescNodeCount(p->getLfDesc());
-    }
-    if (p->getRtDesc() != NULL) {
-        count++;
-        count += getDescNodeCount(p->getRtDesc());
-    }
-    return count;
+    return p->getSubtreeSize() - 1;
 }
 
 /*
@@ -261,54 +263,10 @@ void Tree::printNodeMap()
 }
 
 
-// This requires that p be an internal node to begin with!
-void Tree::setTempInternalNodeArray(Node* p)
-{
-    if (p->getRtDesc() == NULL && p->getLfDesc() == NULL) {
-        std::cout << "Problem: sent terminal node to setTempInternalNodeArray" << std::endl;
-        throw;
-    }
-    tempNodeSetPassDown(p);
-}
-
-
-void Tree::tempNodeSetPassDown(Node* p)
-{
-    if (p->getLfDesc() != NULL && p->getRtDesc() != NULL) {
-        _tempNodeSet.insert(p);
-        tempNodeSetPassDown(p->getLfDesc());
-        tempNodeSetPassDown(p->getRtDesc());
-    }
-}
-
-
-void Tree::clearTempNodeArray()
-{
-    _tempNodeSet.clear();
-}
-
-
-Node* Tree::getRandomNodeFromTempArray()
-{
-    int chosen = _random.uniformInteger(0, (int)_tempNodeSet.size() - 1);
-    int myit = 0;
-    Node* xnode = (*_tempNodeSet.begin());
-
-    for (std::set<Node*>::iterator i = _tempNodeSet.begin();
-            i != _tempNodeSet.end(); i++) {
-        if (myit == chosen) {
-            xnode = (*i);
-        }
-        myit++;
-    }
-    return xnode;
-}
-
-
-Node* Tree::getRandomNonRootNode()
+Node* Tree::getRandomNonRootNode(Random& random)
 {
     // Start at index = 1 because the root is at index = 0
-    int randomIndex = _random.uniformInteger(1, _preOrderNodes.size() - 1);
+    int randomIndex = random.uniformInteger(1, _preOrderNodes.size() - 1);
     return _preOrderNodes[randomIndex];
 }
 
@@ -726,282 +684,6 @@ std::vector<double>  Tree::getBranchingTimes()
 }
 
 
-void Tree::writeMeanBranchTraitRateTree(Node* p, std::stringstream& ss)
-{
-    if (p->getLfDesc() == NULL && p-> getRtDesc() == NULL) {
-        if (p->getName() == "") {
-            ss << p->getIndex() << ":" << p->getMeanBeta();
-        } else {
-            ss << p->getName() << ":" << p->getMeanBeta();
-        }
-    } else {
-        ss << "(";
-        writeMeanBranchTraitRateTree(p->getLfDesc(), ss);
-        ss << ",";
-        writeMeanBranchTraitRateTree(p->getRtDesc(), ss);
-        ss << "):" << p->getMeanBeta();
-    }
-}
-
-
-/*
-
- Set mean speciation rates on each branch by going over all nodes
- and accessing BranchHistory attribute.
-
- If multiple events on a particular branch, the meanBranchRate is
- just the arithmetic average of the rates (for now, anyway).
-
- */
-
-void Tree::setNodeSpeciationParameters()
-{
-    for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
-            i != _preOrderNodes.end(); ++i){
-        (*i)->computeAndSetNodeSpeciationParams();
-    }
-}
-
-void Tree::setNodeExtinctionParameters()
-{
-    for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
-            i != _preOrderNodes.end(); ++i){
-        (*i)->computeAndSetNodeExtinctionParams();
-    }
-}
-
-
-// Update both mean speciation rates on branch in addition to node speciation rate.
-void Tree::setMeanBranchSpeciation()
-{
-    for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
-            i != _preOrderNodes.end(); ++i) {
-        (*i)->computeNodeBranchSpeciationParams();
-    }
-}
-
-// this will update extinction for both branch mean rates as well as
-// node-associated rates.
-
-void Tree::setMeanBranchExtinction()
-{
-    for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
-            i != _preOrderNodes.end(); ++i) {
-        (*i)->computeNodeBranchExtinctionParams();
-    }
-}
-
-
-void Tree::echoMeanBranchRates()
-{
-    for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
-            i != _preOrderNodes.end(); ++i) {
-        Node* x = (*i);
-        std::cout << x << "\t" << x->getMeanSpeciationRate() << "\t" <<
-             x->getMeanExtinctionRate() << "\t" << x->getNodeLambda() << std::endl;
-    }
-}
-
-
-void Tree::echoMeanBranchTraitRates()
-{
-    for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
-            i != _preOrderNodes.end(); ++i) {
-        Node* x = (*i);
-        std::cout << x->getName() << "\t" << x->getMeanBeta() << std::endl;
-    }
-}
-
-
-void Tree::writeBranchSpeciationRatesToFile(std::string fname, bool append)
-{
-    std::stringstream outdata;
-
-    writeMeanBranchSpeciationTree(root, outdata);
-
-    outdata << ";";
-
-    std::ofstream outStream;
-    if (append == true) {
-        outStream.open(fname.c_str(), std::ofstream::app);
-    } else {
-        outStream.open(fname.c_str(), std::ofstream::trunc);
-    }
-    outStream << outdata.str() << std::endl;
-    outStream.close();
-}
-
-
-void Tree::writeBranchExtinctionRatesToFile(std::string fname, bool append)
-{
-    std::stringstream outdata;
-    writeMeanBranchExtinctionTree(root, outdata);
-    outdata << ";";
-
-    std::ofstream outStream;
-    if (append == true) {
-        outStream.open(fname.c_str(), std::ofstream::app);
-    } else {
-        outStream.open(fname.c_str(), std::ofstream::trunc);
-    }
-    outStream << outdata.str() << std::endl;
-    outStream.close();
-}
-
-
-void Tree::writeMeanBranchSpeciationTree(Node* p, std::stringstream& ss)
-{
-    if (p->getLfDesc() == NULL && p-> getRtDesc() == NULL) {
-        if (p->getName() == "") {
-            ss << p->getIndex() << ":" << p->getMeanSpeciationRate();
-        } else {
-            ss << p->getName() << ":" << p->getMeanSpeciationRate();
-        }
-    } else {
-        ss << "(";
-        writeMeanBranchSpeciationTree(p->getLfDesc(), ss);
-        ss << ",";
-        writeMeanBranchSpeciationTree(p->getRtDesc(), ss);
-        ss << "):" << p->getMeanSpeciationRate();
-    }
-}
-
-
-void Tree::writeNodeSpeciationTree(Node* p, std::stringstream& ss)
-{
-    if (p->getLfDesc() == NULL && p-> getRtDesc() == NULL) {
-        if (p->getName() == "") {
-            ss << p->getIndex() << ":" << p->getNodeLambda();
-        } else {
-            ss << p->getName() << ":" << p->getNodeLambda();
-        }
-    } else {
-        ss << "(";
-        writeNodeSpeciationTree(p->getLfDesc(), ss);
-        ss << ",";
-        writeNodeSpeciationTree(p->getRtDesc(), ss);
-        ss << "):" << p->getNodeLambda();
-    }
-}
-
-
-void Tree::writeMeanBranchExtinctionTree(Node* p, std::stringstream& ss)
-{
-    if (p->getLfDesc() == NULL && p-> getRtDesc() == NULL) {
-        if (p->getName() == "") {
-            ss << p->getIndex() << ":" << p->getMeanExtinctionRate();
-        } else {
-            ss << p->getName() << ":" << p->getMeanExtinctionRate();
-        }
-    } else {
-        ss << "(";
-        writeMeanBranchExtinctionTree(p->getLfDesc(), ss);
-        ss << ",";
-        writeMeanBranchExtinctionTree(p->getRtDesc(), ss);
-        ss << "):" << p->getMeanExtinctionRate();
-    }
-}
-
-
-void Tree::writeMeanBranchNetDivRateTree(Node* p, std::stringstream& ss)
-{
-
-    if (p->getLfDesc() == NULL && p-> getRtDesc() == NULL) {
-        if (p->getName() == "") {
-            ss << p->getIndex() << ":" << (p->getMeanSpeciationRate() -
-                                           p->getMeanExtinctionRate());
-        } else {
-            ss << p->getName() << ":" << (p->getMeanSpeciationRate() -
-                                          p->getMeanExtinctionRate());
-        }
-    } else {
-        ss << "(";
-        writeMeanBranchNetDivRateTree(p->getLfDesc(), ss);
-        ss << ",";
-        writeMeanBranchNetDivRateTree(p->getRtDesc(), ss);
-        ss << "):" << (p->getMeanSpeciationRate() - p->getMeanExtinctionRate());
-    }
-}
-
-
-void Tree::writeBranchPhenotypes(Node* p, std::ostream& out)
-{
-    if (p->getLfDesc() == NULL && p-> getRtDesc() == NULL) {
-        if (p->getName() == "") {
-            out << p->getIndex() << ":" << p->getTraitValue();
-        } else {
-            out << p->getName() << ":" << p->getTraitValue();
-        }
-    } else {
-        out << "(";
-        writeBranchPhenotypes(p->getLfDesc(), out);
-        out << ",";
-        writeBranchPhenotypes(p->getRtDesc(), out);
-        out << "):" << p->getTraitValue();
-    }
-}
-
-
-/*
-Tree::getPhenotypes
-Read file. First column = species name exactly as matching in phylogeny.
- Second column, tab-delimited: phenotype value on appropriate scale
-    (e.g., already log-transformed).
-
- */
-
-void Tree::getPhenotypes(std::string fname)
-{
-    std::ifstream infile(fname.c_str());
-    log() << "\nReading phenotypes from file <" << fname.c_str() << ">\n";
-    std::vector<std::string> stringvec;
-    std::vector<std::string> spnames;
-    std::vector<double> traits;
-
-    if (!infile.good()) {
-        log(Error) << "Error reading file.\n";
-        std::exit(1);
-    }
-
-    while (infile) {
-        std::string tempstring;
-        getline(infile, tempstring, '\t');
-        //std::cout << tempstring << "\n" << std::endl;
-        spnames.push_back(tempstring);
-        getline(infile, tempstring, '\n');
-        traits.push_back(atof(tempstring.c_str()));
-
-        // this OK?
-        if (infile.peek() == EOF) {
-            break;
-        }
-    }
-
-    infile.close();
-
-    log() << "Read " << traits.size() << " species with trait data\n";
-
-    for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
-            i != _preOrderNodes.end(); ++i) {
-        if ((*i)->getLfDesc() == NULL && (*i)->getRtDesc() == NULL ) {
-            for (std::vector<std::string>::size_type k = 0; k < spnames.size(); k++) {
-                if ((*i)->getName() == spnames[k]) {
-                    (*i)->setTraitValue(traits[k]);
-                    (*i)->setIsTraitFixed(true);
-                }
-            }
-            if ((*i)->getIsTraitFixed() == false) {
-                std::cout << "error - failed to set a terminal state\n" << std::endl;
-            }
-        } else {
-            (*i)->setTraitValue(0);
-            (*i)->setIsTraitFixed(false);
-        }
-    }
-}
-
-
-// This and the function above could be combined into one -- JWB
 void Tree::getPhenotypesMissingLatent(std::string fileName)
 {
     std::ifstream inputFile(fileName.c_str());
@@ -1040,16 +722,16 @@ void Tree::getPhenotypesMissingLatent(std::string fileName)
         if ((*i)->getLfDesc() == NULL && (*i)->getRtDesc() == NULL ) {
             for (int k = 0; k < (int)speciesNames.size(); k++) {
                 if ((*i)->getName() == speciesNames[k]) {
-                    (*i)->setTraitValue(traitValues[k]);
-                    (*i)->setIsTraitFixed(true);
+                    initialTraitState(*i).trait = traitValues[k];
+                    initialTraitState(*i).isTraitFixed = true;
                 }
             }
-            if ((*i)->getIsTraitFixed() == false) {
+            if (initialTraitState(*i).isTraitFixed == false) {
                 missingTerminalCount++;
             }
         } else {
-            (*i)->setTraitValue(0);
-            (*i)->setIsTraitFixed(false);
+            initialTraitState(*i).trait = 0;
+            initialTraitState(*i).isTraitFixed = false;
         }
     }
 
@@ -1062,34 +744,6 @@ void Tree::getPhenotypesMissingLatent(std::string fileName)
 }
 
 
-// recursive function to generate trait values...
-void Tree::generateTraitsAllNodesBM(Node* xnode, double varx)
-{
-    if (xnode->getLfDesc() != NULL && xnode->getRtDesc() != NULL) {
-        // do left:
-        double vx = xnode->getLfDesc()->getBrlen() * varx;
-        double newTrait = xnode->getTraitValue() +
-            _random.normal(0.0, std::sqrt(vx));
-        xnode->getLfDesc()->setTraitValue(newTrait);
-        generateTraitsAllNodesBM(xnode->getLfDesc(), varx);
-
-        vx = xnode->getRtDesc()->getBrlen() * varx;
-        newTrait = xnode->getTraitValue() +
-            _random.normal(0.0, std::sqrt(vx));
-        xnode->getRtDesc()->setTraitValue(newTrait);
-        generateTraitsAllNodesBM(xnode->getRtDesc(), varx);
-
-
-    } else if (xnode->getLfDesc() == NULL && xnode->getRtDesc() == NULL) {
-        xnode->setIsTraitFixed(true);
-    } else {
-        std::cout << "error in Tree::generateTraitsAllNodesBM" << std::endl;
-        throw;
-    }
-    //std::cout << xnode->getTraitValue() << std::endl;
-}
-
-
 /*
     chooseInternalNodeAtRandom()
         have checked this to make sure distribution of sampled nodes is uniform
@@ -1097,9 +751,9 @@ void Tree::generateTraitsAllNodesBM(Node* xnode, double varx)
 
  */
 
-Node* Tree::chooseInternalNodeAtRandom()
+Node* Tree::chooseInternalNodeAtRandom(Random& random)
 {
-    int snode = _random.uniformInteger(0, (int)_internalNodes.size() - 1);
+    int snode = random.uniformInteger(0, (int)_internalNodes.size() - 1);
     std::vector<Node*>::iterator myIt = _internalNodes.begin();
 
     for (int i = 0; i < snode; i++ ) {
@@ -1133,8 +787,8 @@ void Tree::initializeSpeciationExtinctionModel(double sampFrac)
             myIt != _preOrderNodes.end(); ++myIt) {
         if ((*myIt)->getLfDesc() == NULL && (*myIt)->getRtDesc() == NULL) {
 
-            (*myIt)->setDinit(speciationInit);
-            (*myIt)->setEinit(extinctionInit);
+            initialSpExState(*myIt).di = speciationInit;
+            initialSpExState(*myIt).ei = extinctionInit;
             
             // This line unnecessary
             //bool isExtant = (std::abs(getAge() - (*myIt)->getTime() )) <= 0.0001;
@@ -1153,7 +807,7 @@ void Tree::initializeSpeciationExtinctionModel(double sampFrac)
             
 
         }
-        (*myIt)->setEtip(extinctionInit); // Set
+        initialSpExState(*myIt).etip = extinctionInit; // Set
     }
 }
 
@@ -1246,6 +900,9 @@ void Tree::initializeSpeciationExtinctionModel(std::string fname)
 
     crossValidateSpecies(spnames);
 
+    // Clade name of each node, indexed by pre-order index
+    std::vector<std::string> cladeNames(_preOrderNodes.size());
+
     int counter = 0;
     for (std::vector<Node*>::iterator i = _postOrderNodes.begin();
             i != _postOrderNodes.end(); i++) {
@@ -1256,16 +913,16 @@ void Tree::initializeSpeciationExtinctionModel(std::string fname)
                     double Einit = (double)1 - sfracs[k];
                     double Dinit = sfracs[k];
 
-                    (*i)->setEinit(Einit);
-                    (*i)->setEtip(Einit);
-                    (*i)->setDinit(Dinit);
-                    (*i)->setCladeName(spfamilies[k]);
+                    initialSpExState(*i).ei = Einit;
+                    initialSpExState(*i).etip = Einit;
+                    initialSpExState(*i).di = Dinit;
+                    cladeNames[(*i)->getPreOrderIndex()] = spfamilies[k];
                     counter++;
                 }
                 //std::cout << spfamilies[k] << std::endl;
             }
 
-            if ((*i)->getEinit() == -1) {
+            if (initialSpExState(*i).ei == -1) {
                 log(Warning) << "The species " << (*i)->getName() << " "
                     << "has an E_init value of -1.\n"
                     << "Check that this species is spelled correctly "
@@ -1273,19 +930,23 @@ void Tree::initializeSpeciationExtinctionModel(std::string fname)
             }
         } else {
             // Node is internal
-            if ((*i)->getLfDesc()->getCladeName() == (*i)->getRtDesc()->getCladeName()) {
+            const std::string& leftCladeName =
+                cladeNames[(*i)->getLfDesc()->getPreOrderIndex()];
+            const std::string& rightCladeName =
+                cladeNames[(*i)->getRtDesc()->getPreOrderIndex()];
+            if (leftCladeName == rightCladeName) {
                 // node *i belongs to same clade and inherits their sampling probability:
-                double sprob = (*i)->getLfDesc()->getEtip();
-                (*i)->setEtip(sprob);
-                (*i)->setCladeName((*i)->getLfDesc()->getCladeName());
+                double sprob = initialSpExState((*i)->getLfDesc()).etip;
+                initialSpExState(*i).etip = sprob;
+                cladeNames[(*i)->getPreOrderIndex()] = leftCladeName;
             } else {
                 std::string cname = "backbone";
-                (*i)->setCladeName(cname);
-                (*i)->setEtip(backboneInitial);
+                cladeNames[(*i)->getPreOrderIndex()] = cname;
+                initialSpExState(*i).etip = backboneInitial;
             }
         }
 
-        if ((*i)->getCladeName() == "") {
+        if (cladeNames[(*i)->getPreOrderIndex()] == "") {
             log(Error) << "There are unset clade names.\n";
             std::exit(1);
         }
@@ -1295,7 +956,7 @@ void Tree::initializeSpeciationExtinctionModel(std::string fname)
     for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
             i != _preOrderNodes.end(); ++i) {
         Node* x = (*i);
-        if (x->getEtip() < 0) {
+        if (initialSpExState(x).etip < 0) {
             tcount++;
         }
     }
@@ -1332,8 +993,8 @@ void Tree::printInitialSpeciationExtinctionRates()
 {
     for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
             i != _preOrderNodes.end(); ++i) {
-        std::cout << (*i) << "\t" << (*i)->getDinit() << "\t"
-            << (*i)->getEinit()  << "\t" << (*i)->getBrlen() << std::endl;
+        std::cout << (*i) << "\t" << initialSpExState(*i).di << "\t"
+            << initialSpExState(*i).ei  << "\t" << (*i)->getBrlen() << std::endl;
     }
 }
 
@@ -1365,11 +1026,11 @@ void Tree::setCanNodeBeMapped(int ndesc)
 int Tree::getDescTipCount(Node* p)
 {
     int count = 0;
-    if ((p->getLfDesc() == NULL) & (p->getRtDesc() == NULL)) {
-        count++;
-    } else {
-        count += getDescTipCount(p->getLfDesc());
-        count += getDescTipCount(p->getRtDesc());
+    int end = p->getPreOrderIndex() + p->getSubtreeSize();
+    for (int i = p->getPreOrderIndex(); i < end; i++) {
+        if (!_preOrderNodes[i]->isInternal()) {
+            count++;
+        }
     }
     return count;
 }
@@ -1384,7 +1045,7 @@ int Tree::countDescendantsWithValidTraitData(Node* p)
 {
     int count = 0;
     if ((p->getLfDesc() == NULL) && (p->getRtDesc() == NULL)) {
-        if (p->getIsTraitFixed())
+        if (initialTraitState(p).isTraitFixed)
             count++;
     } else {
         count += countDescendantsWithValidTraitData(p->getLfDesc());
@@ -1434,260 +1095,6 @@ void Tree::setTreeMap(int ndesc)
 }
 
 
-void Tree::printTraitRange()
-{
-    double mx = root->getTraitValue();
-    double mn = root->getTraitValue();
-    for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
-            i != _preOrderNodes.end(); ++i) {
-        double ctrait = (*i)->getTraitValue();
-        if (ctrait < mn) {
-            mn = ctrait;
-        }
-        if (ctrait > mx) {
-            mx = ctrait;
-        }
-    }
-    std::cout << "Min trait value < " << mn << " >\tMax value < " << mx << " >" << std::endl;
-}
-
-
-double Tree::getTraitMaxTip()
-{
-    double ctrait = root->getTraitValue();
-    for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
-            i != _preOrderNodes.end(); ++i) {
-        if ((*i)->getLfDesc() == NULL && (*i)->getTraitValue() > ctrait ) {
-            ctrait = (*i)->getTraitValue();
-        }
-    }
-    return ctrait;
-}
-
-
-double Tree::getTraitMinTip()
-{
-    double ctrait = root->getTraitValue();
-    for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
-            i != _preOrderNodes.end(); ++i) {
-        if ((*i)->getLfDesc() == NULL && (*i)->getTraitValue() < ctrait )
-            ctrait = (*i)->getTraitValue();
-    }
-    return ctrait;
-}
-
-
-void Tree::printNodeBranchRates()
-{
-    for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
-            i != _preOrderNodes.end(); ++i) {
-        std::cout << (*i)->getMeanSpeciationRate() << "\t" << (*i)->getNodeLambda() << std::endl;
-    }
-}
-
-
-void Tree::printNodeTraitRates()
-{
-    for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
-            i != _preOrderNodes.end(); ++i) {
-        std::cout << (*i) << "\t" << (*i)->getMeanBeta() << std::endl;
-    }
-}
-
-
-void Tree::setMeanBranchTraitRates()
-{
-    for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
-            i != _preOrderNodes.end(); ++i) {
-        computeMeanTraitRatesByNode((*i));
-    }
-}
-
-
-/*
-    This function is replicated for speciation and extinction as part of
-    class node - it seems more efficient to put it here with class tree.
-
-
-*/
-
-void Tree::computeMeanTraitRatesByNode(Node* x)
-{
-    BranchHistory* bh = x->getBranchHistory();
-
-    if (x->getAnc() != NULL) {
-        // Only compute mean branch rate if node is NOT the root
-
-        double rate = 0.0;
-        int n_events = bh->getNumberOfBranchEvents();
-
-        TraitBranchEvent* ancestralEvent =
-            static_cast<TraitBranchEvent*>(bh->getAncestralNodeEvent());
-
-        if (n_events == 0) {
-
-            double t1 = x->getAnc()->getTime();
-            double t2 = x->getTime();
-
-            // Times must be relative to event occurrence time:
-            t1 -= ancestralEvent->getAbsoluteTime();
-            t2 -= ancestralEvent->getAbsoluteTime();
-
-            double zpar = ancestralEvent->getBetaShift();
-            double beta0 = ancestralEvent->getBetaInit();
-
-            rate = x->integrateExponentialRateFunction(beta0, zpar, t1, t2);
-            rate /= x->getBrlen();
-
-        } else {
-
-            double tcheck = 0.0;
-            double t1 = x->getAnc()->getTime();
-            double t2 = bh->getEventByIndexPosition(0)->getAbsoluteTime();
-
-            tcheck += (t2 - t1);
-
-            // Times must be relative to initial time of event
-            t1 -= ancestralEvent->getAbsoluteTime();
-            t2 -= ancestralEvent->getAbsoluteTime();
-            double zpar = ancestralEvent->getBetaShift();
-            double beta0 = ancestralEvent->getBetaInit();
-
-            rate = x->integrateExponentialRateFunction(beta0, zpar, t1, t2);
-
-            for (int k = 1; k < n_events; k++) {
-
-                t1 = 0.0;
-                t2 = bh->getEventByIndexPosition(k)->getAbsoluteTime() -
-                     bh->getEventByIndexPosition((k - 1))->getAbsoluteTime();
-
-                TraitBranchEvent* eventAtKMinus1 =
-                    static_cast<TraitBranchEvent*>
-                        (bh->getEventByIndexPosition(k - 1));
-
-                zpar = eventAtKMinus1->getBetaShift();
-                beta0 = eventAtKMinus1->getBetaInit();
-
-                rate += x->integrateExponentialRateFunction(beta0, zpar, t1, t2);
-
-                tcheck += (t2 - t1);
-
-            }
-
-            t1 = 0.0;
-            t2 = x->getTime() - bh->getEventByIndexPosition((n_events -
-                    1))->getAbsoluteTime();
-
-            TraitBranchEvent* event = static_cast<TraitBranchEvent*>
-                (bh->getNodeEvent());
-
-            zpar = event->getBetaShift();
-            beta0 = event->getBetaInit();
-
-            rate += x->integrateExponentialRateFunction(beta0, zpar, t1, t2);
-
-            tcheck += (t2 - t1);
-
-
-            // The overall mean rate across the branch:
-            rate /= (x->getBrlen());
-
-            //std::cout << "Rate: " << rate << std::endl;
-        }
-        x->setMeanBeta(rate);
-
-    } else {
-        // Node is root
-        x->setMeanBeta((double)0.0);
-
-    }
-
-    TraitBranchEvent* event =
-        static_cast<TraitBranchEvent*>(bh->getNodeEvent());
-
-    // compute speciation rate at the focal node:
-    double reltime = x->getTime() - event->getAbsoluteTime();
-
-    double init = event->getBetaInit();
-    double zz = event->getBetaShift();
-
-    double curBeta = x->getExponentialRate(init, zz, reltime);
-
-#ifdef DEBUG_TIME_VARIABLE
-
-    // Try setting node speciation rates equal to mean rate on descendant branches, to see if the
-    //  high-rate trap disappears.
-
-#else
-
-    x->setNodeBeta(curBeta);
-
-#endif
-
-}
-
-
-/*
- Now setting trait values to be drawn from unifom distribution defined by 2 parental values.
-
- */
-void Tree::initializeTraitValues()
-{
-
-    std::cout << "Setting initial trait values at internal nodes" << std::endl;
-
-    // get min & max values:
-    double mn = 0;
-    double mx = 0;
-    bool set = false;
-
-    for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
-            i != _preOrderNodes.end(); ++i) {
-        if ((*i)->getIsTraitFixed()) {
-            if (set == false) {
-                mn = (*i)->getTraitValue();
-                mx = (*i)->getTraitValue();
-                set = true;
-            } else {
-                if ((*i)->getTraitValue() < mn )
-                    mn = (*i)->getTraitValue();
-                if ((*i)->getTraitValue() > mx)
-                    mx = (*i)->getTraitValue();
-            }
-        }
-    }
-    recursiveSetTraitValues(root, mn, mx);
-}
-
-
-void Tree::recursiveSetTraitValues(Node* x, double mn, double mx)
-{
-    if (x->getLfDesc() != NULL && x->getRtDesc() != NULL) {
-        recursiveSetTraitValues(x->getLfDesc(), mn, mx);
-        recursiveSetTraitValues(x->getRtDesc(), mn, mx);
-
-        // choose random number between two descendants.
-        double s1 = x->getLfDesc()->getTraitValue();
-        double s2 = x->getRtDesc()->getTraitValue();
-
-        if (s1 < s2) {
-            //x->setTraitValue(ranPtr->uniformRv(s1, s2));
-            x->setTraitValue((s1 + s2) / (double)2);
-
-        } else if (s1 > s2) {
-            //x->setTraitValue(ranPtr->uniformRv(s2, s1));
-            x->setTraitValue((s1 + s2) / (double)2);
-        } else {
-            x->setTraitValue(s1);
-        }
-    } else if (x->getIsTraitFixed() == false) {
-        x->setTraitValue(_random.uniform(mn, mx));
-    } else {
-        // Trait is fixed. Nothing to do.
-    }
-}
-
-
 // Returns pointer to node of mrca of 2 taxa, with names
 //  A and B.
 
@@ -1700,7 +1107,6 @@ Node* Tree::getNodeMRCA(const std::string& A, const std::string& B)
     bool Agood = false;
     bool Bgood = false;
 
-    clearTempNodeArray();
     for (std::vector<Node*>::iterator i = _preOrderNodes.begin();
             i != _preOrderNodes.end(); ++i) {
         if ((*i)->getName() == A) {
@@ -1720,33 +1126,12 @@ Node* Tree::getNodeMRCA(const std::string& A, const std::string& B)
         throw;
     }
 
-    passUpFillTempNodeArray(nodeA);
-    //std::cout << _tempNodeSet.size() << std::endl;
-
-    bool isFoundMRCA = false;
-    while (!isFoundMRCA) {
+    // The MRCA is the first ancestor of B whose subtree also contains A
+    do {
         nodeB = nodeB->getAnc();
-        //std::cout << nodeB << std::endl;
-        if (_tempNodeSet.count(nodeB) > 0) {
-            //std::cout << nodeB << " in common" << std::endl;
-            break;
-        }
-    }
-    //std::cout << std::endl << std::endl;
-    //std::cout << nodeB << std::endl;
-    //for (std::set<Node*>::iterator i = _tempNodeSet.begin(); i != _tempNodeSet.end(); i++)
-    //  std::cout << "From A: " << (*i) << std::endl;
-    clearTempNodeArray();
-    return nodeB;
-}
+    } while (!nodeB->subtreeContains(nodeA));
 
-
-void Tree::passUpFillTempNodeArray(Node* x)
-{
-    if (x != NULL) {
-        _tempNodeSet.insert(x);
-        passUpFillTempNodeArray(x->getAnc());
-    }
+    return nodeB;
 }
 
 
@@ -1970,17 +1355,3 @@ void Tree::storeTerminalNodesRecurse(Node* node, std::vector<Node*>& nodes)
         storeTerminalNodesRecurse(rightNode, nodes);
     }
 }
-
-
-std::vector<double> Tree::traitValues()
-{
-    const std::vector<Node*>& nodes = terminalNodes();
-    std::vector<double> values;
-
-    std::vector<Node*>::const_iterator it;
-    for (it = nodes.begin(); it != nodes.end(); ++it) {
-        values.push_back((*it)->getTraitValue());
-    }
-
-    return values;
-}
@@ -65,14 +65,21 @@ private:
                         const std::vector<std::string>& list2,
                         const std::string& list2Name);
 
-    Random& _random;
-
     Node* root;
     std::vector<Node*> _preOrderNodes;
     std::vector<Node*> _postOrderNodes;
 
     std::vector<Node*> _internalNodes;
 
+    // Initial model-specific node state read from the sampling-fraction
+    // or trait file, indexed by pre-order index. Only the vector for the
+    // model being run is filled; each chain's model starts from a copy.
+    std::vector<SpExNodeState> _initialSpExNodeStates;
+    std::vector<TraitNodeState> _initialTraitNodeStates;
+
+    SpExNodeState& initialSpExState(Node* node);
+    TraitNodeState& initialTraitState(Node* node);
+
     double _startTime;
     double _tmax;
     bool _isExtant;
@@ -95,13 +102,14 @@ private:
     std::set<Node*> mappableNodes;
     double _totalMapLength;
 
-    std::set<Node*> _tempNodeSet;
-
     NewickTreeReader _treeReader;
 
 public:
 
-    Tree(Random& random, Settings& settings);
+    // The tree file (and the sampling-fraction or trait file) is read
+    // and validated once; the resulting tree is shared, read-only,
+    // by the models of all chains
+    Tree(Settings& settings);
 
     ~Tree();
 
@@ -123,6 +131,7 @@ public:
     double getAbsoluteTimeFromMapTime(double x);
 
     int   getNumberOfNodes();
+    const std::vector<Node*>& preOrderNodes();
     const std::vector<Node*>& postOrderNodes();
 
     // Count number of descendant nodes from a given node
@@ -167,44 +176,15 @@ public:
     void   setAge();
     std::vector<double> getBranchingTimes();
 
-    void writeMeanBranchTraitRateTree(Node* p, std::stringstream& ss);
-    void setMeanBranchTraitRates();
 
     bool isUltrametric();
 
     // Functions for phenotypic evolution:
-    void getPhenotypes(std::string fname);
     void getPhenotypesMissingLatent(std::string fname);
 
-    void  initializeTraitValues();
-    void  recursiveSetTraitValues(Node* x, double mn, double mx);
-    Node* chooseInternalNodeAtRandom();
-
-    void   generateTraitsAllNodesBM(Node* xnode, double varx);
-    void   generateTraitsAllNodesFromEventBeta(Node* xnode);
-    void   printTraitRange();
-    double getTraitMinTip();
-    double getTraitMaxTip();
-
-    // speciation-extinction output
-    void setMeanBranchSpeciation();
-    void setMeanBranchExtinction();
-
-    void setNodeSpeciationParameters();
-    void setNodeExtinctionParameters();
-    
-    void echoMeanBranchRates();
-
-    void writeMeanBranchSpeciationTree(Node* p, std::stringstream& ss);
-    void writeBranchSpeciationRatesToFile(std::string fname, bool append);
-    void writeBranchExtinctionRatesToFile(std::string fname, bool append);
-
+    Node* chooseInternalNodeAtRandom(Random& random);
 
-    void writeMeanBranchExtinctionTree(Node* p, std::stringstream& ss);
-    void writeNodeSpeciationTree(Node* p, std::stringstream& ss);
-
-    void writeMeanBranchNetDivRateTree(Node* p, std::stringstream& ss);
-    void writeBranchPhenotypes(Node* p, std::ostream& out);
+    const std::vector<TraitNodeState>& initialTraitNodeStates();
 
     // speciation-extinction initialization:
 
@@ -213,6 +193,8 @@ public:
     void initializeSpeciationExtinctionModel(double sampFraction);
     void printInitialSpeciationExtinctionRates();
 
+    const std::vector<SpExNodeState>& initialSpExNodeStates();
+
     // New fxns for mapping events to nodes:
 
     double getTotalMapLength();
@@ -222,28 +204,12 @@ public:
 
     void setCanNodeBeMapped(int ndesc);
 
-    // Functions for random access of nodes from temporary nodeset array
-    void  setTempInternalNodeArray(Node* p);
-    void  tempNodeSetPassDown(Node* p);
-    void  clearTempNodeArray();
-    Node* getRandomNodeFromTempArray();
-
-    Node* getRandomNonRootNode();
-
-    void printNodeBranchRates();
-
-    void computeMeanTraitRatesByNode(Node* x);
+    Node* getRandomNonRootNode(Random& random);
 
     Node* getNodeMRCA(const std::string& A, const std::string& B);
-    void  passUpFillTempNodeArray(Node* x);
     Node* getNodeByName(const std::string& A);
 
-    void printNodeTraitRates();
-
-    void echoMeanBranchTraitRates();
-
     std::vector<Node*> terminalNodes();
-    std::vector<double> traitValues();
 };
 
 
@@ -259,6 +225,12 @@ inline int Tree::getNumberOfNodes()
 }
 
 
+inline const std::vector<Node*>& Tree::preOrderNodes()
+{
+    return _preOrderNodes;
+}
+
+
 inline const std::vector<Node*>& Tree::postOrderNodes()
 {
     return _postOrderNodes;
@@ -313,6 +285,30 @@ inline double Tree::getAge()
 }
 
 
+inline SpExNodeState& Tree::initialSpExState(Node* node)
+{
+    return _initialSpExNodeStates[node->getPreOrderIndex()];
+}
+
+
+inline TraitNodeState& Tree::initialTraitState(Node* node)
+{
+    return _initialTraitNodeStates[node->getPreOrderIndex()];
+}
+
+
+inline const std::vector<SpExNodeState>& Tree::initialSpExNodeStates()
+{
+    return _initialSpExNodeStates;
+}
+
+
+inline const std::vector<TraitNodeState>& Tree::initialTraitNodeStates()
+{
+    return _initialTraitNodeStates;
+}
+
+
 inline double Tree::getTotalMapLength()
 {
     return _totalMapLength;
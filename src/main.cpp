@@ -6,6 +6,11 @@
 #include "TraitModelFactory.h"
 #include "FastSimulatePrior.h"
 #include "MetropolisCoupledMCMC.h"
+#include "MCMCReplicates.h"
+#include "PosteriorOptimizer.h"
+#include "SequentialMonteCarlo.h"
+#include "ProcessGroup.h"
+#include "Checkpoint.h"
 #include "Log.h"
 
 #include <iostream>
@@ -24,37 +29,108 @@ ModelFactory* createModelFactory(const std::string& modelType);
 
 int main (int argc, char* argv[])
 {
+    ProcessGroup::initialize(&argc, &argv);
+
     // Process command-line arguments and load settings
     CommandLineProcessor commandLine(argc, argv);
     Settings settings(commandLine.controlFileName(), commandLine.parameters());
 
-    printAboutInformation();
+    // Every process checks for existing output files before any is created
+    ProcessGroup::barrier();
+
+    if (ProcessGroup::isRoot()) {
+        printAboutInformation();
+    }
 
     // Setup pseudorandom generator
     int seed = settings.get<long int>("seed");
     Random random = (seed > 0) ? Random(seed) : Random();
     seed = random.getSeed();    // Get actual seed in case it is based on clock
-    log(Message) << "Random seed: " << seed << "\n";
+
+    // All processes need the same seed, as each one draws the seeds of
+    // all chains and makes the same chain swap decisions
+    if (ProcessGroup::size() > 1) {
+        ProcessGroup::broadcast(seed);
+        random = Random(seed);
+    }
+
+    if (ProcessGroup::isRoot()) {
+        log(Message) << "Random seed: " << seed << "\n";
+    }
 
     // Setup "run info" file and print current settings
-    std::ofstream runInfoFile(settings.get("runInfoFilename").c_str());
-    log(Message, runInfoFile) << "Command line: "
-        << buildCommandLine(argc, argv) << "\n";
-    log(Message, runInfoFile) << "Git commit id: " << GIT_COMMIT_ID << "\n";
-    log(Message, runInfoFile) << "Random seed: " << seed << "\n";
-    log(Message, runInfoFile) << "Start time: " << currentTime() << "\n";
-    settings.printCurrentSettings(runInfoFile);
+    std::ofstream runInfoFile;
+    if (ProcessGroup::isRoot()) {
+        // A resumed run continues the run info file of the interrupted run
+        std::ios::openmode mode = settings.get<bool>("resume") ?
+            std::ios::app : std::ios::out;
+        runInfoFile.open(settings.get("runInfoFilename").c_str(), mode);
+        log(Message, runInfoFile) << "Command line: "
+            << buildCommandLine(argc, argv) << "\n";
+        log(Message, runInfoFile) << "Git commit id: " << GIT_COMMIT_ID << "\n";
+        log(Message, runInfoFile) << "Random seed: " << seed << "\n";
+        log(Message, runInfoFile) << "Start time: " << currentTime() << "\n";
+        settings.printCurrentSettings(runInfoFile);
+    }
+
+    // Output written after the checkpoint is written again when resuming
+    if (settings.get<bool>("resume") &&
+            settings.get<int>("numberOfReplicates") == 1 &&
+            ProcessGroup::size() == 1) {
+        Checkpoint::truncateOutputFiles
+            (settings, settings.get("checkpointFileName"));
+    }
 
     // Create model factory based on model type
     ModelFactory* modelFactory = createModelFactory(settings.get("modeltype"));
+
+    const std::string& runMode = settings.get("runMode");
+    if (runMode != "mcmc" && runMode != "optimize" && runMode != "smc") {
+        exitWithError("runMode must be \"mcmc\", \"optimize\" or \"smc\"");
+    }
      
-    if (settings.get<bool>("initializeModel")) {
+    if (settings.get<bool>("initializeModel") && runMode == "optimize") {
+        // Point estimate of the shift configuration instead of a sample
+        PosteriorOptimizer optimizer(random, settings, modelFactory);
+
+        if (settings.get<bool>("runMCMC")) {
+            optimizer.run();
+        }
+    } else if (settings.get<bool>("initializeModel") && runMode == "smc") {
+        // Population of particles tempered from the prior to the posterior
+        SequentialMonteCarlo smc(random, settings, modelFactory);
+
+        if (settings.get<bool>("runMCMC")) {
+            smc.run();
+
+            log(Message, runInfoFile) << "Log marginal likelihood: "
+                << smc.logMarginalLikelihood() << "\n";
+        }
+    } else if (settings.get<bool>("initializeModel") &&
+            settings.get<int>("numberOfReplicates") > 1) {
+        // Independent MC3 groups for convergence diagnostics
+        MCMCReplicates replicates(random, settings, modelFactory);
+
+        if (settings.get<bool>("runMCMC")) {
+            replicates.run();
+        }
+    } else if (settings.get<bool>("initializeModel")) {
         // MetropolisCoupledMCMC will initialize model(s)
          MetropolisCoupledMCMC mc3(random, settings, modelFactory);
          
         if (settings.get<bool>("runMCMC")) {
         
              mc3.run();
+
+            if (ProcessGroup::isRoot() &&
+                    settings.get<int>("numberOfChains") > 1) {
+                std::vector<double> temps = mc3.temperatureLadder();
+                log(Message, runInfoFile) << "Final chain temperatures:";
+                for (int i = 0; i < (int)temps.size(); i++) {
+                    runInfoFile << " " << temps[i];
+                }
+                runInfoFile << "\n";
+            }
          }
         
     }
@@ -72,8 +148,12 @@ int main (int argc, char* argv[])
         //FastSimulatePrior fsp(random, &settings);
     }
 
-    log(Message, runInfoFile) << "End time: " << currentTime() << "\n";
-    runInfoFile.close();
+    if (ProcessGroup::isRoot()) {
+        log(Message, runInfoFile) << "End time: " << currentTime() << "\n";
+        runInfoFile.close();
+    }
+
+    ProcessGroup::finalize();
 
     return 0;
 }
@@ -0,0 +1,51 @@
+#include "gtest/gtest.h"
+#include "EventParameterStore.h"
+
+
+TEST(EventParameterStoreTest, AllocateAndRelease)
+{
+    EventParameterStore store(2);
+    EXPECT_EQ(0, store.size());
+
+    EventParameterStore::EventId first = store.allocate();
+    EventParameterStore::EventId second = store.allocate();
+    EXPECT_EQ(2, store.size());
+    EXPECT_NE(first, second);
+
+    store.set(first, 0, 1.5);
+    store.set(first, 1, -0.5);
+    EXPECT_EQ(1.5, store.get(first, 0));
+    EXPECT_EQ(-0.5, store.get(first, 1));
+    EXPECT_EQ(0.0, store.get(second, 0));
+
+    EXPECT_EQ(false, store.isInTree(first));
+    store.setInTree(first, true);
+    EXPECT_EQ(true, store.isInTree(first));
+
+    // Released IDs are reused and come back cleared
+    store.release(first);
+    EXPECT_EQ(first, store.allocate());
+    EXPECT_EQ(2, store.size());
+    EXPECT_EQ(0.0, store.get(first, 0));
+    EXPECT_EQ(false, store.isInTree(first));
+}
+
+
+TEST(EventParameterStoreTest, GrowKeepsValues)
+{
+    EventParameterStore store(3);
+
+    for (int i = 0; i < 1000; i++) {
+        EventParameterStore::EventId id = store.allocate();
+        store.set(id, 0, i);
+        store.set(id, 2, 2.0 * i);
+        store.setTimeVariable(id, i % 2 == 0);
+    }
+
+    EXPECT_EQ(1000, store.size());
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_EQ((double)i, store.values(0)[i]);
+        EXPECT_EQ(2.0 * i, store.values(2)[i]);
+        EXPECT_EQ(i % 2 == 0, store.isTimeVariable(i));
+    }
+}
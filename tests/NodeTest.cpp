@@ -37,6 +37,22 @@ TEST(NodeTest, Construction)
     node->setBrlen(1.0);
     EXPECT_EQ(1.0, node->getBrlen());
     
+    EXPECT_EQ(0, node->getPreOrderIndex());
+    node->setPreOrderIndex(3);
+    EXPECT_EQ(3, node->getPreOrderIndex());
+
+    EXPECT_EQ(1, node->getSubtreeSize());
+    node->setSubtreeSize(3);
+    EXPECT_EQ(3, node->getSubtreeSize());
+
+    EXPECT_EQ(true, node->subtreeContains(node));
+    leftNode->setPreOrderIndex(4);
+    EXPECT_EQ(true, node->subtreeContains(leftNode));
+    rightNode->setPreOrderIndex(5);
+    EXPECT_EQ(true, node->subtreeContains(rightNode));
+    ancNode->setPreOrderIndex(2);
+    EXPECT_EQ(false, node->subtreeContains(ancNode));
+
     EXPECT_EQ(0, node->getTipDescCount());
     node->setTipDescCount(10);
     EXPECT_EQ(10, node->getTipDescCount());
@@ -0,0 +1,70 @@
+#include "gtest/gtest.h"
+#include "Stat.h"
+
+#include <vector>
+#include <cmath>
+#include <random>
+
+
+TEST(StatTest, PotentialScaleReduction)
+{
+    // Two chains alternating over the same values have converged
+    std::vector<std::vector<double> > chains(2);
+    for (int i = 0; i < 100; i++) {
+        chains[0].push_back(i % 2);
+        chains[1].push_back((i + 1) % 2);
+    }
+    EXPECT_NEAR(1.0, Stat::potentialScaleReduction(chains), 0.02);
+
+    // Chains around different means have not
+    for (int i = 0; i < 100; i++) {
+        chains[1][i] += 10.0;
+    }
+    EXPECT_GT(Stat::potentialScaleReduction(chains), 2.0);
+}
+
+
+TEST(StatTest, EffectiveSampleSize)
+{
+    // Anti-correlated samples (each the negative of half the previous
+    // one, plus noise) are worth about three times their number,
+    // and long runs of equal values much less
+    std::mt19937 generator(1);
+    std::normal_distribution<double> noise(0.0, 1.0);
+
+    std::vector<std::vector<double> > antiCorrelated(2);
+    std::vector<std::vector<double> > runs(2);
+    for (int c = 0; c < 2; c++) {
+        double x = 0.0;
+        for (int i = 0; i < 400; i++) {
+            x = -0.5 * x + noise(generator);
+            antiCorrelated[c].push_back(x);
+            runs[c].push_back((i / 50 + c) % 2);
+        }
+    }
+
+    EXPECT_GT(Stat::effectiveSampleSize(antiCorrelated), 800.0);
+    EXPECT_LT(Stat::effectiveSampleSize(runs), 100.0);
+}
+
+
+TEST(StatTest, EffectiveSampleSizeOfSingleChain)
+{
+    std::vector<std::vector<double> > runs(1);
+    for (int i = 0; i < 400; i++) {
+        runs[0].push_back((i / 50) % 2);
+    }
+
+    double ess = Stat::effectiveSampleSize(runs);
+    EXPECT_TRUE(std::isfinite(ess));
+    EXPECT_GT(ess, 0.0);
+    EXPECT_LT(ess, 50.0);
+}
+
+
+TEST(StatTest, EffectiveSampleSizeOfConstantChain)
+{
+    // A chain stuck at one value has not shown how well it mixes
+    std::vector<std::vector<double> > stuck(1, std::vector<double>(400, 0.0));
+    EXPECT_EQ(0.0, Stat::effectiveSampleSize(stuck));
+}